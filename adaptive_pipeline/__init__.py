@@ -1,5 +1,5 @@
 import os
-from .cache import AdaptivePipelineCache
+from .cache import AdaptivePipelineCache, MultiTenantCache
 
 # Package metadata
 __version__ = "0.1.5"
@@ -9,6 +9,7 @@ __description__ = "An adaptive Pipeline Cache composed of FIFO and upgraded Tiny
 
 __all__ = [
     'AdaptivePipelineCache',
+    'MultiTenantCache',
     'get_default_config_path',
 ]
 
@@ -1,20 +1,47 @@
-from typing import Tuple, List
+from typing import Any, Awaitable, Callable, Dict, Tuple, List, Optional, Iterator, Iterable, Mapping, Union, TypeVar, overload
 
-class AdaptivePipeLineCacheImpl:
-    def __init__(self, maxsize: int) -> None: ...
+_T = TypeVar("_T")
+# (latency, tokens) or (latency, tokens, payload), values(), items() and popitem() report only (latency, tokens)
+Value = Union[Tuple[float, int], Tuple[float, int, Any]]
+Costs = Tuple[float, int]
+Key = Union[int, str, bytes]
+# What a loader returns: tokens, or (tokens, payload)
+LoadResult = Union[int, Tuple[int, Any]]
+
+class AdaptivePipelineCache:
+    def __init__(self, config_path: str) -> None: ...
     
-    def __getitem__(self, key: int) -> Tuple[float, int]: ...
-    def __setitem__(self, key: int, value: Tuple[float, int]) -> None: ...
-    def __delitem__(self, key: int) -> None: ...
-    def __contains__(self, key: int) -> bool: ...
+    def __getitem__(self, key: Key) -> Value: ...
+    def __setitem__(self, key: Key, value: Value) -> None: ...
+    def set(self, key: Key, value: Value, ttl: Optional[float] = None) -> None: ...
+    def __delitem__(self, key: Key) -> None: ...
+    def __contains__(self, key: object) -> bool: ...
+    def __iter__(self) -> Iterator[int]: ...
     def __len__(self) -> int: ...
     def __repr__(self) -> str: ...
     
-    def get(self, key: int, default: Tuple[float, int] = ...) -> Tuple[float, int]: ...
+    @overload
+    def get(self, key: Key) -> Optional[Value]: ...
+    @overload
+    def get(self, key: Key, default: Union[Value, _T]) -> Union[Value, _T]: ...
+    @overload
+    def pop(self, key: Key) -> Value: ...
+    @overload
+    def pop(self, key: Key, default: Union[Value, _T]) -> Union[Value, _T]: ...
+    def setdefault(self, key: Key, default: Value) -> Value: ...
+    def update(self, other: Union[Mapping[Key, Value], Iterable[Tuple[Key, Value]]]) -> None: ...
+    @overload
+    def get_many(self, keys: Iterable[Key]) -> List[Optional[Value]]: ...
+    @overload
+    def get_many(self, keys: Iterable[Key], default: Union[Value, _T]) -> List[Union[Value, _T]]: ...
+    def popitem(self) -> Tuple[int, Costs]: ...
     def keys(self) -> List[int]: ...
-    def values(self) -> List[Tuple[float, int]]: ...
+    def values(self) -> List[Costs]: ...
+    def items(self) -> List[Tuple[int, Costs]]: ...
     def clear(self) -> None: ...
-    def popitem(self) -> Tuple[int, Tuple[float, int]]: ...
+    def resize(self, capacity: int) -> None: ...
+    def get_or_load(self, key: Key, loader: Callable[[Key], LoadResult]) -> Value: ...
+    async def get_or_load_async(self, key: Key, loader: Callable[[Key], Awaitable[LoadResult]]) -> Value: ...
     
     @property
     def maxsize(self) -> int: ...
@@ -22,4 +49,33 @@ class AdaptivePipeLineCacheImpl:
     @property
     def currsize(self) -> int: ...
     
+    @property
+    def spillsize(self) -> int: ...
+    
+    @property
+    def sharedsize(self) -> int: ...
+    
+    def latency_quantile(self, op: str, q: float) -> float: ...
+    def prometheus_metrics(self, path: Optional[str] = None, prefix: str = "pipeline_cache") -> str: ...
+    def flush_capture(self) -> None: ...
+    def flush_event_log(self) -> None: ...
+    
     def empty(self) -> bool: ...
+
+class MultiTenantCache:
+    def __init__(self, config_path: str) -> None: ...
+    
+    def __getitem__(self, name: str) -> AdaptivePipelineCache: ...
+    def __contains__(self, name: object) -> bool: ...
+    def __len__(self) -> int: ...
+    def __iter__(self) -> Iterator[str]: ...
+    def rebalance(self) -> bool: ...
+    def quanta(self) -> Dict[str, int]: ...
+    
+    @property
+    def maxsize(self) -> int: ...
+    
+    @property
+    def quantum_size(self) -> int: ...
+
+AdaptivePipelineCacheImpl = AdaptivePipelineCache
@@ -0,0 +1,123 @@
+"""
+get_or_load: look a key up, and on a miss load it once, however many callers miss it at the same time.
+
+The loader is called with the key and returns the tokens of its result, or (tokens, payload) to cache the result
+itself. Its latency is measured here, and the item is set with it, so the cost of a miss is what the load really took.
+Concurrent misses on a key wait for the one load in flight and share its result, or its exception, which isn't cached.
+The threaded flavour coalesces the misses of every thread, the asyncio one those of the tasks of an event loop.
+
+A loader that looks its own key up again, directly or from a task it starts, would wait for its own load forever:
+it gets a RuntimeError instead. A thread it starts and waits for isn't seen, and deadlocks. So do two loads waiting for
+each other, the loader of a looking b up while the loader of b looks a up, like two locks taken in opposite orders.
+Loading other keys from a loader is fine otherwise.
+"""
+
+import asyncio
+import contextvars
+import threading
+import time
+import weakref
+from concurrent.futures import Future
+from typing import Any, Awaitable, Callable, Dict, Hashable, Tuple, Union
+
+LoadResult = Union[int, Tuple[int, Any]]
+
+# The loads in flight of every cache, dropped with the cache.
+_flights: "weakref.WeakKeyDictionary[Any, Tuple[threading.Lock, Dict[Hashable, Future]]]" = weakref.WeakKeyDictionary()
+_async_flights: "weakref.WeakKeyDictionary[Any, Dict[Tuple[asyncio.AbstractEventLoop, Hashable], asyncio.Task]]" = weakref.WeakKeyDictionary()
+_flights_lock = threading.Lock()
+# The flights the current thread, or task, is loading, so that their loaders don't wait for themselves.
+_loading: "contextvars.ContextVar[frozenset]" = contextvars.ContextVar("adaptive_pipeline_loading", default=frozenset())
+
+
+def _to_value(latency: float, result: LoadResult) -> tuple:
+    if isinstance(result, tuple):
+        tokens, payload = result
+        return (latency, tokens, payload)
+    return (latency, result)
+
+
+def _check_not_reentrant(flight, key) -> None:
+    if flight in _loading.get():
+        raise RuntimeError(f"the loader of {key!r} looked its own key up, it would wait for its own load")
+
+
+def _cache_flights(cache) -> Tuple[threading.Lock, Dict[Hashable, Future]]:
+    with _flights_lock:
+        flights = _flights.get(cache)
+        if flights is None:
+            flights = (threading.Lock(), {})
+            _flights[cache] = flights
+        return flights
+
+
+def get_or_load(cache, key, loader: Callable[[Any], LoadResult]) -> tuple:
+    """The value of the key, as cache[key] returns it, loaded and set on a miss."""
+    value = cache.get(key)
+    if value is not None:
+        return value
+
+    lock, in_flight = _cache_flights(cache)
+    with lock:
+        flight = in_flight.get(key)
+        is_loading = flight is None
+        if is_loading:
+            flight = Future()
+            in_flight[key] = flight
+    if not is_loading:
+        _check_not_reentrant(flight, key)
+        return flight.result()
+
+    loading = _loading.set(_loading.get() | {flight})
+    try:
+        # Set before the flight is dropped, so a caller arriving after it finds the item instead of loading it again.
+        start = time.perf_counter()
+        result = loader(key)
+        value = _to_value(time.perf_counter() - start, result)
+        cache[key] = value
+    except BaseException as error:
+        with lock:
+            del in_flight[key]
+        flight.set_exception(error)
+        raise
+    finally:
+        _loading.reset(loading)
+
+    with lock:
+        del in_flight[key]
+    flight.set_result(value)
+    return value
+
+
+async def get_or_load_async(cache, key, loader: Callable[[Any], Awaitable[LoadResult]]) -> tuple:
+    """get_or_load for a coroutine loader, the misses of the tasks of the running loop share one load."""
+    value = cache.get(key)
+    if value is not None:
+        return value
+
+    loop = asyncio.get_running_loop()
+    with _flights_lock:
+        in_flight = _async_flights.get(cache)
+        if in_flight is None:
+            in_flight = {}
+            _async_flights[cache] = in_flight
+
+    flight = in_flight.get((loop, key))
+    if flight is None:
+        async def load() -> tuple:
+            # The task runs in a copy of the context, which the tasks started by the loader copy in turn.
+            _loading.set(_loading.get() | {asyncio.current_task()})
+            start = time.perf_counter()
+            result = await loader(key)
+            loaded = _to_value(time.perf_counter() - start, result)
+            cache[key] = loaded
+            return loaded
+
+        flight = loop.create_task(load())
+        in_flight[(loop, key)] = flight
+        flight.add_done_callback(lambda _: in_flight.pop((loop, key), None))
+    else:
+        _check_not_reentrant(flight, key)
+
+    # A waiter being cancelled doesn't cancel the load the others wait for.
+    return await asyncio.shield(flight)
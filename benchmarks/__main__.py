@@ -0,0 +1,43 @@
+"""
+Replays the traces without pytest, one round per contender, and prints a table:
+
+    python -m benchmarks [--trace-file PATH ...] [--cache-config PATH] [--format table|csv]
+"""
+
+import argparse
+import sys
+
+from .contenders import CONTENDERS, REPO_CONFIG, run
+from .traces import load_trace, synthetic_traces
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(prog="python -m benchmarks")
+    parser.add_argument("--trace-file", action="append", default=[])
+    parser.add_argument("--cache-config", default=REPO_CONFIG)
+    parser.add_argument("--format", choices=["table", "csv"], default="table")
+    args = parser.parse_args()
+
+    traces = synthetic_traces() + [load_trace(path) for path in args.trace_file]
+    contenders = [contender for contender in CONTENDERS if contender.is_available()]
+    for contender in CONTENDERS:
+        if contender not in contenders:
+            print(f"skipping {contender.name}: {contender.requires} is not installed", file=sys.stderr)
+
+    if args.format == "csv":
+        print("trace,contender,hit_ratio,avg_cost,ops_per_sec")
+    else:
+        print(f"{'trace':<16} {'contender':<28} {'hit ratio':>10} {'avg cost':>12} {'ops/sec':>12}")
+    for trace in traces:
+        for contender in contenders:
+            result = run(contender, trace, args.cache_config)
+            if args.format == "csv":
+                print(f"{result.trace},{result.contender},{result.hit_ratio},{result.avg_cost},{result.ops_per_sec:.0f}")
+            else:
+                print(f"{result.trace:<16} {result.contender:<28} {result.hit_ratio:>10.4f} "
+                      f"{result.avg_cost:>12.2f} {result.ops_per_sec:>12.0f}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,29 @@
+import pytest
+
+from .contenders import REPO_CONFIG
+from .traces import load_trace, synthetic_traces
+
+
+def pytest_addoption(parser):
+    parser.addoption("--trace-file", action="append", default=[],
+                     help="a recorded trace or capture to replay as well, may be given more than once")
+    parser.addoption("--cache-config", default=None,
+                     help="the config of the adaptive cache, whose capacity the other caches get too")
+
+
+def pytest_generate_tests(metafunc):
+    if "trace" in metafunc.fixturenames:
+        traces = synthetic_traces() + [load_trace(path) for path in metafunc.config.getoption("trace_file")]
+        metafunc.parametrize("trace", traces, ids=[trace.name for trace in traces], scope="session")
+
+
+@pytest.fixture(scope="session")
+def config_path(request):
+    path = request.config.getoption("cache_config")
+    if path is not None:
+        return path
+    try:
+        from adaptive_pipeline import get_default_config_path
+        return get_default_config_path()
+    except ImportError:
+        return REPO_CONFIG
@@ -0,0 +1,183 @@
+"""
+The caches compared by the benchmarks, each replaying a trace through its own idiomatic Python API, so the measured
+throughput includes the binding and wrapper overhead a caller would pay.
+
+Every replay looks a request up and sets it with its costs on a miss, and returns the number of hits and the
+aggregated latency * tokens of the misses. The reference caches get the capacity of the adaptive cache's config,
+except the dict, which is unbounded and so bounds the hit ratio and the throughput of a Python-side cache from above.
+"""
+
+import functools
+import importlib
+import json
+import os
+import time
+from typing import Callable, List, NamedTuple, Optional, Tuple
+
+from .traces import Request, Trace
+
+ReplayFunction = Callable[[List[Request], str], Tuple[int, float]]
+
+# The config of the repository, used when the package isn't installed with its own.
+REPO_CONFIG = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "config.json")
+
+# Batches of the batched replay. get_many and update each release the GIL once and take the cache locks once for
+# a whole batch, and resolve its keys in prefetched groups, where a loop of __getitem__ / __setitem__ does so per key.
+BATCH_SIZE = 64
+
+
+class Contender(NamedTuple):
+    name: str
+    replay: ReplayFunction
+    # The module the contender needs, it is skipped when the module can't be imported, e.g. an unbuilt extension.
+    requires: Optional[str] = None
+
+    def is_available(self) -> bool:
+        if self.requires is None:
+            return True
+        try:
+            importlib.import_module(self.requires)
+        except ImportError:
+            return False
+        return True
+
+
+class ReplayResult(NamedTuple):
+    contender: str
+    trace: str
+    requests: int
+    hits: int
+    cost: float
+    seconds: float
+
+    @property
+    def hit_ratio(self) -> float:
+        return self.hits / self.requests
+
+    @property
+    def avg_cost(self) -> float:
+        return self.cost / self.requests
+
+    @property
+    def ops_per_sec(self) -> float:
+        return self.requests / self.seconds
+
+
+def config_capacity(config_path: str) -> int:
+    with open(config_path) as config_file:
+        return int(json.load(config_file)["cache"]["capacity"])
+
+
+def replay_adaptive_pipeline(requests: List[Request], config_path: str) -> Tuple[int, float]:
+    from adaptive_pipeline import AdaptivePipelineCache
+
+    cache = AdaptivePipelineCache(config_path)
+    get = cache.get
+    popitem = cache.popitem
+    hits = 0
+    cost = 0.0
+    for key, latency, tokens in requests:
+        if get(key) is not None:
+            hits += 1
+            continue
+        cost += latency * tokens
+        cache[key] = (latency, tokens)
+        # The entries evicted by the policies wait to be popped.
+        try:
+            while True:
+                popitem()
+        except KeyError:
+            pass
+    return hits, cost
+
+
+def replay_adaptive_pipeline_batched(requests: List[Request], config_path: str) -> Tuple[int, float]:
+    from adaptive_pipeline import AdaptivePipelineCache
+
+    cache = AdaptivePipelineCache(config_path)
+    popitem = cache.popitem
+    hits = 0
+    cost = 0.0
+    for start in range(0, len(requests), BATCH_SIZE):
+        batch = requests[start:start + BATCH_SIZE]
+        misses = {}
+        for (key, latency, tokens), value in zip(batch, cache.get_many([request[0] for request in batch])):
+            # A key missed earlier in the batch would have been set before this request.
+            if value is not None or key in misses:
+                hits += 1
+                continue
+            cost += latency * tokens
+            misses[key] = (latency, tokens)
+        cache.update(misses)
+        try:
+            while True:
+                popitem()
+        except KeyError:
+            pass
+    return hits, cost
+
+
+def replay_functools_lru_cache(requests: List[Request], config_path: str) -> Tuple[int, float]:
+    # The costs of the request being replayed, returned by the function on a miss.
+    current: List[Tuple[float, int]] = [(0.0, 0)]
+    misses = 0
+    cost = 0.0
+
+    @functools.lru_cache(maxsize=config_capacity(config_path))
+    def load(key: int) -> Tuple[float, int]:
+        nonlocal misses, cost
+        misses += 1
+        latency, tokens = current[0]
+        cost += latency * tokens
+        return current[0]
+
+    for key, latency, tokens in requests:
+        current[0] = (latency, tokens)
+        load(key)
+    return len(requests) - misses, cost
+
+
+def _replay_mapping(cache, requests: List[Request]) -> Tuple[int, float]:
+    get = cache.get
+    hits = 0
+    cost = 0.0
+    for key, latency, tokens in requests:
+        if get(key) is not None:
+            hits += 1
+            continue
+        cost += latency * tokens
+        cache[key] = (latency, tokens)
+    return hits, cost
+
+
+def replay_cachetools_lru(requests: List[Request], config_path: str) -> Tuple[int, float]:
+    import cachetools
+
+    return _replay_mapping(cachetools.LRUCache(maxsize=config_capacity(config_path)), requests)
+
+
+def replay_cachetools_lfu(requests: List[Request], config_path: str) -> Tuple[int, float]:
+    import cachetools
+
+    return _replay_mapping(cachetools.LFUCache(maxsize=config_capacity(config_path)), requests)
+
+
+def replay_dict(requests: List[Request], config_path: str) -> Tuple[int, float]:
+    return _replay_mapping({}, requests)
+
+
+CONTENDERS = [
+    Contender("adaptive_pipeline", replay_adaptive_pipeline, "adaptive_pipeline"),
+    Contender("adaptive_pipeline_batched", replay_adaptive_pipeline_batched, "adaptive_pipeline"),
+    Contender("functools_lru_cache", replay_functools_lru_cache),
+    Contender("cachetools_lru", replay_cachetools_lru, "cachetools"),
+    Contender("cachetools_lfu", replay_cachetools_lfu, "cachetools"),
+    Contender("dict_unbounded", replay_dict),
+]
+
+
+def run(contender: Contender, trace: Trace, config_path: str) -> ReplayResult:
+    start = time.perf_counter()
+    hits, cost = contender.replay(trace.requests, config_path)
+    seconds = time.perf_counter() - start
+    return ReplayResult(contender.name, trace.name, len(trace.requests), hits, cost, seconds)
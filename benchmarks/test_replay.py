@@ -0,0 +1,28 @@
+"""
+End-to-end replay of every trace by every contender, run with pytest-benchmark:
+
+    pytest benchmarks --benchmark-group-by=param:trace --benchmark-columns=mean,ops
+
+A round replays the whole trace on a new cache. The hit ratio, the average latency * tokens of a request and the
+requests per second are reported as extra info, kept by --benchmark-save / --benchmark-json to compare releases.
+"""
+
+import pytest
+
+from .contenders import CONTENDERS, run
+
+ROUNDS = 3
+
+
+@pytest.mark.parametrize("contender", CONTENDERS, ids=[contender.name for contender in CONTENDERS])
+def test_replay(benchmark, contender, trace, config_path):
+    if not contender.is_available():
+        pytest.skip(f"{contender.requires} is not installed")
+
+    result = benchmark.pedantic(run, args=(contender, trace, config_path), rounds=ROUNDS, iterations=1)
+
+    assert 0 <= result.hits <= result.requests
+    benchmark.extra_info["requests"] = result.requests
+    benchmark.extra_info["hit_ratio"] = result.hit_ratio
+    benchmark.extra_info["avg_cost"] = result.avg_cost
+    benchmark.extra_info["ops_per_sec"] = len(trace.requests) / benchmark.stats.stats.mean
@@ -0,0 +1,130 @@
+"""
+Traces replayed by the benchmarks, as lists of (key, latency, tokens) requests.
+
+A request is looked up, and set with its costs on a miss, as the sanity test and pipeline_sweep replay their traces.
+The synthetic traces give every key fixed costs, drawn once per key, and differ in how the keys are requested.
+Recorded traces are read from the text format of the sanity test, "timestamp key latency tokens" per line,
+or from a capture written by the cache (see "Capturing the request stream" in the README).
+"""
+
+import os
+import random
+import struct
+from typing import Dict, List, NamedTuple, Tuple
+
+Request = Tuple[int, float, int]
+
+NUM_OF_REQUESTS = 200_000
+NUM_OF_KEYS = 50_000
+SEED = 42
+
+CAPTURE_MAGIC = b"PCTRACE\0"
+CAPTURE_VERSION = 1
+# TraceCapture::Record and TraceCapture::FileHeader, in the byte order of the host that captured them.
+CAPTURE_RECORD = struct.Struct("=QQdIBBH")
+CAPTURE_HEADER = struct.Struct("=8sII16x")
+CAPTURE_LOOKUP = 0
+
+
+class Trace(NamedTuple):
+    name: str
+    requests: List[Request]
+
+
+def _key_costs(num_of_keys: int, rng: random.Random) -> Tuple[List[float], List[int]]:
+    # Latencies spread over two orders of magnitude, like a mix of cheap and expensive calls.
+    latencies = [rng.lognormvariate(0.0, 1.0) for _ in range(num_of_keys)]
+    tokens = [rng.randint(1, 512) for _ in range(num_of_keys)]
+    return latencies, tokens
+
+
+def _zipf_keys(num_of_requests: int, num_of_keys: int, alpha: float, rng: random.Random) -> List[int]:
+    weights = [1.0 / (rank ** alpha) for rank in range(1, num_of_keys + 1)]
+    return rng.choices(range(num_of_keys), weights=weights, k=num_of_requests)
+
+
+def _with_costs(name: str, keys: List[int], rng: random.Random) -> Trace:
+    latencies, tokens = _key_costs(max(keys) + 1, rng)
+    return Trace(name, [(key, latencies[key], tokens[key]) for key in keys])
+
+
+def zipf_trace(alpha: float = 0.9) -> Trace:
+    """A stable popularity, the ranking of a key never changes."""
+    rng = random.Random(SEED)
+    return _with_costs(f"zipf-{alpha}", _zipf_keys(NUM_OF_REQUESTS, NUM_OF_KEYS, alpha, rng), rng)
+
+
+def scan_trace() -> Trace:
+    """A zipf working set with one-off scans of new keys every 10,000 requests, which pollute recency-only caches."""
+    rng = random.Random(SEED)
+    hot_keys = _zipf_keys(NUM_OF_REQUESTS, NUM_OF_KEYS, 0.9, rng)
+    keys = []
+    next_scan_key = NUM_OF_KEYS
+    for idx, key in enumerate(hot_keys):
+        keys.append(key)
+        if idx % 10_000 == 0:
+            keys.extend(range(next_scan_key, next_scan_key + 2_000))
+            next_scan_key += 2_000
+    return _with_costs("scan", keys, rng)
+
+
+def shifting_trace() -> Trace:
+    """The popularity moves to another set of keys every quarter of the trace, which stale frequencies resist."""
+    rng = random.Random(SEED)
+    phase_length = NUM_OF_REQUESTS // 4
+    keys = []
+    for phase in range(4):
+        keys.extend(key + phase * NUM_OF_KEYS for key in _zipf_keys(phase_length, NUM_OF_KEYS, 0.9, rng))
+    return _with_costs("shifting", keys, rng)
+
+
+def synthetic_traces() -> List[Trace]:
+    return [zipf_trace(), scan_trace(), shifting_trace()]
+
+
+def _read_text_trace(path: str) -> List[Request]:
+    requests = []
+    with open(path) as trace_file:
+        for line_number, line in enumerate(trace_file, 1):
+            fields = line.split()
+            if len(fields) != 4:
+                raise ValueError(f"{path}:{line_number}: expected 'timestamp key latency tokens'")
+            requests.append((int(fields[1]), float(fields[2]), int(fields[3])))
+    return requests
+
+
+def _read_capture(path: str) -> List[Request]:
+    # Like pipeline_sweep: a lookup becomes a request, a hit with the costs it found and a miss with the costs set for
+    # its key afterwards. A miss whose key is never set afterwards is left out.
+    with open(path, "rb") as capture_file:
+        data = capture_file.read()
+    if len(data) % CAPTURE_RECORD.size != 0:
+        raise ValueError(f"{path} ends with a partial record")
+
+    records = []
+    for offset in range(0, len(data), CAPTURE_RECORD.size):
+        if data[offset:offset + len(CAPTURE_MAGIC)] == CAPTURE_MAGIC:
+            _, version, record_size = CAPTURE_HEADER.unpack_from(data, offset)
+            if version != CAPTURE_VERSION or record_size != CAPTURE_RECORD.size:
+                raise ValueError(f"{path} holds a capture of another version")
+            continue
+        records.append(CAPTURE_RECORD.unpack_from(data, offset))
+
+    next_costs: Dict[int, Tuple[float, int]] = {}
+    requests = []
+    for _, key, latency, tokens, op, hit, _ in reversed(records):
+        if op != CAPTURE_LOOKUP or hit:
+            next_costs[key] = (latency, tokens)
+        if op == CAPTURE_LOOKUP and key in next_costs:
+            requests.append((key, *next_costs[key]))
+    requests.reverse()
+    return requests
+
+
+def load_trace(path: str) -> Trace:
+    with open(path, "rb") as trace_file:
+        is_capture = trace_file.read(len(CAPTURE_MAGIC)) == CAPTURE_MAGIC
+    requests = _read_capture(path) if is_capture else _read_text_trace(path)
+    if not requests:
+        raise ValueError(f"{path} holds no requests")
+    return Trace(os.path.basename(path), requests)
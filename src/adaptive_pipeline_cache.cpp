@@ -1,299 +1,1144 @@
-#include <array>
-#include <vector>
-#include <tuple>
 #include <cstdint>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
-#include <fstream>
-#include <nlohmann/json.hpp>
+#include <limits>
+#include <stdexcept>
+#include <bit>
+#include <cassert>
+
 #include "utils.cpp"
-#include "pipeline_block.hpp"
-#include "xxhash.h"
-#include "pipeline_cache.hpp"
+#include "adaptive_pipeline_cache.hpp"
 
-#include <cassert>
+void AdaptivePipelineCache::capture(TraceCapture::Op op, const HashedKey& key, double latency, uint64_t tokens, bool hit)
+{
+    if (m_capture && (!m_capture_sampled_only || is_sampled(key)))
+    {
+        m_capture->record(op, key.id, latency, tokens, hit);
+    }
+}
 
-using Json = nlohmann::json;
+void AdaptivePipelineCache::release_payload(void* payload)
+{
+    if (payload != nullptr)
+    {
+        std::lock_guard<std::mutex> release_guard(m_release_lock);
+        m_released_payloads.push_back(payload);
+        m_has_released_payloads.store(true, std::memory_order_release);
+    }
+}
+
+void AdaptivePipelineCache::release_evicted_payloads(size_t eviction_queue_size_before)
+{
+    for (size_t idx = eviction_queue_size_before; idx < m_main_cache.eviction_queue_size(); ++idx)
+    {
+        EntryData& entry = m_main_cache.evicted_entry(idx);
+        if (entry.payload != nullptr)
+        {
+            release_payload(entry.payload);
+            entry.payload = nullptr;
+            mark_unspillable(entry.id, idx + 1);
+        }
+    }
+}
 
-inline bool should_sample(uint64_t key, uint64_t seed, uint64_t sample_mask) {
-    uint64_t hash = XXH3_64bits_withSeed(&key, sizeof(key), seed);
-    return (hash & sample_mask) == 0;
+void AdaptivePipelineCache::mark_unspillable(uint64_t id, size_t eviction_queue_position)
+{
+    if (m_spill && eviction_queue_position > 0)
+    {
+        size_t& unspillable_below = m_unspillable_below[id];
+        unspillable_below = std::max(unspillable_below, eviction_queue_position);
+    }
 }
 
-class AdaptivePipelineCache {
-private:
-    PipelineCache m_main_cache;
-    PipelineCacheProxy m_main_sampled;
-    std::vector<PipelineCacheProxy> m_ghost_caches;
-    uint64_t ops_since_last_decision;
+bool AdaptivePipelineCache::is_sampled(const HashedKey& key) const
+{
+    return (((key.hash >> 32) ^ m_seed) & m_sample_mask) == 0;
+}
 
-    std::vector<std::pair<uint64_t, uint64_t>> m_ghost_caches_indeces;
-    std::vector<std::string> m_ghost_caches_names;
-    uint64_t m_num_of_ghost_caches;
-    uint64_t m_seed;
-    uint64_t m_decision_window_size;
-    uint64_t m_sample_mask;
+bool AdaptivePipelineCache::is_expired(const HashedKey& key) const
+{
+    return !m_ttl_wheel.empty() && m_ttl_wheel.is_expired(key.id, utils::get_current_time_in_ms());
+}
 
-    void populate_ghost_indeces_and_names(uint64_t num_of_blocks, const std::vector<std::string>& cache_types)
+void AdaptivePipelineCache::remove_key(const HashedKey& key, bool report_eviction)
+{
+    if (report_eviction)
+    {
+        const size_t eviction_queue_size = m_main_cache.eviction_queue_size();
+        m_main_cache.expire_item(key);
+        release_evicted_payloads(eviction_queue_size);
+        mark_unspillable(key.id, m_main_cache.eviction_queue_size());
+    }
+    else
     {
-        m_num_of_ghost_caches = num_of_blocks * (num_of_blocks - 1);
-        for (uint64_t i = 0; i < num_of_blocks; ++i)
+        release_payload(m_main_cache.erase_item(key).payload);
+    }
+    m_ttl_wheel.cancel(key.id);
+    remove_from_simulation(key);
+}
+
+void AdaptivePipelineCache::remove_from_simulation(const HashedKey& key)
+{
+    if (is_sampled(key))
+    {
+        std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+        remove_from_ghost(m_main_sampled, key);
+        for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
         {
-            for (uint64_t j = 0; j < num_of_blocks; ++j)
-            {
-                if (i != j)
-                {
-                    m_ghost_caches_indeces.push_back(std::make_pair(i, j));
-                    const std::string cache_name = "-" + cache_types[i] + "+" + cache_types[j];
-                    m_ghost_caches_names.push_back(cache_name);
-                }
-            }
+            remove_from_ghost(m_ghost_caches[type], key);
+        }
+        for (PipelineCacheProxy& budget_ghost : m_budget_ghosts)
+        {
+            remove_from_ghost(budget_ghost, key);
         }
     }
+}
+
+void AdaptivePipelineCache::expire_batch()
+{
+    if (m_ttl_wheel.empty())
+    {
+        return;
+    }
 
-public:
-    explicit AdaptivePipelineCache(std::string config_path) : m_main_cache{config_path},
-                                                              m_main_sampled{config_path},
-                                                              m_ghost_caches{},
-                                                              ops_since_last_decision{0}
+    m_expired_keys.clear();
+    m_ttl_wheel.collect_expired(utils::get_current_time_in_ms(), EXPIRY_BATCH_SIZE, m_expired_keys);
+    for (uint64_t id : m_expired_keys)
     {
-        std::ifstream config_file(config_path);
-        if (config_file.is_open())
+        if (const HashedKey key{id}; m_main_cache.contains(key))
+        {
+            remove_key(key, true);
+        }
+        else if (m_spill)
         {
-            try {
-                Json config = Json::parse(config_file);
+            m_spill->erase(id);
+        }
+    }
+}
 
-                const uint64_t capacity = config["cache"]["capacity"].get<uint64_t>();
+bool AdaptivePipelineCache::promote_from_spill(const HashedKey& key)
+{
+    if (!m_spill || !m_spill->contains(key.id))
+    {
+        return false;
+    }
 
-                const uint64_t num_of_blocks = config["cache"]["num_of_blocks"].get<uint64_t>();
-                if (num_of_blocks <= 1)
-                {
-                    std::cerr << "num_of_blocks must be 2 or higher" << std::endl;
-                    exit(1);
-                }
+    if (is_expired(key))
+    {
+        m_spill->erase(key.id);
+        m_ttl_wheel.cancel(key.id);
+        return false;
+    }
+
+    return insert_promoted(key, *m_spill->take(key.id));
+}
+
+bool AdaptivePipelineCache::promote_from_shared(const HashedKey& key)
+{
+    if (!m_shared)
+    {
+        return false;
+    }
 
-                if (config["blocks"].size() != num_of_blocks)
-                {
-                    std::cerr << "mismatch between the number of blocks and their definitions" << std::endl;
-                    exit(1);
-                }
+    const std::optional<SharedTier::Record> record = m_shared->get(key, utils::get_current_time_in_ms());
+    if (!record.has_value() || !insert_promoted(key, record->entry))
+    {
+        return false;
+    }
 
-                std::vector<std::string> cache_types;
-                uint64_t total_quanta = 0;
-                for (const auto& block : config["blocks"])
-                {
-                    cache_types.push_back(block["type"].get<std::string>());
-                    total_quanta += block["initial_quanta"].get<uint64_t>();
-                }
+    if (record->deadline_ms != 0)
+    {
+        m_ttl_wheel.schedule(key.id, record->deadline_ms);
+    }
 
-                const uint64_t num_of_quanta = config["cache"]["num_of_quanta"].get<uint64_t>();
+    return true;
+}
 
-                if (total_quanta != num_of_quanta)
-                {
-                    std::cerr << "the total quanta isn't the same as the num_of_quanta" << std::endl;
-                    exit(1);
-                }
+bool AdaptivePipelineCache::insert_promoted(const HashedKey& key, const EntryData& entry)
+{
+    const size_t eviction_queue_size = m_main_cache.eviction_queue_size();
+    mark_unspillable(key.id, eviction_queue_size);
+    m_main_cache.insert_item(key, entry.latency, entry.tokens);
+    EntryValue* promoted = m_main_cache.peek_item(key);
+    if (promoted != nullptr)
+    {
+        promoted->digest = entry.digest;
+    }
+    release_evicted_payloads(eviction_queue_size);
 
-                populate_ghost_indeces_and_names(num_of_blocks, cache_types);
+    return promoted != nullptr;
+}
 
-                m_seed = config["cache"]["seed"].get<uint64_t>();
+bool AdaptivePipelineCache::promote(const HashedKey& key)
+{
+    return promote_from_spill(key) || promote_from_shared(key);
+}
 
-                m_decision_window_size = capacity * config["cache"]["decision_window_multiplier"].get<uint64_t>();
+bool AdaptivePipelineCache::matches_digest(const HashedKey& key, uint64_t digest)
+{
+    return !m_verify_keys || m_main_cache.peek_item(key)->digest == digest;
+}
 
-                const uint64_t sample_rate = config["cache"]["sample_rate"].get<uint64_t>();
+void AdaptivePipelineCache::perform_op_on_ghost(PipelineCacheProxy& proxy, const HashedKey& key, double latency, uint64_t tokens)
+{
+    if (proxy.contains(key))
+    {
+        proxy.get_item(key);
+    }
+    else 
+    {
+        proxy.insert_item(key, latency, tokens);
+        if (proxy.should_evict())
+        {
+            proxy.evict_item();
+        }
+    }
+}
 
-                if (!utils::is_power_of_two(sample_rate))
-                {
-                    std::cerr << "the sample_rate must be a power of two" << std::endl;
-                    exit(1);
-                }
-                m_sample_mask = sample_rate - 1;
-            }
-            catch (const Json::exception& e) {
-                std::cerr << "ERROR: Failed to read cache config: " << e.what() << "\n";
-                exit(1);
-            }
+void AdaptivePipelineCache::remove_from_ghost(PipelineCacheProxy& proxy, const HashedKey& key)
+{
+    if (proxy.contains(key))
+    {
+        proxy.erase_item(key);
+    }
+}
 
-            m_ghost_caches.resize(m_num_of_ghost_caches);
+void AdaptivePipelineCache::adapt()
+{
+    const LatencyHistograms::ScopedTimer timer(m_histograms.get(), Op::ADAPT);
+    ops_since_last_decision = 0;
+    const double current_timeframe_cost = m_main_cache.get_timeframe_aggregated_cost();
+    m_main_cache.reset_timeframe_stats();
 
-            create_ghost_caches();
+    double minimal_timeframe_ghost_cost = std::numeric_limits<double>::max();
+    uint64_t minimal_idx = std::numeric_limits<uint64_t>::max();
 
-            config_file.close();
-        } else {
-            std::cerr << "Warning: config.json not found" << std::endl;
-            exit(1);
+    for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
+    {
+        const double curr_ghost_cache_cost = m_ghost_caches[type].get_timeframe_aggregated_cost();
+        m_ghost_caches[type].reset_timeframe_stats();
+        if (m_event_log)
+        {
+            m_event_log->log_ghost_cost(type, m_ghost_caches_indeces[type].first,
+                                        m_ghost_caches_indeces[type].second, curr_ghost_cache_cost);
+        }
+        if (curr_ghost_cache_cost < minimal_timeframe_ghost_cost)
+        {
+            minimal_timeframe_ghost_cost = curr_ghost_cache_cost;
+            minimal_idx = type;
         }
     }
 
-    std::tuple<double, uint64_t> getitem(uint64_t key) 
+    assert(minimal_idx < m_num_of_ghost_caches
+        && minimal_timeframe_ghost_cost < std::numeric_limits<double>::max());
+
+    if (minimal_timeframe_ghost_cost < current_timeframe_cost)
     {
-        ++ops_since_last_decision;
-        const EntryData& entry = m_main_cache.get_item(key);
-        std::tuple<double, uint64_t> item = std::make_tuple(entry.latency, entry.tokens);
-        
-        if (should_sample(key, m_seed, m_sample_mask))
-        {   
-            const double latency = entry.latency;
-            const uint64_t tokens = entry.tokens;
+        const std::pair<uint64_t, uint64_t> indeces_for_adaption = m_ghost_caches_indeces[minimal_idx];
+        assert(m_main_cache.can_adapt(indeces_for_adaption.first, false) && m_main_cache.can_adapt(indeces_for_adaption.second, true));
+        m_main_cache.move_quantum(indeces_for_adaption.first, indeces_for_adaption.second);
+        m_main_sampled.move_quantum(indeces_for_adaption.first, indeces_for_adaption.second);
+        if (m_event_log)
+        {
+            m_event_log->log_decision(minimal_idx, current_timeframe_cost, minimal_timeframe_ghost_cost,
+                                      indeces_for_adaption.first, indeces_for_adaption.second);
+            m_event_log->log_quantum_move(indeces_for_adaption.first, indeces_for_adaption.second,
+                                          m_main_cache.quanta_alloc());
+        }
 
-            perform_op_on_ghost(m_main_sampled, key, latency, tokens);
+        create_ghost_caches();
+        // The budget ghosts follow the allocation as well, so they keep differing from the cache by the budget
+        // quantum only. The costs of the timeframe so far carry over.
+        if (m_budget_quantum > 0)
+        {
+            const BudgetCosts costs = budget_costs_locked();
+            create_budget_ghosts();
+            m_budget_carried_costs = costs;
+        }
+    }
+    else if (m_event_log)
+    {
+        m_event_log->log_decision(minimal_idx, current_timeframe_cost, minimal_timeframe_ghost_cost,
+                                  EventLog::NO_BLOCK, EventLog::NO_BLOCK);
+    }
 
-            for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
-            {
-                perform_op_on_ghost(m_ghost_caches[type], key, latency, tokens);
-            }
+}
+
+void AdaptivePipelineCache::create_ghost_caches()
+{
+    const LatencyHistograms::ScopedTimer timer(m_histograms.get(), Op::CREATE_GHOST_CACHES);
+    m_main_sampled.prepare_for_copy();
+
+    for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
+    {
+        const std::pair<uint64_t, uint64_t> indeces = m_ghost_caches_indeces[type];
+        m_ghost_caches[type] = m_main_sampled;
+        if (m_main_sampled.can_adapt(indeces.first, false) && m_main_sampled.can_adapt(indeces.second, true))
+        {
+            m_ghost_caches[type].make_non_dummy();
+            m_ghost_caches[type].move_quantum(indeces.first, indeces.second);
         }
+        else
+        {
+            m_ghost_caches[type].make_dummy();
+        }
+    }
+}
+
+void AdaptivePipelineCache::create_budget_ghosts()
+{
+    m_main_sampled.reset_timeframe_stats();
+    m_budget_carried_costs = BudgetCosts{};
+    const uint64_t capacity = m_config["cache"]["capacity"].get<uint64_t>();
+    Json ghost_config = m_config;
+
+    PipelineCacheProxy& shrunk = m_budget_ghosts[0];
+    shrunk = m_main_sampled;
+    if (capacity > m_budget_quantum)
+    {
+        ghost_config["cache"]["capacity"] = capacity - m_budget_quantum;
+        shrunk.resize(ghost_config);
+    }
+    else
+    {
+        shrunk.make_dummy();
+    }
+
+    PipelineCacheProxy& grown = m_budget_ghosts[1];
+    grown = m_main_sampled;
+    ghost_config["cache"]["capacity"] = capacity + m_budget_quantum;
+    grown.resize(ghost_config);
+}
+
+AdaptivePipelineCache::BudgetCosts AdaptivePipelineCache::budget_costs_locked() const
+{
+    // A missing smaller ghost costs the maximum, which must not overflow once carried over.
+    const auto add = [](double carried_cost, double cost) {
+        return std::min(carried_cost + cost, std::numeric_limits<double>::max());
+    };
+
+    return BudgetCosts{add(m_budget_carried_costs.shrunk, m_budget_ghosts[0].get_timeframe_total_cost()),
+                       add(m_budget_carried_costs.current, m_main_sampled.get_timeframe_total_cost()),
+                       add(m_budget_carried_costs.grown, m_budget_ghosts[1].get_timeframe_total_cost())};
+}
 
-        return item;
+void AdaptivePipelineCache::simulate_op(const HashedKey& key, double latency, uint64_t tokens)
+{
+    const LatencyHistograms::ScopedTimer timer(m_histograms.get(), Op::GHOST_SIMULATION);
+    perform_op_on_ghost(m_main_sampled, key, latency, tokens);
+
+    for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
+    {
+        perform_op_on_ghost(m_ghost_caches[type], key, latency, tokens);
+    }
+
+    for (PipelineCacheProxy& budget_ghost : m_budget_ghosts)
+    {
+        perform_op_on_ghost(budget_ghost, key, latency, tokens);
+    }
+}
+
+std::optional<AdaptivePipelineCache::CachedValue> AdaptivePipelineCache::lookup_locked(const HashedKey& key, EntryValue* entry, uint64_t digest, bool pin_payload)
+{
+    if (entry == nullptr)
+    {
+        if (!promote(key))
+        {
+            return std::nullopt;
+        }
+        entry = m_main_cache.peek_item(key);
     }
 
-    void setitem(uint64_t key, const std::tuple<double, uint64_t>& value) 
+    if (is_expired(key))
     {
-        ++ops_since_last_decision;
-        const auto [latency, tokens] = value;
-        m_main_cache.insert_item(key, latency, tokens);
-        
-        if (should_sample(key, m_seed, m_sample_mask))
-        {   
-            perform_op_on_ghost(m_main_sampled, key, latency, tokens);
+        remove_key(key, true);
+        return std::nullopt;
+    }
 
-            for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
+    if (m_verify_keys && entry->digest != digest)
+    {
+        return std::nullopt;
+    }
+
+    ++ops_since_last_decision;
+    m_main_cache.get_item(key);
+    const double latency = entry->latency;
+    const uint64_t tokens = entry->tokens;
+    void* const payload = entry->payload;
+    if (pin_payload && payload != nullptr && m_retain_payload != nullptr)
+    {
+        m_pinned_payloads.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return CachedValue{latency, tokens, payload};
+}
+
+std::optional<AdaptivePipelineCache::CachedValue> AdaptivePipelineCache::lookup(const HashedKey& key, uint64_t digest, bool pin_payload)
+{
+    LatencyHistograms::ScopedTimer timer(m_histograms.get(), Op::LOOKUP_MISS);
+    std::unique_lock<std::mutex> main_guard(m_main_lock);
+    const std::optional<CachedValue> value = lookup_locked(key, m_main_cache.peek_item(key), digest, pin_payload);
+    main_guard.unlock();
+    if (value.has_value())
+    {
+        timer.set_op(Op::LOOKUP_HIT);
+    }
+    capture(TraceCapture::Op::LOOKUP, key, value.has_value() ? value->latency : 0.0,
+            value.has_value() ? value->tokens : 0, value.has_value());
+    
+    if (value.has_value() && is_sampled(key))
+    {   
+        std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+        simulate_op(key, value->latency, value->tokens);
+    }
+
+    return value;
+}
+
+std::vector<std::optional<AdaptivePipelineCache::CachedValue>> AdaptivePipelineCache::lookup_batch(const std::vector<uint64_t>& ids,
+                                                                                                   const std::vector<uint64_t>& digests,
+                                                                                                   bool pin_payload)
+{
+    const LatencyHistograms::ScopedTimer timer(m_histograms.get(), Op::LOOKUP_BATCH);
+    const std::vector<HashedKey> keys(ids.begin(), ids.end());
+    std::vector<std::optional<CachedValue>> values(keys.size());
+
+    bool has_sampled_hits = false;
+    {
+        std::lock_guard<std::mutex> main_guard(m_main_lock);
+        for_each_resolved(keys, [&](size_t idx, EntryValue* entry) {
+            values[idx] = lookup_locked(keys[idx], entry, digests.empty() ? 0 : digests[idx], pin_payload);
+            has_sampled_hits = has_sampled_hits || (values[idx].has_value() && is_sampled(keys[idx]));
+        });
+    }
+
+    for (size_t idx = 0; idx < keys.size(); ++idx)
+    {
+        capture(TraceCapture::Op::LOOKUP, keys[idx], values[idx].has_value() ? values[idx]->latency : 0.0,
+                values[idx].has_value() ? values[idx]->tokens : 0, values[idx].has_value());
+    }
+
+    if (has_sampled_hits)
+    {
+        std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+        for (size_t idx = 0; idx < keys.size(); ++idx)
+        {
+            if (values[idx].has_value() && is_sampled(keys[idx]))
             {
-                perform_op_on_ghost(m_ghost_caches[type], key, latency, tokens);
+                simulate_op(keys[idx], values[idx]->latency, values[idx]->tokens);
             }
         }
+    }
+
+    return values;
+}
 
-        if (ops_since_last_decision >= m_decision_window_size
-            && m_main_cache.size() == m_main_cache.capacity())
+void AdaptivePipelineCache::store_locked(const HashedKey& key,
+                                         EntryValue* cached_entry,
+                                         double latency,
+                                         uint64_t tokens,
+                                         std::optional<double> ttl,
+                                         uint64_t digest,
+                                         void* payload)
+{
+    ++ops_since_last_decision;
+    const size_t eviction_queue_size = m_main_cache.eviction_queue_size();
+    mark_unspillable(key.id, eviction_queue_size);
+    m_main_cache.insert_item(key, latency, tokens);
+    EntryValue* entry = cached_entry != nullptr ? cached_entry : m_main_cache.peek_item(key);
+    if (entry != nullptr)
+    {
+        if (m_verify_keys)
         {
-            ops_since_last_decision = 0;
-            adapt();
+            entry->digest = digest;
         }
+        release_payload(entry->payload);
+        entry->payload = payload;
+    }
+    else
+    {
+        // Rejected by an admission gate.
+        release_payload(payload);
+    }
+    release_evicted_payloads(eviction_queue_size);
+    if (m_spill)
+    {
+        m_spill->erase(key.id);
     }
 
-    static void perform_op_on_ghost(PipelineCacheProxy& proxy, uint64_t key, double latency, uint64_t tokens)
+    uint64_t deadline_ms = 0;
+    if (ttl.has_value())
     {
-        if (proxy.contains(key))
+        const auto ttl_ms = static_cast<uint64_t>(std::ceil(std::max(*ttl, 0.0) * 1000.0));
+        deadline_ms = utils::get_current_time_in_ms() + ttl_ms;
+        m_ttl_wheel.schedule(key.id, deadline_ms);
+    }
+    else if (!m_ttl_wheel.empty())
+    {
+        m_ttl_wheel.cancel(key.id);
+    }
+
+    // Like the spill tier, the segment only holds plain entries: a payload can't be shared with the other
+    // processes, nor promoted back without it, and an entry rejected by a gate must not come back as a hit.
+    // The older copy of such a key is removed instead, so it isn't promoted in place of the new value.
+    if (m_shared)
+    {
+        if (entry != nullptr && payload == nullptr)
         {
-            proxy.get_item(key);
+            EntryData shared_entry{key, latency, tokens};
+            shared_entry.digest = m_verify_keys ? digest : 0;
+            m_shared->put(shared_entry, deadline_ms);
         }
-        else 
+        else
         {
-            proxy.insert_item(key, latency, tokens);
-            if (proxy.should_evict())
-            {
-                proxy.evict_item();
-            }
+            m_shared->erase(key);
         }
     }
+}
+
+bool AdaptivePipelineCache::finish_store(std::unique_lock<std::mutex>& main_guard)
+{
+    expire_batch();
 
-    void adapt()
+    const bool should_adapt = ops_since_last_decision >= m_decision_window_size
+                              && m_main_cache.size() == m_main_cache.capacity();
+    if (should_adapt)
     {
         ops_since_last_decision = 0;
-        const double current_timeframe_cost = m_main_cache.get_timeframe_aggregated_cost();
-        m_main_cache.reset_timeframe_stats();
+    }
+    else
+    {
+        main_guard.unlock();
+    }
 
-        double minimal_timeframe_ghost_cost = std::numeric_limits<double>::max();
-        uint64_t minimal_idx = std::numeric_limits<uint64_t>::max();
+    return should_adapt;
+}
 
-        for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
+void AdaptivePipelineCache::populate_ghost_indeces_and_names(uint64_t num_of_blocks, const std::vector<std::string>& cache_types)
+{
+    m_num_of_ghost_caches = num_of_blocks * (num_of_blocks - 1);
+    for (uint64_t i = 0; i < num_of_blocks; ++i)
+    {
+        for (uint64_t j = 0; j < num_of_blocks; ++j)
         {
-            const double curr_ghost_cache_cost = m_ghost_caches[type].get_timeframe_aggregated_cost();
-            m_ghost_caches[type].reset_timeframe_stats();
-            if (curr_ghost_cache_cost < minimal_timeframe_ghost_cost)
+            if (i != j)
             {
-                minimal_timeframe_ghost_cost = curr_ghost_cache_cost;
-                minimal_idx = type;
+                m_ghost_caches_indeces.push_back(std::make_pair(i, j));
+                const std::string cache_name = "-" + cache_types[i] + "+" + cache_types[j];
+                m_ghost_caches_names.push_back(cache_name);
             }
         }
+    }
+}
 
-        assert(minimal_idx < m_num_of_ghost_caches
-            && minimal_timeframe_ghost_cost < std::numeric_limits<double>::max());
+AdaptivePipelineCache::AdaptivePipelineCache(Json config) : m_main_cache{false, config},
+                                                            m_main_sampled{config},
+                                                            m_ghost_caches{},
+                                                            ops_since_last_decision{0},
+                                                            m_config(config),
+                                                            m_budget_quantum{0},
+                                                            m_budget_ghosts{},
+                                                            m_budget_carried_costs{},
+                                                            m_verify_keys{false},
+                                                            m_ttl_wheel{utils::get_current_time_in_ms()},
+                                                            m_expired_keys{},
+                                                            m_spill{},
+                                                            m_unspillable_below{},
+                                                            m_shared{},
+                                                            m_histograms{},
+                                                            m_event_log{},
+                                                            m_capture{},
+                                                            m_capture_sampled_only{false},
+                                                            m_retain_payload{nullptr},
+                                                            m_release_payload{nullptr},
+                                                            m_released_payloads{},
+                                                            m_has_released_payloads{false},
+                                                            m_pinned_payloads{0}
+{
+    try {
+        const uint64_t capacity = config["cache"]["capacity"].get<uint64_t>();
 
-        if (minimal_timeframe_ghost_cost < current_timeframe_cost)
+        const uint64_t num_of_blocks = config["cache"]["num_of_blocks"].get<uint64_t>();
+        if (num_of_blocks <= 1)
         {
-            const std::pair<uint64_t, uint64_t> indeces_for_adaption = m_ghost_caches_indeces[minimal_idx];
-            assert(m_main_cache.can_adapt(indeces_for_adaption.first, false) && m_main_cache.can_adapt(indeces_for_adaption.second, true));
-            m_main_cache.move_quantum(indeces_for_adaption.first, indeces_for_adaption.second);
-            m_main_sampled.move_quantum(indeces_for_adaption.first, indeces_for_adaption.second);
+            std::cerr << "num_of_blocks must be 2 or higher" << std::endl;
+            exit(1);
+        }
 
-            create_ghost_caches();
+        if (config["blocks"].size() != num_of_blocks)
+        {
+            std::cerr << "mismatch between the number of blocks and their definitions" << std::endl;
+            exit(1);
         }
 
-    }
+        std::vector<std::string> cache_types;
+        uint64_t total_quanta = 0;
+        for (const auto& block : config["blocks"])
+        {
+            cache_types.push_back(block["type"].get<std::string>());
+            total_quanta += block["initial_quanta"].get<uint64_t>();
+        }
 
-    void create_ghost_caches()
-    {
-        m_main_sampled.prepare_for_copy();
+        const uint64_t num_of_quanta = config["cache"]["num_of_quanta"].get<uint64_t>();
 
-        for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
+        if (total_quanta != num_of_quanta)
         {
-            const std::pair<uint64_t, uint64_t> indeces = m_ghost_caches_indeces[type];
-            m_ghost_caches[type] = m_main_sampled;
-            if (m_main_sampled.can_adapt(indeces.first, false) && m_main_sampled.can_adapt(indeces.second, true))
+            std::cerr << "the total quanta isn't the same as the num_of_quanta" << std::endl;
+            exit(1);
+        }
+
+        populate_ghost_indeces_and_names(num_of_blocks, cache_types);
+
+        m_seed = config["cache"]["seed"].get<uint64_t>();
+
+        m_decision_window_size = capacity * config["cache"]["decision_window_multiplier"].get<uint64_t>();
+
+        const uint64_t sample_rate = config["cache"]["sample_rate"].get<uint64_t>();
+
+        if (!utils::is_power_of_two(sample_rate))
+        {
+            std::cerr << "the sample_rate must be a power of two" << std::endl;
+            exit(1);
+        }
+        m_sample_mask = sample_rate - 1;
+
+        m_verify_keys = config["cache"].value("verify_keys", false);
+
+        if (config.contains("spill"))
+        {
+            const uint64_t spill_capacity = config["spill"]["capacity"].get<uint64_t>();
+            if (spill_capacity == 0)
+            {
+                std::cerr << "the spill capacity must be positive" << std::endl;
+                exit(1);
+            }
+
+            m_spill = std::make_unique<SpillTier>(config["spill"]["path"].get<std::string>(), spill_capacity);
+        }
+
+        if (config.contains("shared"))
+        {
+            const std::string shared_name = config["shared"]["name"].get<std::string>();
+            const uint64_t shared_capacity = config["shared"]["capacity"].get<uint64_t>();
+            if (shared_name.empty() || shared_name[0] != '/' || shared_capacity == 0)
             {
-                m_ghost_caches[type].make_non_dummy();
-                m_ghost_caches[type].move_quantum(indeces.first, indeces.second);
+                std::cerr << "the shared tier needs a name starting with '/' and a positive capacity" << std::endl;
+                exit(1);
             }
-            else
+
+            m_shared = std::make_unique<SharedTier>(shared_name, shared_capacity);
+        }
+
+        if (config.contains("metrics") && config["metrics"].value("latency_histograms", false))
+        {
+            m_histograms = std::make_unique<LatencyHistograms>();
+        }
+
+        if (config.contains("event_log"))
+        {
+            const uint64_t event_log_capacity = config["event_log"].value("capacity", 4096ULL);
+            const uint64_t flush_interval_ms = config["event_log"].value("flush_interval_ms", 1000ULL);
+            if (!std::has_single_bit(event_log_capacity) || flush_interval_ms == 0)
             {
-                m_ghost_caches[type].make_dummy();
+                std::cerr << "the event_log capacity must be a power of two and its flush_interval_ms positive" << std::endl;
+                exit(1);
             }
+
+            m_event_log = std::make_unique<EventLog>(config["event_log"]["path"].get<std::string>(),
+                                                     event_log_capacity, flush_interval_ms);
+            m_main_cache.set_event_log(m_event_log.get());
         }
+
+        if (config.contains("capture"))
+        {
+            const uint64_t max_file_bytes = config["capture"].value("max_file_bytes", 64ULL << 20);
+            const uint64_t max_files = config["capture"].value("max_files", 4ULL);
+            const uint64_t flush_interval_ms = config["capture"].value("flush_interval_ms", 1000ULL);
+            if (max_file_bytes < sizeof(TraceCapture::FileHeader) + sizeof(TraceCapture::Record)
+                || max_files < 2 || flush_interval_ms == 0)
+            {
+                std::cerr << "the capture max_file_bytes must fit a record, its max_files be at least 2 and its flush_interval_ms positive" << std::endl;
+                exit(1);
+            }
+
+            m_capture_sampled_only = config["capture"].value("sampled_only", false);
+            m_capture = std::make_unique<TraceCapture>(config["capture"]["path"].get<std::string>(),
+                                                       max_file_bytes, max_files, flush_interval_ms);
+        }
+    }
+    catch (const Json::exception& e) {
+        std::cerr << "ERROR: Failed to read cache config: " << e.what() << "\n";
+        exit(1);
     }
 
-    void delitem(uint64_t key) 
+    m_ghost_caches.resize(m_num_of_ghost_caches);
+
+    create_ghost_caches();
+}
+
+std::optional<std::tuple<double, uint64_t>> AdaptivePipelineCache::find(uint64_t key, uint64_t digest)
+{
+    const std::optional<CachedValue> value = lookup(HashedKey{key}, digest, false);
+    if (!value.has_value())
     {
-        
+        return std::nullopt;
     }
 
-    bool contains(uint64_t key) const 
+    return std::make_tuple(value->latency, value->tokens);
+}
+
+std::optional<AdaptivePipelineCache::CachedValue> AdaptivePipelineCache::find_value(uint64_t key, uint64_t digest)
+{
+    return lookup(HashedKey{key}, digest, true);
+}
+
+void AdaptivePipelineCache::retain_found_payload(const CachedValue& value)
+{
+    if (value.payload != nullptr && m_retain_payload != nullptr)
     {
-        return m_main_cache.contains(key);
+        m_retain_payload(value.payload);
+        m_pinned_payloads.fetch_sub(1, std::memory_order_release);
     }
+}
 
-    std::pair<uint64_t, std::tuple<double, uint64_t>> popitem() 
+std::vector<std::optional<std::tuple<double, uint64_t>>> AdaptivePipelineCache::find_batch(const std::vector<uint64_t>& keys,
+                                                                                           const std::vector<uint64_t>& digests)
+{
+    const std::vector<std::optional<CachedValue>> values = lookup_batch(keys, digests, false);
+    std::vector<std::optional<std::tuple<double, uint64_t>>> res;
+    res.reserve(values.size());
+    for (const std::optional<CachedValue>& value : values)
     {
-        if (m_main_cache.should_evict())
+        res.push_back(value.has_value() ? std::make_optional(std::make_tuple(value->latency, value->tokens)) : std::nullopt);
+    }
+
+    return res;
+}
+
+std::vector<std::optional<AdaptivePipelineCache::CachedValue>> AdaptivePipelineCache::find_value_batch(const std::vector<uint64_t>& keys,
+                                                                                                       const std::vector<uint64_t>& digests)
+{
+    return lookup_batch(keys, digests, true);
+}
+
+AdaptivePipelineCache::~AdaptivePipelineCache()
+{
+    m_main_cache.collect_payloads(m_released_payloads);
+    m_has_released_payloads = true;
+    release_pending_payloads();
+}
+
+void AdaptivePipelineCache::set_payload_hooks(PayloadHook retain, PayloadHook release)
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    m_retain_payload = retain;
+    m_release_payload = release;
+}
+
+void AdaptivePipelineCache::release_pending_payloads()
+{
+    if (!m_has_released_payloads.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    std::vector<void*> payloads;
+    {
+        std::lock_guard<std::mutex> release_guard(m_release_lock);
+        if (m_pinned_payloads.load(std::memory_order_acquire) != 0)
         {
-            const EntryData entry = m_main_cache.evict_item();
+            return;
+        }
+        payloads.swap(m_released_payloads);
+        m_has_released_payloads.store(false, std::memory_order_relaxed);
+    }
 
-            return std::make_pair(entry.id, std::make_tuple(entry.latency, entry.tokens));
+    if (m_release_payload != nullptr)
+    {
+        for (void* payload : payloads)
+        {
+            m_release_payload(payload);
         }
+    }
+}
+
+std::tuple<double, uint64_t> AdaptivePipelineCache::getitem(uint64_t key)
+{
+    std::optional<std::tuple<double, uint64_t>> item = find(key);
+    if (!item.has_value())
+    {
+        throw std::out_of_range("The key is not in the cache");
+    }
+
+    return *item;
+}
+
+void AdaptivePipelineCache::setitem(uint64_t id,
+                                    const std::tuple<double, uint64_t>& value,
+                                    std::optional<double> ttl,
+                                    uint64_t digest,
+                                    void* payload)
+{
+    const LatencyHistograms::ScopedTimer timer(m_histograms.get(), Op::SETITEM);
+    const HashedKey key{id};
+    const auto [latency, tokens] = value;
+    capture(TraceCapture::Op::SETITEM, key, latency, tokens, false);
+    std::unique_lock<std::mutex> main_guard(m_main_lock);
+    store_locked(key, nullptr, latency, tokens, ttl, digest, payload);
+    const bool should_adapt = finish_store(main_guard);
+
+    const bool should_simulate = is_sampled(key);
+    if (should_simulate || should_adapt)
+    {
+        std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+        if (should_simulate)
+        {
+            simulate_op(key, latency, tokens);
+        }
+
+        if (should_adapt)
+        {
+            adapt();
+        }
+    }
+}
 
-        return std::make_pair(0, std::make_tuple(0, std::numeric_limits<uint64_t>::max()));
+void AdaptivePipelineCache::setitem_batch(const std::vector<uint64_t>& ids,
+                                          const std::vector<std::tuple<double, uint64_t>>& values,
+                                          const std::vector<uint64_t>& digests,
+                                          const std::vector<void*>& payloads)
+{
+    assert(ids.size() == values.size());
+    const LatencyHistograms::ScopedTimer timer(m_histograms.get(), Op::SETITEM_BATCH);
+    const std::vector<HashedKey> keys(ids.begin(), ids.end());
+    for (size_t idx = 0; idx < keys.size(); ++idx)
+    {
+        capture(TraceCapture::Op::SETITEM, keys[idx], std::get<0>(values[idx]), std::get<1>(values[idx]), false);
     }
 
-    std::tuple<double, uint64_t> get(uint64_t key, const std::tuple<double, uint64_t>& default_value = std::make_tuple(0.0, 0)) 
+    std::unique_lock<std::mutex> main_guard(m_main_lock);
+    for_each_resolved(keys, [&](size_t idx, EntryValue* entry) {
+        const auto [latency, tokens] = values[idx];
+        store_locked(keys[idx], entry, latency, tokens, std::nullopt,
+                     digests.empty() ? 0 : digests[idx],
+                     payloads.empty() ? nullptr : payloads[idx]);
+    });
+    const bool should_adapt = finish_store(main_guard);
+
+    std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+    for (size_t idx = 0; idx < keys.size(); ++idx)
     {
-        return getitem(key);
+        if (is_sampled(keys[idx]))
+        {
+            simulate_op(keys[idx], std::get<0>(values[idx]), std::get<1>(values[idx]));
+        }
     }
 
-    std::vector<uint64_t> keys() const 
+    if (should_adapt)
     {
-        return m_main_cache.keys();
+        adapt();
     }
+}
 
-    std::vector<std::tuple<double, uint64_t>> values() const 
+bool AdaptivePipelineCache::delitem(uint64_t id, uint64_t digest)
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    return take_locked(HashedKey{id}, digest, false).has_value();
+}
+
+std::optional<AdaptivePipelineCache::CachedValue> AdaptivePipelineCache::take_value(uint64_t id, uint64_t digest)
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    return take_locked(HashedKey{id}, digest, true);
+}
+
+std::optional<AdaptivePipelineCache::CachedValue> AdaptivePipelineCache::take_locked(const HashedKey& key,
+                                                                                     uint64_t digest,
+                                                                                     bool pin_payload)
+{
+    const EntryValue* entry = m_main_cache.peek_item(key);
+    if (entry == nullptr)
     {
-        return m_main_cache.values();
+        return erase_unpromoted(key, digest);
     }
 
-    size_t maxsize() const { return m_main_cache.capacity(); }
-    size_t currsize() const { return m_main_cache.size(); }
-    bool empty() const { return m_main_cache.empty(); }
+    if (m_verify_keys && entry->digest != digest)
+    {
+        return std::nullopt;
+    }
 
-    void clear() 
+    const bool was_expired = is_expired(key);
+    const CachedValue value{entry->latency, entry->tokens, was_expired ? nullptr : entry->payload};
+    if (pin_payload && value.payload != nullptr && m_retain_payload != nullptr)
     {
-        m_main_cache.clear();
-        m_main_sampled.clear();
-        for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
+        m_pinned_payloads.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    remove_key(key, false);
+    mark_unspillable(key.id, m_main_cache.eviction_queue_size());
+    if (m_spill)
+    {
+        m_spill->erase(key.id);
+    }
+    if (m_shared)
+    {
+        m_shared->erase(key);
+    }
+    if (was_expired)
+    {
+        return std::nullopt;
+    }
+
+    return value;
+}
+
+std::optional<AdaptivePipelineCache::CachedValue> AdaptivePipelineCache::erase_unpromoted(const HashedKey& key, uint64_t digest)
+{
+    // Evicted entries of the key still waiting to be popped must not be spilled once it is deleted.
+    mark_unspillable(key.id, m_main_cache.eviction_queue_size());
+
+    std::optional<EntryData> found;
+    if (m_spill)
+    {
+        found = m_spill->peek(key.id);
+    }
+    if (!found.has_value() && m_shared)
+    {
+        if (const std::optional<SharedTier::Record> record = m_shared->get(key, utils::get_current_time_in_ms());
+            record.has_value())
         {
-            m_ghost_caches[type].clear();
+            found = record->entry;
         }
     }
 
-    std::string repr() const 
+    if (!found.has_value() || (m_verify_keys && found->digest != digest))
+    {
+        return std::nullopt;
+    }
+
+    const bool was_expired = is_expired(key);
+    m_ttl_wheel.cancel(key.id);
+    remove_from_simulation(key);
+    if (m_spill)
+    {
+        m_spill->erase(key.id);
+    }
+    if (m_shared)
+    {
+        m_shared->erase(key);
+    }
+    if (was_expired)
+    {
+        return std::nullopt;
+    }
+
+    return CachedValue{found->latency, found->tokens, nullptr};
+}
+
+bool AdaptivePipelineCache::contains(uint64_t id, uint64_t digest)
+{
+    const HashedKey key{id};
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    if (!m_main_cache.contains(key) && !promote(key))
+    {
+        return false;
+    }
+
+    if (is_expired(key))
     {
-        return m_main_cache.get_current_config();
+        remove_key(key, true);
+        return false;
     }
-};
+
+    return matches_digest(key, digest);
+}
+
+std::optional<std::pair<uint64_t, std::tuple<double, uint64_t>>> AdaptivePipelineCache::popitem()
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    if (m_main_cache.should_evict())
+    {
+        const size_t position = m_main_cache.eviction_queue_size() - 1;
+        const EntryData entry = m_main_cache.evict_item();
+        if (m_spill)
+        {
+            // A resident key was set again after the entry was queued, its older value is dropped.
+            const auto unspillable_below = m_unspillable_below.find(entry.id);
+            if (!m_main_cache.contains(entry.key())
+                && (unspillable_below == m_unspillable_below.end() || position >= unspillable_below->second))
+            {
+                m_spill->put(entry);
+            }
+            if (!m_main_cache.should_evict())
+            {
+                m_unspillable_below.clear();
+            }
+        }
+
+        return std::make_pair(entry.id, std::make_tuple(entry.latency, entry.tokens));
+    }
+
+    return std::nullopt;
+}
+
+std::tuple<double, uint64_t> AdaptivePipelineCache::get(uint64_t key, const std::tuple<double, uint64_t>& default_value)
+{
+    return find(key).value_or(default_value);
+}
+
+std::vector<uint64_t> AdaptivePipelineCache::keys() const
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    return m_main_cache.keys();
+}
+
+std::vector<std::tuple<double, uint64_t>> AdaptivePipelineCache::values() const
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    return m_main_cache.values();
+}
+
+std::vector<std::pair<uint64_t, std::tuple<double, uint64_t>>> AdaptivePipelineCache::items() const
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    const std::vector<uint64_t> keys = m_main_cache.keys();
+    const std::vector<std::tuple<double, uint64_t>> values = m_main_cache.values();
+
+    std::vector<std::pair<uint64_t, std::tuple<double, uint64_t>>> res;
+    res.reserve(keys.size());
+    for (uint64_t i = 0; i < keys.size(); ++i)
+    {
+        res.emplace_back(keys[i], values[i]);
+    }
+
+    return res;
+}
+
+void AdaptivePipelineCache::flush_capture()
+{
+    if (m_capture)
+    {
+        m_capture->flush();
+    }
+}
+
+void AdaptivePipelineCache::flush_event_log()
+{
+    if (m_event_log)
+    {
+        m_event_log->flush();
+    }
+}
+
+void AdaptivePipelineCache::resize(uint64_t new_capacity)
+{
+    const uint64_t num_of_quanta = m_config["cache"]["num_of_quanta"].get<uint64_t>();
+    if (new_capacity == 0 || new_capacity % (num_of_quanta * (m_sample_mask + 1)) != 0
+        || new_capacity >= std::numeric_limits<uint32_t>::max())
+    {
+        throw std::invalid_argument("the capacity must be a multiple of num_of_quanta * sample_rate below 2^32");
+    }
+
+    std::scoped_lock guard(m_main_lock, m_ghost_lock);
+    m_config["cache"]["capacity"] = new_capacity;
+
+    const size_t eviction_queue_size = m_main_cache.eviction_queue_size();
+    m_main_cache.resize(false, m_config);
+    release_evicted_payloads(eviction_queue_size);
+    m_main_sampled.resize(m_config);
+
+    // The next decision compares the main cache with ghosts of the new capacity over a whole window.
+    m_decision_window_size = new_capacity * m_config["cache"]["decision_window_multiplier"].get<uint64_t>();
+    ops_since_last_decision = 0;
+    m_main_cache.reset_timeframe_stats();
+    create_ghost_caches();
+    if (m_budget_quantum > 0)
+    {
+        create_budget_ghosts();
+    }
+}
+
+void AdaptivePipelineCache::enable_budget_ghosts(uint64_t quantum_size)
+{
+    const uint64_t num_of_quanta = m_config["cache"]["num_of_quanta"].get<uint64_t>();
+    if (quantum_size == 0 || quantum_size % (num_of_quanta * (m_sample_mask + 1)) != 0)
+    {
+        throw std::invalid_argument("the budget quantum must be a multiple of num_of_quanta * sample_rate");
+    }
+
+    std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+    m_budget_quantum = quantum_size;
+    m_budget_ghosts.resize(2);
+    create_budget_ghosts();
+}
+
+AdaptivePipelineCache::BudgetCosts AdaptivePipelineCache::budget_costs()
+{
+    std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+    assert(m_budget_quantum > 0);
+    return budget_costs_locked();
+}
+
+std::vector<uint64_t> AdaptivePipelineCache::quanta_alloc() const
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    return m_main_cache.quanta_alloc();
+}
+
+std::vector<std::vector<uint64_t>> AdaptivePipelineCache::budget_ghosts_quanta_alloc()
+{
+    std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+    std::vector<std::vector<uint64_t>> res;
+    for (const PipelineCacheProxy& budget_ghost : m_budget_ghosts)
+    {
+        res.push_back(budget_ghost.quanta_alloc());
+    }
+
+    return res;
+}
+
+void AdaptivePipelineCache::reset_budget_ghosts()
+{
+    std::lock_guard<std::mutex> ghost_guard(m_ghost_lock);
+    assert(m_budget_quantum > 0);
+    create_budget_ghosts();
+}
+
+void AdaptivePipelineCache::clear()
+{
+    std::scoped_lock guard(m_main_lock, m_ghost_lock);
+    std::vector<void*> payloads;
+    m_main_cache.collect_payloads(payloads);
+    for (void* payload : payloads)
+    {
+        release_payload(payload);
+    }
+    m_main_cache.clear();
+    m_main_sampled.clear();
+    for (uint64_t type = 0; type < m_num_of_ghost_caches; ++type)
+    {
+        m_ghost_caches[type].clear();
+    }
+    for (PipelineCacheProxy& budget_ghost : m_budget_ghosts)
+    {
+        budget_ghost.clear();
+    }
+    m_ttl_wheel.clear();
+    if (m_spill)
+    {
+        m_spill->clear();
+        m_unspillable_below.clear();
+    }
+    // Shared with the other processes, which lose their entries in it as well.
+    if (m_shared)
+    {
+        m_shared->clear();
+    }
+}
+
+std::string AdaptivePipelineCache::repr() const
+{
+    std::lock_guard<std::mutex> main_guard(m_main_lock);
+    return m_main_cache.get_current_config();
+}
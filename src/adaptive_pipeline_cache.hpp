@@ -0,0 +1,357 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "pipeline_block.hpp"
+#include "pipeline_cache.hpp"
+#include "timer_wheel.hpp"
+#include "spill_tier.hpp"
+#include "shared_tier.hpp"
+#include "latency_histograms.hpp"
+#include "event_log.hpp"
+#include "trace_capture.hpp"
+
+using Json = nlohmann::json;
+
+// Thread-safe, every public method can be called concurrently.
+// m_main_lock guards the main cache with its TTL and spill state, m_ghost_lock guards the sampled cache and
+// the ghost caches, so the simulation of one operation overlaps the main cache work of the next.
+// Whenever both are held, m_main_lock is taken first.
+class AdaptivePipelineCache {
+public:
+    using PayloadHook = void (*)(void*);
+
+    struct CachedValue
+    {
+        double latency;
+        uint64_t tokens;
+        void* payload;
+    };
+
+    // The total cost of the sampled misses since the budget timeframe started, of the cache as it is and of
+    // its ghosts a budget quantum smaller and larger. The smaller one costs the maximum when there is none.
+    struct BudgetCosts
+    {
+        double shrunk;
+        double current;
+        double grown;
+    };
+
+private:
+    mutable std::mutex m_main_lock;
+    std::mutex m_ghost_lock;
+
+    PipelineCache m_main_cache;
+    PipelineCacheProxy m_main_sampled;
+    std::vector<PipelineCacheProxy> m_ghost_caches;
+    uint64_t ops_since_last_decision;
+
+    std::vector<std::pair<uint64_t, uint64_t>> m_ghost_caches_indeces;
+    std::vector<std::string> m_ghost_caches_names;
+    uint64_t m_num_of_ghost_caches;
+    uint64_t m_seed;
+    uint64_t m_decision_window_size;
+    uint64_t m_sample_mask;
+    // The config the caches were built with, resize rebuilds them from it with another capacity.
+    Json m_config;
+
+    // Set by a MultiTenantCache: ghosts of the sampled cache one budget quantum smaller and larger, which estimate
+    // what this tenant would lose or save with a quantum less or more. Empty otherwise.
+    uint64_t m_budget_quantum;
+    std::vector<PipelineCacheProxy> m_budget_ghosts;
+    // The costs of the timeframe so far when adapt() last recreated the budget ghosts.
+    BudgetCosts m_budget_carried_costs;
+
+    // When set, keys are fingerprints of str/bytes keys and every entry carries a digest of the full key,
+    // a lookup whose digest differs is a fingerprint collision and is treated as a miss.
+    bool m_verify_keys;
+
+    // Deadlines of the entries set with a TTL. Expired entries are reclaimed when they are looked up,
+    // and in small batches on every setitem.
+    constexpr static uint64_t EXPIRY_BATCH_SIZE = 8;
+    TimerWheel m_ttl_wheel;
+    std::vector<uint64_t> m_expired_keys;
+
+    // Optional second tier, entries popped from the main cache are spilled into it and promoted back on a hit.
+    // Expired entries, and entries whose payload was already released, are popped as well but not spilled,
+    // and so are the entries of a key that was set, promoted or deleted again after they were queued.
+    // The queue pops its last entry first, so each of these keys keeps the queue position under which its entries
+    // must not be spilled, until the queue is empty.
+    std::unique_ptr<SpillTier> m_spill;
+    std::unordered_map<uint64_t, size_t> m_unspillable_below;
+
+    // Optional host-wide tier in shared memory, every setitem is written through to it, so a miss in this
+    // process is served by entries set by the other processes attached to the same segment.
+    std::unique_ptr<SharedTier> m_shared;
+
+    // Optional latency histograms of the public operations and of the simulation and adaptation they run,
+    // the timers do nothing without them.
+    std::unique_ptr<LatencyHistograms> m_histograms;
+    using Op = LatencyHistograms::Op;
+
+    // Optional binary log of the adaptation decisions, the quanta moved and the sketch agings.
+    std::unique_ptr<EventLog> m_event_log;
+
+    // Optional capture of the lookups and setitems, of every key or only of the sampled ones.
+    std::unique_ptr<TraceCapture> m_capture;
+    bool m_capture_sampled_only;
+
+    void capture(TraceCapture::Op op, const HashedKey& key, double latency, uint64_t tokens, bool hit);
+
+    // Every stored payload holds one reference, taken by the caller of setitem. A payload leaving the cache
+    // is only queued, and released by release_pending_payloads, which the owner of the payloads (e.g. the Python
+    // binding, holding the GIL) calls outside of the cache locks.
+    // A payload found by a lookup is pinned rather than retained, since the lookup runs without the GIL:
+    // while any payload is pinned the queue is not released, until the owner retains it with retain_found_payload.
+    PayloadHook m_retain_payload;
+    PayloadHook m_release_payload;
+    std::mutex m_release_lock;  // guards m_released_payloads, taken last and never held across a hook
+    std::vector<void*> m_released_payloads;
+    std::atomic<bool> m_has_released_payloads;
+    std::atomic<uint64_t> m_pinned_payloads;
+
+    void release_payload(void* payload);
+
+    // Entries evicted by the policies leave the cache right away, so their payloads are released here
+    // rather than when they are popped.
+    void release_evicted_payloads(size_t eviction_queue_size_before);
+
+    // Keeps the entries of the key below the given position of the eviction queue out of the spill tier.
+    void mark_unspillable(uint64_t id, size_t eviction_queue_position);
+
+    [[nodiscard]] bool is_sampled(const HashedKey& key) const;
+
+    [[nodiscard]] bool is_expired(const HashedKey& key) const;
+
+    // Removes the key from the main cache, and from the simulated caches that track it.
+    // Expects the main lock to be held, takes the ghost lock itself.
+    void remove_key(const HashedKey& key, bool report_eviction);
+
+    // Removes the key from the simulated caches that track it, takes the ghost lock.
+    void remove_from_simulation(const HashedKey& key);
+
+    void expire_batch();
+
+    // Moves the key from the spill tier back into the main cache, unless it has expired in the meantime.
+    bool promote_from_spill(const HashedKey& key);
+
+    // Copies the key from the shared tier into the main cache, with the deadline it was set with.
+    bool promote_from_shared(const HashedKey& key);
+
+    // Returns whether the entry was admitted into the main cache.
+    bool insert_promoted(const HashedKey& key, const EntryData& entry);
+
+    // Expects the main lock to be held, brings a key missing from the main cache back from the other tiers.
+    bool promote(const HashedKey& key);
+
+    // Expects the main lock to be held. Deletes the key from every tier and returns its value, with the payload pinned
+    // if asked to, or nullopt if the key wasn't cached or had expired. Unlike a lookup it doesn't count as an access.
+    std::optional<CachedValue> take_locked(const HashedKey& key, uint64_t digest, bool pin_payload);
+
+    // Expects the main lock to be held and the key to be missing from the main cache. Deletes it from the other tiers
+    // where it lies, since promoting it first could evict other entries.
+    std::optional<CachedValue> erase_unpromoted(const HashedKey& key, uint64_t digest);
+
+    // Expects the main lock to be held and the key to be in the main cache.
+    [[nodiscard]] bool matches_digest(const HashedKey& key, uint64_t digest);
+
+    static void perform_op_on_ghost(PipelineCacheProxy& proxy, const HashedKey& key, double latency, uint64_t tokens);
+
+    static void remove_from_ghost(PipelineCacheProxy& proxy, const HashedKey& key);
+
+    // Expects both locks to be held.
+    void adapt();
+
+    // Expects the ghost lock to be held, or the cache to be under construction.
+    void create_ghost_caches();
+
+    // Expects the ghost lock to be held. The sampled cache starts a new timeframe with them, to be compared over.
+    void create_budget_ghosts();
+
+    // Expects the ghost lock to be held.
+    [[nodiscard]] BudgetCosts budget_costs_locked() const;
+
+    void simulate_op(const HashedKey& key, double latency, uint64_t tokens);
+
+    // Expects the main lock to be held, simulating the hit on the ghost caches is left to the caller.
+    // entry is the value of the key in the main cache as resolved by the caller, nullptr if it isn't there.
+    std::optional<CachedValue> lookup_locked(const HashedKey& key, EntryValue* entry, uint64_t digest, bool pin_payload);
+
+    std::optional<CachedValue> lookup(const HashedKey& key, uint64_t digest, bool pin_payload);
+
+    // Expects the main lock to be held. Resolves the keys of a batch one prefetch group at a time, and hands each
+    // key of the group to handle while its lines are still in cache. handle gets the entry resolved for the key,
+    // which is looked up again once an earlier key of the group reshuffled the main cache, by a promotion,
+    // an expiry or an insertion.
+    template <typename Handler>
+    void for_each_resolved(std::span<const HashedKey> keys, Handler&& handle)
+    {
+        std::array<EntryValue*, PipelineCache::BATCH_GROUP_SIZE> entries{};
+        for (size_t group_start = 0; group_start < keys.size(); group_start += PipelineCache::BATCH_GROUP_SIZE)
+        {
+            const size_t group_size = std::min(PipelineCache::BATCH_GROUP_SIZE, keys.size() - group_start);
+            m_main_cache.lookup_batch(keys.subspan(group_start, group_size), std::span{entries}.first(group_size));
+
+            bool is_resolved = true;
+            for (size_t idx = 0; idx < group_size; ++idx)
+            {
+                const HashedKey& key = keys[group_start + idx];
+                const size_t size = m_main_cache.size();
+                const size_t eviction_queue_size = m_main_cache.eviction_queue_size();
+                handle(group_start + idx, is_resolved ? entries[idx] : m_main_cache.peek_item(key));
+                is_resolved = is_resolved && size == m_main_cache.size()
+                              && eviction_queue_size == m_main_cache.eviction_queue_size();
+            }
+        }
+    }
+
+    // Handled as in lookup, all under a single acquisition of each lock.
+    std::vector<std::optional<CachedValue>> lookup_batch(const std::vector<uint64_t>& ids,
+                                                         const std::vector<uint64_t>& digests,
+                                                         bool pin_payload);
+
+    // Expects the main lock to be held. Stores the entry in the main cache and in the other tiers.
+    // A cached key's entry may be passed as resolved by the caller, it is updated in place without a second lookup.
+    void store_locked(const HashedKey& key,
+                      EntryValue* cached_entry,
+                      double latency,
+                      uint64_t tokens,
+                      std::optional<double> ttl,
+                      uint64_t digest,
+                      void* payload);
+
+    // Expects the main lock to be held, and keeps holding it only if the cache should adapt,
+    // as adapting moves quanta in the main cache as well.
+    bool finish_store(std::unique_lock<std::mutex>& main_guard);
+
+    void populate_ghost_indeces_and_names(uint64_t num_of_blocks, const std::vector<std::string>& cache_types);
+
+public:
+    explicit AdaptivePipelineCache(const std::string& config_path)
+        : AdaptivePipelineCache(PipelineCache::load_config(config_path)) {}
+
+    explicit AdaptivePipelineCache(const char* config_path) : AdaptivePipelineCache(std::string{config_path}) {}
+
+    // The config is taken by value, missing fields are then reported like in a config file.
+    explicit AdaptivePipelineCache(Json config);
+
+    // A single lookup, an expired entry is reclaimed and reported as missing.
+    std::optional<std::tuple<double, uint64_t>> find(uint64_t key, uint64_t digest = 0);
+
+    // Like find, with the payload. With hooks installed the payload is pinned, and the caller must pass the value
+    // to retain_found_payload, e.g. once it holds the GIL again, before anything else may release it.
+    std::optional<CachedValue> find_value(uint64_t key, uint64_t digest = 0);
+
+    // Takes the caller's reference on a payload returned by find_value or find_value_batch, and unpins it.
+    void retain_found_payload(const CachedValue& value);
+
+    // find for a batch of keys, looked up group by group right after their slots in the main cache are prefetched.
+    // digests may be left empty.
+    std::vector<std::optional<std::tuple<double, uint64_t>>> find_batch(const std::vector<uint64_t>& keys,
+                                                                         const std::vector<uint64_t>& digests = {});
+
+    // find_value for a batch of keys, every payload found must be passed to retain_found_payload.
+    std::vector<std::optional<CachedValue>> find_value_batch(const std::vector<uint64_t>& keys,
+                                                             const std::vector<uint64_t>& digests = {});
+
+    ~AdaptivePipelineCache();
+
+    AdaptivePipelineCache(const AdaptivePipelineCache&) = delete;
+    AdaptivePipelineCache& operator=(const AdaptivePipelineCache&) = delete;
+
+    // Without hooks payloads are plain pointers the cache doesn't own, and releasing them does nothing.
+    void set_payload_hooks(PayloadHook retain, PayloadHook release);
+
+    // Must not be called with the main lock held, the release hook may call back into the cache.
+    // While a found payload is still pinned nothing is released, the next call releases it all.
+    void release_pending_payloads();
+
+    std::tuple<double, uint64_t> getitem(uint64_t key);
+
+    // A ttl (in seconds) makes the entry expire, setting the key again without one keeps it indefinitely.
+    // A different digest replaces the entry of a colliding key.
+    // The cache takes over the reference the caller holds on the payload, and replaces the previous payload.
+    void setitem(uint64_t id,
+                 const std::tuple<double, uint64_t>& value,
+                 std::optional<double> ttl = std::nullopt,
+                 uint64_t digest = 0,
+                 void* payload = nullptr);
+
+    // setitem without a ttl for a batch of keys, stored group by group right after their slots in the main cache
+    // are prefetched.
+    // digests and payloads may be left empty.
+    void setitem_batch(const std::vector<uint64_t>& ids,
+                       const std::vector<std::tuple<double, uint64_t>>& values,
+                       const std::vector<uint64_t>& digests = {},
+                       const std::vector<void*>& payloads = {});
+
+    // Returns whether the key was cached, an expired entry counts as missing.
+    bool delitem(uint64_t id, uint64_t digest = 0);
+
+    // delitem that returns the value deleted, its payload pinned as by find_value. Neither a hit nor a miss,
+    // the sketch, the ghost caches and the lookup histograms don't see it.
+    std::optional<CachedValue> take_value(uint64_t id, uint64_t digest = 0);
+
+    // Expired entries are reclaimed here, so a lookup never sees them, and spilled entries are promoted back.
+    bool contains(uint64_t id, uint64_t digest = 0);
+
+    // Pops the next entry evicted by the pipeline, if there is one.
+    std::optional<std::pair<uint64_t, std::tuple<double, uint64_t>>> popitem();
+
+    std::tuple<double, uint64_t> get(uint64_t key, const std::tuple<double, uint64_t>& default_value = std::make_tuple(0.0, 0));
+
+    std::vector<uint64_t> keys() const;
+
+    std::vector<std::tuple<double, uint64_t>> values() const;
+
+    // Both are read under the same lock, so the pairs are consistent.
+    std::vector<std::pair<uint64_t, std::tuple<double, uint64_t>>> items() const;
+
+    size_t maxsize() const { std::lock_guard<std::mutex> main_guard(m_main_lock); return m_main_cache.capacity(); }
+    size_t currsize() const { std::lock_guard<std::mutex> main_guard(m_main_lock); return m_main_cache.size(); }
+    bool empty() const { std::lock_guard<std::mutex> main_guard(m_main_lock); return m_main_cache.empty(); }
+    bool verifies_keys() const { return m_verify_keys; }
+    size_t spillsize() const { std::lock_guard<std::mutex> main_guard(m_main_lock); return m_spill ? m_spill->size() : 0; }
+    size_t sharedsize() const { std::lock_guard<std::mutex> main_guard(m_main_lock); return m_shared ? m_shared->size() : 0; }
+
+    // nullptr unless the config enables the latency histograms.
+    const LatencyHistograms* latency_histograms() const { return m_histograms.get(); }
+
+    // Writes every request captured so far, does nothing without a capture.
+    void flush_capture();
+
+    // Writes everything logged so far to the event log file, does nothing without an event log.
+    void flush_event_log();
+
+    // Resizes the main, sampled and ghost caches in place, every block keeps its quanta. When shrinking, each block
+    // evicts through its own policy, and the evicted entries are popped like the others.
+    void resize(uint64_t new_capacity);
+
+    // Simulates the cache a quantum of quantum_size entries smaller and larger from now on,
+    // quantum_size must be a multiple of num_of_quanta * sample_rate.
+    void enable_budget_ghosts(uint64_t quantum_size);
+
+    BudgetCosts budget_costs();
+
+    // The quanta of each block in the main cache and in each budget ghost, which follow it as the cache adapts.
+    std::vector<uint64_t> quanta_alloc() const;
+    std::vector<std::vector<uint64_t>> budget_ghosts_quanta_alloc();
+
+    // Starts a new timeframe for budget_costs, with ghosts copied from the sampled cache as it is now.
+    void reset_budget_ghosts();
+
+    void clear();
+
+    std::string repr() const;
+};
@@ -1,32 +1,539 @@
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
 #include <pybind11/operators.h>
 
-#include "adaptive_pipeline_cache.cpp"
+#include "adaptive_pipeline_cache.hpp"
+#include "multi_tenant_cache.hpp"
 
 namespace py = pybind11;
 
+namespace {
+    using Value = std::tuple<double, uint64_t>;
+
+    // A value is (latency, tokens) or (latency, tokens, payload), the payload being any Python object.
+    struct ValueArg
+    {
+        Value value;
+        PyObject* payload;  // borrowed
+    };
+
+    // str and bytes keys are hashed with XXH3-128, the low half is the id used by the cache
+    // and the high half is the digest verifying the full key, odd so it never matches an integer key.
+    struct CacheKey
+    {
+        uint64_t id;
+        uint64_t digest;
+    };
+
+    CacheKey hash_key_bytes(const char* data, Py_ssize_t size, bool verify)
+    {
+        const XXH128_hash_t hash = XXH3_128bits(data, static_cast<size_t>(size));
+        return CacheKey{hash.low64, verify ? (hash.high64 | 1) : 0};
+    }
+
+    // Arguments are validated and converted while the GIL is held, the cache itself is then called without it.
+    CacheKey to_key(const AdaptivePipelineCache& cache, py::handle key)
+    {
+        if (PyLong_Check(key.ptr()))
+        {
+            const unsigned long long value = PyLong_AsUnsignedLongLong(key.ptr());
+            if (!(value == static_cast<unsigned long long>(-1) && PyErr_Occurred()))
+            {
+                return CacheKey{value, 0};
+            }
+            PyErr_Clear();
+        }
+        else if (PyUnicode_Check(key.ptr()))
+        {
+            Py_ssize_t size = 0;
+            const char* data = PyUnicode_AsUTF8AndSize(key.ptr(), &size);
+            if (data == nullptr)
+            {
+                throw py::error_already_set();
+            }
+            return hash_key_bytes(data, size, cache.verifies_keys());
+        }
+        else if (PyBytes_Check(key.ptr()))
+        {
+            return hash_key_bytes(PyBytes_AS_STRING(key.ptr()), PyBytes_GET_SIZE(key.ptr()), cache.verifies_keys());
+        }
+
+        throw py::value_error("Key must be a non-negative integer, str or bytes");
+    }
+
+    [[noreturn]] void raise_key_error(py::handle key)
+    {
+        PyErr_SetObject(PyExc_KeyError, key.ptr());
+        throw py::error_already_set();
+    }
+
+    std::optional<CacheKey> to_key_if_valid(const AdaptivePipelineCache& cache, py::handle key)
+    {
+        try {
+            return to_key(cache, key);
+        }
+        catch (const py::value_error&) {
+            return std::nullopt;
+        }
+    }
+
+    ValueArg to_value(py::handle value)
+    {
+        if (!PyTuple_Check(value.ptr()) || PyTuple_GET_SIZE(value.ptr()) < 2 || PyTuple_GET_SIZE(value.ptr()) > 3)
+        {
+            throw py::value_error("Value must be a tuple of (latency: float, num_of_tokens: int[, payload])");
+        }
+
+        PyObject* latency = PyTuple_GET_ITEM(value.ptr(), 0);
+        if (!PyFloat_Check(latency) && !PyLong_Check(latency))
+        {
+            throw py::value_error("Latency must be a number (int or float)");
+        }
+        const double latency_value = PyFloat_AsDouble(latency);
+        if (latency_value == -1.0 && PyErr_Occurred())
+        {
+            throw py::error_already_set();
+        }
+
+        PyObject* tokens = PyTuple_GET_ITEM(value.ptr(), 1);
+        if (!PyLong_Check(tokens))
+        {
+            throw py::value_error("num_of_tokens must be a non-negative integer");
+        }
+        const unsigned long long tokens_value = PyLong_AsUnsignedLongLong(tokens);
+        if (tokens_value == static_cast<unsigned long long>(-1) && PyErr_Occurred())
+        {
+            PyErr_Clear();
+            throw py::value_error("num_of_tokens must be a non-negative integer");
+        }
+
+        PyObject* payload = PyTuple_GET_SIZE(value.ptr()) == 3 ? PyTuple_GET_ITEM(value.ptr(), 2) : nullptr;
+
+        return ValueArg{Value{latency_value, tokens_value}, payload};
+    }
+
+    void retain_payload(void* payload)
+    {
+        Py_INCREF(static_cast<PyObject*>(payload));
+    }
+
+    void release_payload(void* payload)
+    {
+        Py_DECREF(static_cast<PyObject*>(payload));
+    }
+
+    py::object to_python(const AdaptivePipelineCache::CachedValue& value)
+    {
+        if (value.payload == nullptr)
+        {
+            return py::make_tuple(value.latency, value.tokens);
+        }
+
+        // retain_found_payload took a reference for us.
+        return py::make_tuple(value.latency, value.tokens, py::reinterpret_steal<py::object>(static_cast<PyObject*>(value.payload)));
+    }
+
+    std::optional<double> to_ttl(py::handle ttl)
+    {
+        if (ttl.is_none())
+        {
+            return std::nullopt;
+        }
+
+        if (!PyFloat_Check(ttl.ptr()) && !PyLong_Check(ttl.ptr()))
+        {
+            throw py::value_error("ttl must be a non-negative number of seconds");
+        }
+        const double seconds = PyFloat_AsDouble(ttl.ptr());
+        if (seconds < 0)
+        {
+            throw py::value_error("ttl must be a non-negative number of seconds");
+        }
+
+        return seconds;
+    }
+
+    // Payloads that left the cache are released once the GIL is held again. The payload found stays pinned
+    // in the cache until it is retained here, with the GIL, so it can't be released in between.
+    std::optional<py::object> find(AdaptivePipelineCache& cache, const CacheKey& key)
+    {
+        std::optional<AdaptivePipelineCache::CachedValue> value;
+        {
+            py::gil_scoped_release release;
+            value = cache.find_value(key.id, key.digest);
+        }
+        if (value.has_value())
+        {
+            cache.retain_found_payload(*value);
+        }
+        cache.release_pending_payloads();
+        if (!value.has_value())
+        {
+            return std::nullopt;
+        }
+
+        return to_python(*value);
+    }
+
+    void set(AdaptivePipelineCache& cache, const CacheKey& key, const ValueArg& value, std::optional<double> ttl)
+    {
+        Py_XINCREF(value.payload);
+        {
+            py::gil_scoped_release release;
+            cache.setitem(key.id, value.value, ttl, key.digest, value.payload);
+        }
+        cache.release_pending_payloads();
+    }
+
+    const LatencyHistograms& histograms_of(const AdaptivePipelineCache& cache)
+    {
+        const LatencyHistograms* histograms = cache.latency_histograms();
+        if (histograms == nullptr)
+        {
+            throw std::runtime_error("Latency histograms are disabled, enable metrics.latency_histograms in the config");
+        }
+        return *histograms;
+    }
+
+    // Written next to the file and renamed over it, so a scraper (e.g. the textfile collector) never reads half of it.
+    void write_metrics_file(const std::string& path, const std::string& metrics)
+    {
+        const std::string tmp_path = path + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::trunc);
+            if (!file.is_open() || !(file << metrics).flush())
+            {
+                throw std::runtime_error("Could not write the metrics to " + tmp_path);
+            }
+        }
+        if (std::rename(tmp_path.c_str(), path.c_str()) != 0)
+        {
+            throw std::runtime_error("Could not move the metrics to " + path);
+        }
+    }
+
+    // Like find, for a value deleted by take_value, whose pinned payload is handed over to the caller.
+    std::optional<py::object> take(AdaptivePipelineCache& cache, const CacheKey& key)
+    {
+        std::optional<AdaptivePipelineCache::CachedValue> value;
+        {
+            py::gil_scoped_release release;
+            value = cache.take_value(key.id, key.digest);
+        }
+        if (value.has_value())
+        {
+            cache.retain_found_payload(*value);
+        }
+        cache.release_pending_payloads();
+        if (!value.has_value())
+        {
+            return std::nullopt;
+        }
+
+        return to_python(*value);
+    }
+
+    bool remove(AdaptivePipelineCache& cache, const CacheKey& key)
+    {
+        bool was_removed = false;
+        {
+            py::gil_scoped_release release;
+            was_removed = cache.delitem(key.id, key.digest);
+        }
+        cache.release_pending_payloads();
+        return was_removed;
+    }
+}
+
+// A native MutableMapping, the cache is internally synchronized and calls into it run without the GIL.
 void init_adaptive_pipeline_cache(py::module &m) {
-    py::class_<AdaptivePipelineCache>(m, "AdaptivePipelineCacheImpl")
-        .def(py::init<std::string>(), "Initialize Pipeline cache with config file path")
-        .def("__getitem__", &AdaptivePipelineCache::getitem)
-        .def("__setitem__", &AdaptivePipelineCache::setitem)
-        .def("__delitem__", &AdaptivePipelineCache::delitem)
-        .def("__contains__", &AdaptivePipelineCache::contains)
-        .def("__len__", &AdaptivePipelineCache::currsize)
-        .def("__repr__", &AdaptivePipelineCache::repr)
-        .def("popitem", &AdaptivePipelineCache::popitem)
-        .def("get", &AdaptivePipelineCache::get, py::arg("key"), py::arg("default") = std::make_tuple(0.0, 0))
-        .def("keys", &AdaptivePipelineCache::keys)
-        .def("values", &AdaptivePipelineCache::values)
-        .def("clear", &AdaptivePipelineCache::clear)
-        .def_property_readonly("maxsize", &AdaptivePipelineCache::maxsize)
-        .def_property_readonly("currsize", &AdaptivePipelineCache::currsize)
-        .def("empty", &AdaptivePipelineCache::empty);
+    using release_gil = py::call_guard<py::gil_scoped_release>;
+
+    py::class_<AdaptivePipelineCache> cls(m, "AdaptivePipelineCache");
+    const py::object missing = py::module_::import("builtins").attr("object")();
+
+    cls.def(py::init([](const std::string& config_path) {
+            auto cache = std::make_unique<AdaptivePipelineCache>(config_path);
+            cache->set_payload_hooks(&retain_payload, &release_payload);
+            return cache;
+        }), py::arg("config_path"), "Initialize Pipeline cache with config file path")
+        .def("__getitem__", [](AdaptivePipelineCache& cache, py::handle key) {
+            std::optional<py::object> value = find(cache, to_key(cache, key));
+            if (!value.has_value())
+            {
+                raise_key_error(key);
+            }
+            return *value;
+        })
+        .def("__setitem__", [](AdaptivePipelineCache& cache, py::handle key, py::handle value) {
+            set(cache, to_key(cache, key), to_value(value), std::nullopt);
+        })
+        .def("set", [](AdaptivePipelineCache& cache, py::handle key, py::handle value, py::handle ttl) {
+            set(cache, to_key(cache, key), to_value(value), to_ttl(ttl));
+        }, py::arg("key"), py::arg("value"), py::arg("ttl") = py::none(),
+           "Set an item, optionally expiring after ttl seconds")
+        .def("__delitem__", [](AdaptivePipelineCache& cache, py::handle key) {
+            if (!remove(cache, to_key(cache, key)))
+            {
+                raise_key_error(key);
+            }
+        })
+        .def("__contains__", [](AdaptivePipelineCache& cache, py::handle key) {
+            const std::optional<CacheKey> id = to_key_if_valid(cache, key);
+            if (!id.has_value())
+            {
+                return false;
+            }
+            bool is_cached = false;
+            {
+                py::gil_scoped_release release;
+                is_cached = cache.contains(id->id, id->digest);
+            }
+            cache.release_pending_payloads();
+            return is_cached;
+        })
+        .def("get", [](AdaptivePipelineCache& cache, py::handle key, py::object default_value) -> py::object {
+            const std::optional<CacheKey> id = to_key_if_valid(cache, key);
+            if (id.has_value())
+            {
+                if (std::optional<py::object> value = find(cache, *id))
+                {
+                    return *value;
+                }
+            }
+            return default_value;
+        }, py::arg("key"), py::arg("default") = py::none())
+        .def("pop", [missing](AdaptivePipelineCache& cache, py::handle key, py::object default_value) -> py::object {
+            const std::optional<CacheKey> id = to_key_if_valid(cache, key);
+            if (id.has_value())
+            {
+                if (std::optional<py::object> value = take(cache, *id))
+                {
+                    return *value;
+                }
+            }
+            if (default_value.is(missing))
+            {
+                raise_key_error(key);
+            }
+            return default_value;
+        }, py::arg("key"), py::arg("default") = missing)
+        .def("setdefault", [](AdaptivePipelineCache& cache, py::handle key, py::handle default_value) -> py::object {
+            const CacheKey id = to_key(cache, key);
+            if (std::optional<py::object> value = find(cache, id))
+            {
+                return *value;
+            }
+            set(cache, id, to_value(default_value), std::nullopt);
+            return py::reinterpret_borrow<py::object>(default_value);
+        }, py::arg("key"), py::arg("default"))
+        .def("update", [](AdaptivePipelineCache& cache, py::object other) {
+            // Every pair is converted before the first one is stored, then they are stored as one batch.
+            const py::object pairs = py::hasattr(other, "items") ? other.attr("items")() : other;
+            std::vector<uint64_t> ids;
+            std::vector<uint64_t> digests;
+            std::vector<Value> values;
+            std::vector<void*> payloads;
+            for (py::handle pair : pairs)
+            {
+                const py::tuple key_value(py::reinterpret_borrow<py::object>(pair));
+                const CacheKey key = to_key(cache, key_value[0]);
+                const ValueArg value = to_value(key_value[1]);
+                ids.push_back(key.id);
+                digests.push_back(key.digest);
+                values.push_back(value.value);
+                payloads.push_back(value.payload);
+            }
+            for (void* payload : payloads)
+            {
+                Py_XINCREF(static_cast<PyObject*>(payload));
+            }
+            {
+                py::gil_scoped_release release;
+                cache.setitem_batch(ids, values, digests, payloads);
+            }
+            cache.release_pending_payloads();
+        }, py::arg("other"))
+        .def("get_many", [](AdaptivePipelineCache& cache, py::iterable keys, py::object default_value) {
+            // Keys that are not valid cache keys are reported as missing without being looked up.
+            const py::list key_list(keys);
+            std::vector<uint64_t> ids;
+            std::vector<uint64_t> digests;
+            std::vector<size_t> positions;
+            for (size_t idx = 0; idx < key_list.size(); ++idx)
+            {
+                if (const std::optional<CacheKey> id = to_key_if_valid(cache, key_list[idx]))
+                {
+                    ids.push_back(id->id);
+                    digests.push_back(id->digest);
+                    positions.push_back(idx);
+                }
+            }
+
+            std::vector<std::optional<AdaptivePipelineCache::CachedValue>> values;
+            {
+                py::gil_scoped_release release;
+                values = cache.find_value_batch(ids, digests);
+            }
+            for (const std::optional<AdaptivePipelineCache::CachedValue>& value : values)
+            {
+                if (value.has_value())
+                {
+                    cache.retain_found_payload(*value);
+                }
+            }
+            cache.release_pending_payloads();
+
+            py::list res(key_list.size());
+            for (size_t idx = 0; idx < key_list.size(); ++idx)
+            {
+                res[idx] = default_value;
+            }
+            for (size_t idx = 0; idx < values.size(); ++idx)
+            {
+                if (values[idx].has_value())
+                {
+                    res[positions[idx]] = to_python(*values[idx]);
+                }
+            }
+            return res;
+        }, py::arg("keys"), py::arg("default") = py::none(),
+           "Look up a batch of keys at once, returning a list with default for each missing key")
+        .def("popitem", [](AdaptivePipelineCache& cache) {
+            std::optional<std::pair<uint64_t, Value>> item;
+            {
+                py::gil_scoped_release release;
+                item = cache.popitem();
+            }
+            if (!item.has_value())
+            {
+                throw py::key_error("popitem(): no evicted items");
+            }
+            return *item;
+        }, "Remove and return the next item evicted by the cache policies")
+        .def("__iter__", [](const AdaptivePipelineCache& cache) {
+            std::vector<uint64_t> keys;
+            {
+                py::gil_scoped_release release;
+                keys = cache.keys();
+            }
+            return py::iter(py::cast(std::move(keys)));
+        })
+        .def("__len__", &AdaptivePipelineCache::currsize, release_gil())
+        .def("__repr__", &AdaptivePipelineCache::repr, release_gil())
+        .def("keys", &AdaptivePipelineCache::keys, release_gil())
+        .def("values", &AdaptivePipelineCache::values, release_gil())
+        .def("items", &AdaptivePipelineCache::items, release_gil())
+        .def("clear", [](AdaptivePipelineCache& cache) {
+            {
+                py::gil_scoped_release release;
+                cache.clear();
+            }
+            cache.release_pending_payloads();
+        })
+        .def("resize", [](AdaptivePipelineCache& cache, uint64_t capacity) {
+            {
+                py::gil_scoped_release release;
+                cache.resize(capacity);
+            }
+            cache.release_pending_payloads();
+        }, py::arg("capacity"),
+           "Resizes the cache in place, the entries evicted when shrinking are popped like the others")
+        .def_property_readonly("maxsize", py::cpp_function(&AdaptivePipelineCache::maxsize, release_gil()))
+        .def_property_readonly("currsize", py::cpp_function(&AdaptivePipelineCache::currsize, release_gil()))
+        .def_property_readonly("spillsize", py::cpp_function(&AdaptivePipelineCache::spillsize, release_gil()))
+        .def_property_readonly("sharedsize", py::cpp_function(&AdaptivePipelineCache::sharedsize, release_gil()))
+        .def("latency_quantile", [](const AdaptivePipelineCache& cache, const std::string& op, double q) {
+            const std::optional<LatencyHistograms::Op> parsed_op = LatencyHistograms::parse_op(op);
+            if (!parsed_op.has_value())
+            {
+                throw py::value_error("Unknown operation: " + op);
+            }
+            if (q < 0 || q > 1)
+            {
+                throw py::value_error("q must be between 0 and 1");
+            }
+            return histograms_of(cache).quantile(*parsed_op, q);
+        }, py::arg("op"), py::arg("q"), release_gil(),
+           "Duration in seconds under which a fraction q of the calls of op completed")
+        .def("prometheus_metrics", [](const AdaptivePipelineCache& cache, std::optional<std::string> path, const std::string& prefix) {
+            const std::string metrics = histograms_of(cache).to_prometheus(prefix);
+            if (path.has_value())
+            {
+                write_metrics_file(*path, metrics);
+            }
+            return metrics;
+        }, py::arg("path") = py::none(), py::arg("prefix") = "pipeline_cache", release_gil(),
+           "The latency histograms in the Prometheus text format, also written to path when given")
+        .def("flush_capture", &AdaptivePipelineCache::flush_capture, release_gil(),
+           "Writes the requests captured so far, including those still in the per-thread buffers")
+        .def("flush_event_log", &AdaptivePipelineCache::flush_event_log, release_gil(),
+           "Writes the events logged so far to the event log file, without waiting for the next periodic flush")
+        .def("empty", &AdaptivePipelineCache::empty, release_gil());
+
+    py::module_::import("collections.abc").attr("MutableMapping").attr("register")(cls);
+
+    // The former name of the type, from when it was wrapped by a Python class.
+    m.attr("AdaptivePipelineCacheImpl") = cls;
+}
+
+// The tenants are AdaptivePipelineCache objects kept alive by the container, and rebalanced by its background thread.
+void init_multi_tenant_cache(py::module &m) {
+    py::class_<MultiTenantCache>(m, "MultiTenantCache")
+        .def(py::init([](const std::string& config_path) {
+            auto cache = std::make_unique<MultiTenantCache>(config_path);
+            cache->set_payload_hooks(&retain_payload, &release_payload);
+            return cache;
+        }), py::arg("config_path"), "Initialize the tenants of the config file, sharing its capacity")
+        .def("__getitem__", [](MultiTenantCache& cache, const std::string& name) -> AdaptivePipelineCache& {
+            AdaptivePipelineCache* tenant = cache.find_tenant(name);
+            if (tenant == nullptr)
+            {
+                raise_key_error(py::str(name));
+            }
+            return *tenant;
+        }, py::return_value_policy::reference_internal, "The cache of a tenant")
+        .def("__contains__", [](MultiTenantCache& cache, const std::string& name) {
+            return cache.find_tenant(name) != nullptr;
+        })
+        .def("__len__", [](const MultiTenantCache& cache) { return cache.tenant_names().size(); })
+        .def("__iter__", [](const MultiTenantCache& cache) {
+            return py::iter(py::cast(cache.tenant_names()));
+        })
+        .def("rebalance", [](MultiTenantCache& cache) {
+            bool was_moved = false;
+            {
+                py::gil_scoped_release release;
+                was_moved = cache.rebalance();
+            }
+            cache.release_pending_payloads();
+            return was_moved;
+        }, "Moves at most one budget quantum between the tenants right away, returns whether one was moved")
+        .def("quanta", [](const MultiTenantCache& cache) {
+            std::vector<uint64_t> quanta;
+            {
+                // Waits for a rebalance in progress.
+                py::gil_scoped_release release;
+                quanta = cache.quanta_alloc();
+            }
+            py::dict res;
+            for (size_t idx = 0; idx < quanta.size(); ++idx)
+            {
+                res[py::str(cache.tenant_names()[idx])] = quanta[idx];
+            }
+            return res;
+        }, "The budget quanta of every tenant")
+        .def_property_readonly("maxsize", &MultiTenantCache::capacity)
+        .def_property_readonly("quantum_size", &MultiTenantCache::quantum_size);
 }
 
-PYBIND11_MODULE(_adaptive_pipeline_cache_impl, m) {
+PYBIND11_MODULE(_adaptive_pipeline_cache_impl, m, py::mod_gil_not_used()) {
     m.doc() = "Internal C++ implementation of The Adaptive Pipeline Cache";
-    
+
     init_adaptive_pipeline_cache(m);
+    init_multi_tenant_cache(m);
 }
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <optional>
+
+#include "count_min_sketch.hpp"
+#include "pipeline_block.hpp"
+
+// TinyLFU-style admission between two consecutive blocks: an entry evicted from block i is only
+// offered to block i+1 if it beats the entry it would replace there, otherwise it leaves the cache.
+enum class AdmissionPolicy
+{
+    NONE,
+    FREQUENCY,  // compares the sketch frequencies
+    COST        // compares frequency * cost
+};
+
+namespace admission {
+    inline std::optional<AdmissionPolicy> parse_policy(const std::string& name)
+    {
+        if (name == "none")
+        {
+            return AdmissionPolicy::NONE;
+        }
+        if (name == "frequency")
+        {
+            return AdmissionPolicy::FREQUENCY;
+        }
+        if (name == "cost")
+        {
+            return AdmissionPolicy::COST;
+        }
+
+        return std::nullopt;
+    }
+
+    // Ties are rejected, keeping the resident entry is cheaper than replacing it.
+    inline bool should_admit(AdmissionPolicy policy,
+                             const CompactEntry& candidate,
+                             const CompactEntry& victim,
+                             const CountMinSketch& sketch)
+    {
+        switch (policy)
+        {
+            case AdmissionPolicy::FREQUENCY:
+                return sketch.estimate_fingerprint(candidate.fingerprint) > sketch.estimate_fingerprint(victim.fingerprint);
+            case AdmissionPolicy::COST:
+                return static_cast<double>(sketch.estimate_fingerprint(candidate.fingerprint)) * candidate.cost()
+                       > static_cast<double>(sketch.estimate_fingerprint(victim.fingerprint)) * victim.cost();
+            case AdmissionPolicy::NONE:
+            default:
+                return true;
+        }
+    }
+}
@@ -11,16 +11,55 @@ class ALRUBlock : public BasePipelineBlock {
 private:
     std::mt19937 m_generator;
     const uint64_t m_sample_size;
+    EvictionPool m_pool;
+
+    uint64_t sample_victim()
+    {
+        std::uniform_int_distribution<uint64_t> distribution(0, m_arr.size() - 1);
+
+        uint64_t start_idx = distribution(m_generator);
+        auto itr = m_arr.partial_iterator(start_idx);
+        uint64_t idx_to_remove = start_idx;
+        uint64_t oldest_timestamp = m_arr[start_idx].last_access_time;
+
+        for (uint64_t i = 0; i < std::min(m_sample_size, m_curr_max_capacity); ++i) {
+            CompactEntry entry = *itr;
+            ++itr;
+            const uint64_t idx = start_idx + i < m_arr.size() ? start_idx + i : (start_idx + i) - m_arr.size();
+            if (m_pool.enabled()) {
+                m_pool.offer(idx, entry.value_idx, static_cast<double>(entry.last_access_time));
+            }
+            if (entry.last_access_time < oldest_timestamp) {
+                oldest_timestamp = entry.last_access_time;
+                idx_to_remove = idx;
+            }
+        }
+
+        if (m_pool.enabled()) {
+            // A pooled entry accessed since it was sampled has a newer timestamp, and is re-sorted.
+            return m_pool.best([this](uint64_t idx, uint64_t value_idx) -> std::optional<double> {
+                if (idx >= m_arr.size() || m_arr[idx].value_idx != value_idx) {
+                    return std::nullopt;
+                }
+                return static_cast<double>(m_arr[idx].last_access_time);
+            }).value_or(idx_to_remove);
+        }
+
+        return idx_to_remove;
+    }
 
 public:
     explicit ALRUBlock(uint64_t capacity,
                        uint64_t quantum_size,
                        uint64_t quanta_allocation,
                        uint64_t seed,
-                       uint64_t sample_size)
-            : BasePipelineBlock{capacity, quantum_size, quanta_allocation, "ALRU"},
+                       uint64_t sample_size,
+                       const MemoryPolicy& memory_policy = {},
+                       uint64_t eviction_pool_size = 0)
+            : BasePipelineBlock{capacity, quantum_size, quanta_allocation, "ALRU", memory_policy},
               m_generator{static_cast<std::mt19937::result_type>(seed)},
-              m_sample_size(sample_size)
+              m_sample_size(sample_size),
+              m_pool(eviction_pool_size)
               {}
 
     ALRUBlock(const ALRUBlock& other) = default;
@@ -30,13 +69,14 @@ public:
         if (this != &other)
         {
             BasePipelineBlock::operator=(other);
+            m_pool = other.m_pool;
         }
 
         return *this;
     }
 
     QuantumMoveResult move_quanta_to(PipelineBlock& other) override {
-        assert(m_arr.size() == m_curr_max_capacity || m_arr.empty());
+        assert(m_arr.size() <= m_curr_max_capacity);
         assert(m_curr_max_capacity >= m_quantum_size);
 
         QuantumMoveResult result;
@@ -44,15 +84,16 @@ public:
 
         const uint64_t remaining_count = m_arr.size();
         for (uint64_t i = 0; i < remaining_count; ++i) {
-            result.items_remaining.emplace_back(m_arr[i].id, i);
+            result.items_remaining.emplace_back(m_arr[i].value_idx, i);
         }
 
         m_curr_max_capacity -= m_quantum_size;
+        m_pool.clear();
 
         return result;
     }
 
-    InsertionResult insert_item(const EntryData& item) override {
+    InsertionResult insert_item(const CompactEntry& item) override {
         if (m_arr.size() < m_curr_max_capacity) {
             m_arr.push_tail(item);
             return InsertionResult{.was_item_inserted = true,
@@ -60,21 +101,9 @@ public:
                                    .removed_entry = std::nullopt};
         }
 
-        std::uniform_int_distribution<uint64_t> distribution(0, m_arr.size() - 1);
-
-        uint64_t start_idx = distribution(m_generator);
-        auto itr = m_arr.partial_iterator(start_idx);
-        uint64_t idx_to_remove = start_idx;
-        uint64_t oldest_timestamp = m_arr[start_idx].last_access_time;
-
-        for (uint64_t i = 0; i < std::min(m_sample_size, m_curr_max_capacity); ++i) {
-            EntryData entry = *itr;
-            ++itr;
-            if (entry.last_access_time < oldest_timestamp) {
-                oldest_timestamp = entry.last_access_time;
-                idx_to_remove = start_idx + i < m_arr.size() ? start_idx + i : (start_idx + i) - m_arr.size();
-            }
-        }
+        const std::optional<uint64_t> sampled_victim = take_sampled_victim();
+        const uint64_t idx_to_remove = sampled_victim.has_value() ? *sampled_victim : sample_victim();
+        const uint64_t oldest_timestamp = m_arr[idx_to_remove].last_access_time;
 
         // Holding the latest timestamp directly allows us to reject items from the ALRU.
         if (oldest_timestamp > item.last_access_time) {
@@ -83,19 +112,31 @@ public:
                                    .removed_entry = std::nullopt};
         }
 
-        EntryData evicted_item = m_arr.replace(idx_to_remove, item);
+        CompactEntry evicted_item = m_arr.replace(idx_to_remove, item);
         return InsertionResult{.was_item_inserted = true,
                                .replaced_idx = idx_to_remove,
                                .removed_entry = evicted_item};
     }
 
+    const CompactEntry* peek_victim() override
+    {
+        if (m_arr.size() < m_curr_max_capacity) {
+            return nullptr;
+        }
+
+        const uint64_t idx = sample_victim();
+        remember_sampled_victim(idx);
+        return &m_arr[idx];
+    }
+
     void prepare_for_copy() override
     {
+        m_pool.clear();
         m_arr.rotate();
 
-        EntryData* data = m_arr.data();
+        CompactEntry* data = m_arr.data();
         std::nth_element(data, data + (m_arr.size() - m_quantum_size), data + m_arr.size(),
-            [](const EntryData& a, const EntryData& b) {
+            [](const CompactEntry& a, const CompactEntry& b) {
                 return a.last_access_time < b.last_access_time;
             });
     }
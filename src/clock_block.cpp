@@ -0,0 +1,211 @@
+#include <cassert>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <bit>
+
+#include "pipeline_block.hpp"
+
+// CLOCK approximation of LRU: one reference bit per slot and a hand sweeping over the slots.
+// A hit only sets a bit, and a victim is the first slot from the hand whose bit is clear,
+// clearing the bits it passes on the way (second chance).
+class ClockBlock : public BasePipelineBlock {
+private:
+    constexpr static uint64_t BITS_PER_WORD = 64;
+
+    // Invariant: bits at indices >= m_arr.size() are always clear.
+    std::vector<uint64_t> m_reference_bits;
+    uint64_t m_hand;
+
+    [[nodiscard]] static uint64_t low_mask(uint64_t num_of_bits)
+    {
+        return num_of_bits == 0 ? 0 : ~0ULL >> (BITS_PER_WORD - num_of_bits);
+    }
+
+    [[nodiscard]] bool is_referenced(uint64_t idx) const
+    {
+        return (m_reference_bits[idx / BITS_PER_WORD] >> (idx % BITS_PER_WORD)) & 1ULL;
+    }
+
+    void set_reference(uint64_t idx, bool value)
+    {
+        const uint64_t bit = 1ULL << (idx % BITS_PER_WORD);
+        if (value)
+        {
+            m_reference_bits[idx / BITS_PER_WORD] |= bit;
+        }
+        else
+        {
+            m_reference_bits[idx / BITS_PER_WORD] &= ~bit;
+        }
+    }
+
+    // Advances the hand to the first unreferenced slot, clearing the reference bits it passes.
+    // Works a word at a time, so a run of 64 referenced slots costs a single test.
+    uint64_t advance_hand_to_victim()
+    {
+        const uint64_t size = m_arr.size();
+        assert(size > 0);
+
+        while (true)
+        {
+            if (m_hand >= size)
+            {
+                m_hand = 0;
+            }
+
+            const uint64_t word_idx = m_hand / BITS_PER_WORD;
+            const uint64_t bit_offset = m_hand % BITS_PER_WORD;
+            const uint64_t unreferenced = ~m_reference_bits[word_idx] >> bit_offset;
+
+            if (unreferenced != 0)
+            {
+                const uint64_t victim_offset = bit_offset + std::countr_zero(unreferenced);
+                const uint64_t victim = word_idx * BITS_PER_WORD + victim_offset;
+                if (victim < size)
+                {
+                    m_reference_bits[word_idx] &= ~(low_mask(victim_offset) & ~low_mask(bit_offset));
+                    m_hand = victim;
+                    return victim;
+                }
+            }
+
+            // Every slot from the hand to the end of the word (or of the block) was referenced.
+            m_reference_bits[word_idx] &= low_mask(bit_offset);
+            m_hand = (word_idx + 1) * BITS_PER_WORD;
+        }
+    }
+
+public:
+    explicit ClockBlock(uint64_t capacity,
+                        uint64_t quantum_size,
+                        uint64_t quanta_allocation,
+                        const MemoryPolicy& memory_policy = {})
+            : BasePipelineBlock{capacity, quantum_size, quanta_allocation, "Clock", memory_policy},
+              m_reference_bits((capacity + BITS_PER_WORD - 1) / BITS_PER_WORD, 0),
+              m_hand{0}
+              {}
+
+    ClockBlock(const ClockBlock& other) = default;
+
+    ClockBlock& operator=(const ClockBlock& other)
+    {
+        if (this != &other)
+        {
+            BasePipelineBlock::operator=(other);
+            m_reference_bits = other.m_reference_bits;
+            m_hand = other.m_hand;
+        }
+
+        return *this;
+    }
+
+    QuantumMoveResult move_quanta_to(PipelineBlock& other) override {
+        assert(m_arr.size() <= m_curr_max_capacity);
+        assert(m_curr_max_capacity >= m_quantum_size);
+        assert(!m_arr.is_rotated());
+
+        const uint64_t size_before_move = m_arr.size();
+
+        QuantumMoveResult result;
+        result.items_moved = other.accept_quanta(m_arr);
+
+        // The head of the array was handed over, shift the bits of the remaining slots accordingly.
+        const uint64_t moved_count = size_before_move - m_arr.size();
+        const uint64_t remaining_count = m_arr.size();
+        for (uint64_t i = 0; i < remaining_count; ++i) {
+            set_reference(i, is_referenced(i + moved_count));
+        }
+        for (uint64_t i = remaining_count; i < size_before_move; ++i) {
+            set_reference(i, false);
+        }
+        m_hand = 0;
+
+        for (uint64_t i = 0; i < remaining_count; ++i) {
+            result.items_remaining.emplace_back(m_arr[i].value_idx, i);
+        }
+
+        m_curr_max_capacity -= m_quantum_size;
+
+        return result;
+    }
+
+    InsertionResult insert_item(const CompactEntry& item) override {
+        if (m_arr.size() < m_curr_max_capacity) {
+            assert(!m_arr.is_rotated());
+            m_arr.push_tail(item);
+            assert(!is_referenced(m_arr.size() - 1));
+            return InsertionResult{.was_item_inserted = true,
+                                   .replaced_idx = m_arr.size() - 1,
+                                   .removed_entry = std::nullopt};
+        }
+
+        const uint64_t idx_to_remove = advance_hand_to_victim();
+        CompactEntry evicted_item = m_arr.replace(idx_to_remove, item);
+        ++m_hand;
+
+        return InsertionResult{.was_item_inserted = true,
+                               .replaced_idx = idx_to_remove,
+                               .removed_entry = evicted_item};
+    }
+
+    // Advancing the hand here is no wasted work, the following insertion finds the victim right under it.
+    const CompactEntry* peek_victim() override
+    {
+        return m_arr.size() < m_curr_max_capacity ? nullptr : &m_arr[advance_hand_to_victim()];
+    }
+
+    std::optional<uint64_t> remove_item(uint64_t idx) override
+    {
+        const uint64_t last_idx = m_arr.size() - 1;
+        set_reference(idx, is_referenced(last_idx));
+        set_reference(last_idx, false);
+
+        return BasePipelineBlock::remove_item(idx);
+    }
+
+    void record_access(uint64_t idx) override
+    {
+        assert(idx < m_arr.size());
+        set_reference(idx, true);
+    }
+
+    // Moves the unreferenced slots to the front, these are the ones handed over on a quantum move.
+    void prepare_for_copy() override
+    {
+        assert(!m_arr.is_rotated());
+
+        if (!m_arr.empty())
+        {
+            uint64_t front = 0;
+            uint64_t back = m_arr.size() - 1;
+            while (front < back)
+            {
+                if (!is_referenced(front))
+                {
+                    ++front;
+                }
+                else if (is_referenced(back))
+                {
+                    --back;
+                }
+                else
+                {
+                    std::swap(m_arr[front], m_arr[back]);
+                    set_reference(front, false);
+                    set_reference(back, true);
+                }
+            }
+        }
+
+        m_hand = 0;
+    }
+
+    void clear() override
+    {
+        BasePipelineBlock::clear();
+        std::fill(m_reference_bits.begin(), m_reference_bits.end(), 0);
+        m_hand = 0;
+    }
+};
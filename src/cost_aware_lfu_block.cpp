@@ -7,9 +7,9 @@
 #include "pipeline_block.hpp"
 #include "count_min_sketch.hpp"
 
-static double get_score(const EntryData& entry, const CountMinSketch& sketch) {
-    const uint64_t freq = sketch.estimate(entry.id);
-    return entry.latency * static_cast<double>(entry.tokens) * static_cast<double>(freq);
+static double get_score(const CompactEntry& entry, const CountMinSketch& sketch) {
+    const uint64_t freq = sketch.estimate_fingerprint(entry.fingerprint);
+    return entry.cost() * static_cast<double>(freq);
 }
 
 class CostAwareLFUBlock : public BasePipelineBlock {
@@ -17,6 +17,43 @@ private:
     const CountMinSketch& m_sketch;
     std::mt19937 m_generator;
     const uint64_t m_sample_size;
+    EvictionPool m_pool;
+
+    uint64_t sample_victim()
+    {
+        std::uniform_int_distribution<uint64_t> distribution(0, m_arr.size() - 1);
+
+        const uint64_t start_idx = distribution(m_generator);
+        auto itr = m_arr.partial_iterator(start_idx);
+        uint64_t idx_to_remove = start_idx;
+        double lowest_score = get_score(m_arr[start_idx], m_sketch);
+
+        for (uint64_t i = 0; i < std::min(m_sample_size, m_curr_max_capacity); ++i) {
+            const CompactEntry& entry = *itr;
+            ++itr;
+            const uint64_t idx = start_idx + i < m_arr.size() ? start_idx + i : (start_idx + i) - m_arr.size();
+            const double curr_score = get_score(entry, m_sketch);
+            if (m_pool.enabled()) {
+                m_pool.offer(idx, entry.value_idx, curr_score);
+            }
+            if (curr_score < lowest_score) {
+                lowest_score = curr_score;
+                idx_to_remove = idx;
+            }
+        }
+
+        if (m_pool.enabled()) {
+            // The frequencies of the pooled entries may have grown, or been halved by an aging, since they were sampled.
+            return m_pool.best([this](uint64_t idx, uint64_t value_idx) -> std::optional<double> {
+                if (idx >= m_arr.size() || m_arr[idx].value_idx != value_idx) {
+                    return std::nullopt;
+                }
+                return get_score(m_arr[idx], m_sketch);
+            }).value_or(idx_to_remove);
+        }
+
+        return idx_to_remove;
+    }
 
     public:
     explicit CostAwareLFUBlock(uint64_t capacity,
@@ -24,11 +61,14 @@ private:
                                uint64_t quanta_allocation,
                                const CountMinSketch& sketch,
                                uint64_t seed,
-                               uint64_t sample_size)
-            : BasePipelineBlock(capacity, quantum_size, quanta_allocation, "CostAwareLFU"),
+                               uint64_t sample_size,
+                               const MemoryPolicy& memory_policy = {},
+                               uint64_t eviction_pool_size = 0)
+            : BasePipelineBlock(capacity, quantum_size, quanta_allocation, "CostAwareLFU", memory_policy),
               m_sketch(sketch),
               m_generator(static_cast<std::mt19937::result_type>(seed)),
-              m_sample_size(sample_size)
+              m_sample_size(sample_size),
+              m_pool(eviction_pool_size)
               {}
 
     CostAwareLFUBlock& operator=(const CostAwareLFUBlock& other)
@@ -36,6 +76,7 @@ private:
         if (this != &other)
         {
             BasePipelineBlock::operator=(other);
+            m_pool = other.m_pool;
         }
 
         return *this;
@@ -44,7 +85,7 @@ private:
     CostAwareLFUBlock(const CostAwareLFUBlock& other) = default;
 
     QuantumMoveResult move_quanta_to(PipelineBlock& other) override {
-        assert(m_arr.size() == m_curr_max_capacity || m_arr.empty());
+        assert(m_arr.size() <= m_curr_max_capacity);
         assert(m_curr_max_capacity >= m_quantum_size);
         assert(!other.get_arr().is_rotated());
 
@@ -53,15 +94,16 @@ private:
 
         const uint64_t remaining_count = m_arr.size();
         for (uint64_t i = 0; i < remaining_count; ++i) {
-            result.items_remaining.emplace_back(m_arr[i].id, i);
+            result.items_remaining.emplace_back(m_arr[i].value_idx, i);
         }
 
         m_curr_max_capacity -= m_quantum_size;
+        m_pool.clear();
 
         return result;
     }
 
-    InsertionResult insert_item(const EntryData& item) override {
+    InsertionResult insert_item(const CompactEntry& item) override {
         if (m_arr.size() < m_curr_max_capacity) {
             assert(!m_arr.is_rotated());
             m_arr.push_tail(item);
@@ -70,21 +112,9 @@ private:
                                    .removed_entry = std::nullopt};
         }
 
-        std::uniform_int_distribution<uint64_t> distribution(0, m_arr.size() - 1);
-
-        const uint64_t start_idx = distribution(m_generator);
-        auto itr = m_arr.partial_iterator(start_idx);
-        uint64_t idx_to_remove = start_idx;
-        double lowest_score = get_score(m_arr[start_idx], m_sketch);
-
-        for (uint64_t i = 0; i < std::min(m_sample_size, m_curr_max_capacity); ++i) {
-            const EntryData& entry = *itr;
-            ++itr;
-            if (double curr_score = get_score(entry, m_sketch); curr_score < lowest_score) {
-                lowest_score = curr_score;
-                idx_to_remove = start_idx + i < m_arr.size() ? start_idx + i : (start_idx + i) - m_arr.size();
-            }
-        }
+        const std::optional<uint64_t> sampled_victim = take_sampled_victim();
+        const uint64_t idx_to_remove = sampled_victim.has_value() ? *sampled_victim : sample_victim();
+        const double lowest_score = get_score(m_arr[idx_to_remove], m_sketch);
 
         if (lowest_score < get_score(item, m_sketch)) {
             return InsertionResult{.was_item_inserted = false,
@@ -92,18 +122,30 @@ private:
                                    .removed_entry = std::nullopt};
         }
 
-        EntryData evicted_item = m_arr.replace(idx_to_remove, item);
+        CompactEntry evicted_item = m_arr.replace(idx_to_remove, item);
         return InsertionResult{.was_item_inserted = true,
                                .replaced_idx = idx_to_remove,
                                .removed_entry = evicted_item};
     }
 
+    const CompactEntry* peek_victim() override
+    {
+        if (m_arr.size() < m_curr_max_capacity) {
+            return nullptr;
+        }
+
+        const uint64_t idx = sample_victim();
+        remember_sampled_victim(idx);
+        return &m_arr[idx];
+    }
+
     void prepare_for_copy() override
     {
+        m_pool.clear();
         m_arr.rotate();
-        EntryData* data = m_arr.data();
+        CompactEntry* data = m_arr.data();
         std::nth_element(data, data + (m_arr.size() - m_quantum_size), data + m_arr.size(),
-            [this](const EntryData& a, const EntryData& b) {
+            [this](const CompactEntry& a, const CompactEntry& b) {
                 return get_score(a, m_sketch) < get_score(b, m_sketch);
             });
     }
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <type_traits>
+#include <variant>
+
+// What a miss costs, i.e. what a hit saves: latency * tokens unless the config's "cost" section picks another model.
+// The model is evaluated once, when an entry is set. The blocks, the admission gates and the adaptation only compare
+// the cost stored in the entries and the aggregated cost of the misses, so a scoring loop never calls the model.
+namespace cost {
+    // Latency-bound backends, e.g. billed by GPU-seconds.
+    struct Latency
+    {
+        constexpr static const char* NAME = "latency";
+        [[nodiscard]] double operator()(double latency, uint64_t) const { return latency; }
+    };
+
+    // Backends billed per output token.
+    struct Tokens
+    {
+        constexpr static const char* NAME = "tokens";
+        [[nodiscard]] double operator()(double, uint64_t tokens) const { return static_cast<double>(tokens); }
+    };
+
+    struct LatencyTokens
+    {
+        constexpr static const char* NAME = "latency_tokens";
+        [[nodiscard]] double operator()(double latency, uint64_t tokens) const
+        {
+            return latency * static_cast<double>(tokens);
+        }
+    };
+
+    // A fee per request on top of what the latency and the tokens cost.
+    struct Affine
+    {
+        constexpr static const char* NAME = "affine";
+        double per_request;
+        double per_second;
+        double per_token;
+
+        [[nodiscard]] double operator()(double latency, uint64_t tokens) const
+        {
+            return per_request + per_second * latency + per_token * static_cast<double>(tokens);
+        }
+    };
+
+    // User-supplied weights of (1, latency, tokens, latency * tokens).
+    struct Weighted
+    {
+        constexpr static const char* NAME = "weighted";
+        constexpr static size_t NUM_OF_WEIGHTS = 4;
+        std::array<double, NUM_OF_WEIGHTS> weights;
+
+        [[nodiscard]] double operator()(double latency, uint64_t tokens) const
+        {
+            const auto tokens_count = static_cast<double>(tokens);
+            return weights[0] + weights[1] * latency + weights[2] * tokens_count + weights[3] * latency * tokens_count;
+        }
+    };
+}
+
+using CostModel = std::variant<cost::LatencyTokens, cost::Latency, cost::Tokens, cost::Affine, cost::Weighted>;
+
+namespace cost {
+    [[nodiscard]] inline double evaluate(const CostModel& model, double latency, uint64_t tokens)
+    {
+        return std::visit([latency, tokens](const auto& policy) { return policy(latency, tokens); }, model);
+    }
+
+    [[nodiscard]] inline const char* name(const CostModel& model)
+    {
+        return std::visit([](const auto& policy) { return std::decay_t<decltype(policy)>::NAME; }, model);
+    }
+}
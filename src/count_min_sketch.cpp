@@ -2,36 +2,41 @@
 #include <random>
 #include <cassert>
 #include <cmath>
-#include <vector>
+#include <limits>
 #include <cstring>
 #include <cassert>
 #include "count_min_sketch.hpp"
+#include "utils.cpp"
 
-CountMinSketch::CountMinSketch() : m_width(0), m_depth(0), m_table{nullptr}, m_hash_coefficients{nullptr} {}
+CountMinSketch::CountMinSketch() : m_width(0), m_depth(0), m_table{nullptr}, m_hash_coefficients{nullptr}, m_policy{} {}
 
 CountMinSketch::CountMinSketch(double error,
                                double probability,
-                               uint64_t seed) : m_width(static_cast<uint32_t>(std::ceil(2 / error))),
-                                                m_depth(static_cast<uint32_t>(std::ceil(std::log(1 / (1 - probability)) / std::log(2)))),
-                                                m_table(new uint32_t*[m_depth]),
-                                                m_hash_coefficients(new uint32_t[m_depth]) {
+                               uint64_t seed,
+                               const MemoryPolicy& policy) : m_width(static_cast<uint32_t>(std::ceil(2 / error))),
+                                                             m_depth(static_cast<uint32_t>(std::ceil(std::log(1 / (1 - probability)) / std::log(2)))),
+                                                             m_table{nullptr},
+                                                             m_hash_coefficients(new uint64_t[m_depth]),
+                                                             m_policy{policy} {
     assert(error > 0 && error < 1);
     assert(probability > 0 && probability < 1);
 
-    for (uint32_t idx = 0; idx < m_depth; ++idx)
-    {
-        m_table[idx] = new uint32_t[m_width]();
-    }
+    m_table = static_cast<uint32_t*>(memory::allocate(table_size(), m_policy));
+    std::memset(m_table, 0, table_size());
 
     std::mt19937 gen(static_cast<std::mt19937::result_type>(seed));
-    std::uniform_int_distribution<uint32_t> dis(1, std::numeric_limits<uint32_t>::max() - 1);
+    std::uniform_int_distribution<uint64_t> dis(1, std::numeric_limits<uint64_t>::max());
     for (uint32_t idx = 0; idx < m_depth; ++idx)
     {
-        m_hash_coefficients[idx] = dis(gen);
+        m_hash_coefficients[idx] = dis(gen) | 1;
     }
 }
 
-CountMinSketch::CountMinSketch(const CountMinSketch& other) : m_width{other.m_width}, m_depth{other.m_depth}, m_table{nullptr}, m_hash_coefficients{nullptr}
+CountMinSketch::CountMinSketch(const CountMinSketch& other) : m_width{other.m_width},
+                                                               m_depth{other.m_depth},
+                                                               m_table{nullptr},
+                                                               m_hash_coefficients{nullptr},
+                                                               m_policy{other.m_policy}
 {
     assert (this != &other);
     if (m_table != nullptr)
@@ -54,6 +59,7 @@ CountMinSketch& CountMinSketch::operator=(const CountMinSketch& other)
         m_width = other.m_width;
         m_depth = other.m_depth;
     }
+    m_policy = other.m_policy;
     copy_table(other);
 
     return *this;
@@ -69,11 +75,7 @@ CountMinSketch::~CountMinSketch()
 
 void CountMinSketch::delete_table()
 {
-    for (uint32_t idx = 0; idx < m_depth; ++idx)
-    {
-        delete[] m_table[idx];
-    }
-    delete[] m_table;
+    memory::deallocate(m_table, table_size(), m_policy);
     delete[] m_hash_coefficients;
     m_table = nullptr;
     m_hash_coefficients = nullptr;
@@ -83,56 +85,55 @@ void CountMinSketch::copy_table(const CountMinSketch& other)
 {
     assert(this->m_width == other.m_width && this->m_depth == other.m_depth);
     assert(m_table == nullptr && m_hash_coefficients == nullptr);
-    m_table = new uint32_t*[m_depth];
-
-    for (uint32_t idx = 0; idx < m_depth; ++idx)
-    {
-        m_table[idx] = new uint32_t[m_width]();
-        std::memcpy(m_table[idx], other.m_table[idx], sizeof(uint32_t) * m_width);
-    }
+    m_table = static_cast<uint32_t*>(memory::allocate(table_size(), m_policy));
+    std::memcpy(m_table, other.m_table, table_size());
 
-    m_hash_coefficients = new uint32_t[m_depth];
-    std::memcpy(m_hash_coefficients, other.m_hash_coefficients, sizeof(uint32_t) * m_depth);
+    m_hash_coefficients = new uint64_t[m_depth];
+    std::memcpy(m_hash_coefficients, other.m_hash_coefficients, sizeof(uint64_t) * m_depth);
 }
 
-uint32_t CountMinSketch::hash(uint64_t key, uint32_t row) const
+uint32_t CountMinSketch::column(uint32_t fingerprint, uint32_t row) const
 {
-    uint64_t hash = (static_cast<uint64_t>(m_hash_coefficients[row]) * key);
-    hash += (hash >> 32);
-    hash &= PRIME;
+    return static_cast<uint32_t>(((fingerprint * m_hash_coefficients[row]) >> 32) % m_width);
+}
 
-    return hash;
+uint32_t& CountMinSketch::counter(uint32_t fingerprint, uint32_t row) const
+{
+    return m_table[static_cast<size_t>(row) * m_width + column(fingerprint, row)];
 }
 
-void CountMinSketch::add(uint64_t item) {
-    std::vector<uint32_t> hashes = std::vector<uint32_t>(m_depth);
-    for (uint32_t row = 0; row < m_depth; ++row) {
-        uint64_t hash_val = hash(item, row);
-        hashes.push_back(static_cast<uint32_t>(hash_val));
-    }
+size_t CountMinSketch::table_size() const
+{
+    return static_cast<size_t>(m_depth) * m_width * sizeof(uint32_t);
+}
 
+void CountMinSketch::add(const HashedKey& key) {
+    const uint32_t fingerprint = key.fingerprint();
     uint32_t min_count = std::numeric_limits<uint32_t>::max();
     for (uint32_t row = 0; row < m_depth; ++row) {
-        uint32_t col = static_cast<uint32_t>(hashes[row] % m_width);
-        if (m_table[row][col] < min_count) {
-            min_count = m_table[row][col];
+        if (const uint32_t curr_count = counter(fingerprint, row); curr_count < min_count) {
+            min_count = curr_count;
         }
     }
 
+    // Conservative update, only the counters at the minimum are incremented.
     for (uint32_t row = 0; row < m_depth; ++row) {
-        uint32_t col = static_cast<uint32_t>(hashes[row] % m_width);
-        if (m_table[row][col] == min_count) {
-            ++m_table[row][col];
+        if (uint32_t& count = counter(fingerprint, row); count == min_count) {
+            ++count;
         }
     }
 }
 
-uint32_t CountMinSketch::estimate(uint64_t key) const
+uint32_t CountMinSketch::estimate(const HashedKey& key) const
+{
+    return estimate_fingerprint(key.fingerprint());
+}
+
+uint32_t CountMinSketch::estimate_fingerprint(uint32_t fingerprint) const
 {
     uint32_t min_count = std::numeric_limits<uint32_t>::max();
     for (uint32_t row = 0; row < m_depth; ++row) {
-        uint64_t col = hash(key, row);
-        if (uint32_t curr_count = m_table[row][col]; curr_count < min_count)
+        if (const uint32_t curr_count = counter(fingerprint, row); curr_count < min_count)
         {
             min_count = curr_count;
         }
@@ -141,13 +142,18 @@ uint32_t CountMinSketch::estimate(uint64_t key) const
     return min_count;
 }
 
+void CountMinSketch::prefetch(const HashedKey& key) const
+{
+    for (uint32_t row = 0; row < m_depth; ++row) {
+        utils::prefetch(&counter(key.fingerprint(), row));
+    }
+}
+
 void CountMinSketch::reduce()
 {
-    for (uint32_t row = 0; row < m_depth; ++row)
+    const size_t num_of_counters = static_cast<size_t>(m_depth) * m_width;
+    for (size_t idx = 0; idx < num_of_counters; ++idx)
     {
-        for (uint32_t col = 0; col < m_width; ++col)
-        {
-            m_table[row][col] <<= 1;
-        }
+        m_table[idx] >>= 1;
     }
 }
@@ -1,27 +1,36 @@
 #pragma once
 #include <cstdint>
 
+#include "hashed_key.hpp"
+#include "memory_policy.hpp"
+
 class CountMinSketch {
 private:
-    constexpr static uint64_t PRIME = 1l << (61 - 1); // A large prime number for hashing
-
     uint32_t m_width;
     uint32_t m_depth;
-    uint32_t** m_table;
-    uint32_t* m_hash_coefficients;
+    uint32_t* m_table;  // m_depth rows of m_width counters, in one allocation made with m_policy
+    uint64_t* m_hash_coefficients;  // odd, one per row
+    MemoryPolicy m_policy;
     void delete_table();
     void copy_table(const CountMinSketch& other);
-    [[nodiscard]] uint32_t hash(uint64_t key, uint32_t row) const;
+    // The column of the key in the row, derived from the key's fingerprint by a per-row multiply-shift.
+    [[nodiscard]] uint32_t column(uint32_t fingerprint, uint32_t row) const;
+    [[nodiscard]] uint32_t& counter(uint32_t fingerprint, uint32_t row) const;
+    [[nodiscard]] size_t table_size() const;
 
 public:
     CountMinSketch();
-    CountMinSketch(double error, double probabilty, uint64_t seed);
+    CountMinSketch(double error, double probabilty, uint64_t seed, const MemoryPolicy& policy = {});
     CountMinSketch(const CountMinSketch& other);
     ~CountMinSketch();
 
     CountMinSketch& operator=(const CountMinSketch& other);
 
-    void add(uint64_t item);
-    [[nodiscard]] uint32_t estimate(uint64_t item) const;
+    void add(const HashedKey& key);
+    [[nodiscard]] uint32_t estimate(const HashedKey& key) const;
+    // The estimate of a resident entry, which only keeps the fingerprint of its key.
+    [[nodiscard]] uint32_t estimate_fingerprint(uint32_t fingerprint) const;
+    // Prefetches the counters of the key in every row.
+    void prefetch(const HashedKey& key) const;
     void reduce();
 };
\ No newline at end of file
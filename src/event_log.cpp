@@ -0,0 +1,302 @@
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "utils.cpp"
+#include "event_log.hpp"
+
+namespace {
+    std::mutex live_logs_lock;
+    std::vector<EventLog*> live_logs;
+    std::once_flag fork_handlers_registered;
+}
+
+EventLog::EventLog(const std::string& path, uint64_t capacity, uint64_t flush_interval_ms)
+    : m_capacity{capacity},
+      m_mask{capacity - 1},
+      m_slots{},
+      m_head{0},
+      m_tail{0},
+      m_dropped{0},
+      m_next_file_sequence{0},
+      m_path{path},
+      m_file{nullptr},
+      m_flush_interval_ms{flush_interval_ms},
+      m_stopping{false},
+      m_flusher{}
+{
+    if (!std::has_single_bit(capacity))
+    {
+        throw std::invalid_argument("The event log capacity must be a power of two");
+    }
+    if (flush_interval_ms == 0)
+    {
+        throw std::invalid_argument("The event log flush interval must be positive");
+    }
+
+    open_file();
+
+    m_slots = std::make_unique<Slot[]>(capacity);
+    m_flusher = std::thread(&EventLog::run_flusher, this);
+
+    std::call_once(fork_handlers_registered, []() {
+        pthread_atfork(&EventLog::prepare_fork, &EventLog::resume_parent_after_fork, &EventLog::resume_child_after_fork);
+    });
+    std::lock_guard<std::mutex> guard(live_logs_lock);
+    live_logs.push_back(this);
+}
+
+EventLog::~EventLog()
+{
+    {
+        std::lock_guard<std::mutex> guard(live_logs_lock);
+        std::erase(live_logs, this);
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_flush_lock);
+        m_stopping = true;
+    }
+    m_flush_cv.notify_one();
+    m_flusher.join();
+
+    drain();
+    if (m_file != nullptr)
+    {
+        std::fclose(m_file);
+    }
+}
+
+void EventLog::open_file()
+{
+    m_file = std::fopen(m_path.c_str(), "a+b");
+    if (m_file == nullptr)
+    {
+        throw std::runtime_error("Failed to open the event log " + m_path);
+    }
+
+    std::fseek(m_file, 0, SEEK_END);
+    const long file_size = std::ftell(m_file);
+    if (file_size == 0)
+    {
+        const FileHeader header{MAGIC, VERSION, static_cast<uint32_t>(sizeof(Record))};
+        std::fwrite(&header, sizeof(header), 1, m_file);
+        std::fflush(m_file);
+        m_next_file_sequence = 0;
+    }
+    else
+    {
+        FileHeader header{};
+        std::fseek(m_file, 0, SEEK_SET);
+        const bool is_valid = std::fread(&header, sizeof(header), 1, m_file) == 1
+                              && header.magic == MAGIC
+                              && header.version == VERSION
+                              && header.record_size == sizeof(Record)
+                              && (static_cast<uint64_t>(file_size) - sizeof(header)) % sizeof(Record) == 0;
+        if (!is_valid)
+        {
+            std::fclose(m_file);
+            m_file = nullptr;
+            throw std::runtime_error(m_path + " is not an event log of this version");
+        }
+        m_next_file_sequence = (static_cast<uint64_t>(file_size) - sizeof(header)) / sizeof(Record);
+        std::fseek(m_file, 0, SEEK_END);
+    }
+}
+
+bool EventLog::try_push(const Record& record)
+{
+    uint64_t sequence = m_head.load(std::memory_order_relaxed);
+    do
+    {
+        if (sequence - m_tail.load(std::memory_order_acquire) >= m_capacity)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    } while (!m_head.compare_exchange_weak(sequence, sequence + 1, std::memory_order_relaxed));
+
+    // The slot was flushed before the tail passed it, and no other writer claims it until the tail passes it again.
+    Slot& slot = m_slots[sequence & m_mask];
+    slot.record = record;
+    slot.published.store(sequence + 1, std::memory_order_release);
+
+    return true;
+}
+
+void EventLog::write_record(Record& record)
+{
+    record.sequence = m_next_file_sequence++;
+    std::fwrite(&record, sizeof(record), 1, m_file);
+}
+
+void EventLog::drain()
+{
+    // Only a forked child that failed to open its own file has none, its records are then left to be dropped.
+    if (m_file == nullptr)
+    {
+        return;
+    }
+
+    // Records are written in the order their sequences were claimed, so a record still being written
+    // holds back the ones claimed after it until the next drain.
+    uint64_t tail = m_tail.load(std::memory_order_relaxed);
+    const uint64_t head = m_head.load(std::memory_order_acquire);
+    while (tail < head)
+    {
+        Slot& slot = m_slots[tail & m_mask];
+        if (slot.published.load(std::memory_order_acquire) != tail + 1)
+        {
+            break;
+        }
+        Record record = slot.record;
+        write_record(record);
+        ++tail;
+        m_tail.store(tail, std::memory_order_release);
+    }
+
+    const uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        Record record{};
+        record.time_ms = utils::get_current_time_in_ms();
+        record.type = EventType::DROPPED;
+        record.ghost = static_cast<uint32_t>(std::min<uint64_t>(dropped, UINT32_MAX));
+        record.src_block = NO_BLOCK;
+        record.dest_block = NO_BLOCK;
+        write_record(record);
+    }
+
+    std::fflush(m_file);
+}
+
+void EventLog::run_flusher()
+{
+    std::unique_lock<std::mutex> lock(m_flush_lock);
+    while (!m_stopping)
+    {
+        m_flush_cv.wait_for(lock, std::chrono::milliseconds(m_flush_interval_ms));
+        drain();
+    }
+}
+
+void EventLog::flush()
+{
+    std::lock_guard<std::mutex> guard(m_flush_lock);
+    drain();
+}
+
+void EventLog::prepare_fork()
+{
+    live_logs_lock.lock();
+    for (EventLog* log : live_logs)
+    {
+        log->m_flush_lock.lock();
+    }
+}
+
+void EventLog::resume_parent_after_fork()
+{
+    for (EventLog* log : live_logs)
+    {
+        log->m_flush_lock.unlock();
+    }
+    live_logs_lock.unlock();
+}
+
+void EventLog::resume_child_after_fork()
+{
+    for (EventLog* log : live_logs)
+    {
+        log->restart_in_child();
+        log->m_flush_lock.unlock();
+    }
+    live_logs_lock.unlock();
+}
+
+void EventLog::restart_in_child()
+{
+    // The parent flushes the records in the ring, including any a thread missing from the child was writing.
+    m_tail.store(m_head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+
+    // Every drain ends with a flush, so nothing of the parent is left in the file's buffer.
+    if (m_file != nullptr)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    m_path += "." + std::to_string(getpid());
+    try
+    {
+        open_file();
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << ", the forked process doesn't log its events" << std::endl;
+    }
+
+    // The parent's flusher has no thread in the child, so its handle and the waiters of the condition variable
+    // are dropped rather than joined or destroyed.
+    new (&m_flush_cv) std::condition_variable();
+    new (&m_flusher) std::thread(&EventLog::run_flusher, this);
+}
+
+void EventLog::log_ghost_cost(uint64_t ghost, uint64_t src_block, uint64_t dest_block, double cost)
+{
+    Record record{};
+    record.time_ms = utils::get_current_time_in_ms();
+    record.type = EventType::GHOST_COST;
+    record.ghost = static_cast<uint32_t>(ghost);
+    record.src_block = static_cast<uint32_t>(src_block);
+    record.dest_block = static_cast<uint32_t>(dest_block);
+    record.costs = {cost, 0.0};
+    (void)try_push(record);
+}
+
+void EventLog::log_decision(uint64_t best_ghost, double current_cost, double best_ghost_cost,
+                            uint64_t src_block, uint64_t dest_block)
+{
+    Record record{};
+    record.time_ms = utils::get_current_time_in_ms();
+    record.type = EventType::DECISION;
+    record.ghost = static_cast<uint32_t>(best_ghost);
+    record.src_block = static_cast<uint32_t>(src_block);
+    record.dest_block = static_cast<uint32_t>(dest_block);
+    record.costs = {current_cost, best_ghost_cost};
+    (void)try_push(record);
+}
+
+void EventLog::log_quantum_move(uint64_t src_block, uint64_t dest_block, std::span<const uint64_t> quanta_alloc)
+{
+    Record record{};
+    record.time_ms = utils::get_current_time_in_ms();
+    record.type = EventType::QUANTUM_MOVE;
+    record.ghost = NO_BLOCK;
+    record.src_block = static_cast<uint32_t>(src_block);
+    record.dest_block = static_cast<uint32_t>(dest_block);
+    record.num_of_blocks = static_cast<uint16_t>(std::min(quanta_alloc.size(), MAX_LOGGED_BLOCKS));
+    for (size_t idx = 0; idx < record.num_of_blocks; ++idx)
+    {
+        record.quanta[idx] = static_cast<uint16_t>(std::min<uint64_t>(quanta_alloc[idx], UINT16_MAX));
+    }
+    (void)try_push(record);
+}
+
+void EventLog::log_sketch_aging()
+{
+    Record record{};
+    record.time_ms = utils::get_current_time_in_ms();
+    record.type = EventType::SKETCH_AGING;
+    record.ghost = NO_BLOCK;
+    record.src_block = NO_BLOCK;
+    record.dest_block = NO_BLOCK;
+    (void)try_push(record);
+}
@@ -0,0 +1,123 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+
+// Binary audit log of the adaptation: every adapt() decision with the ghost costs it compared, the quantum it
+// moved with the allocation after the move, and every aging of the main sketch.
+// Records are written into a lock-free ring and appended to the file by a background thread, so the thread that
+// adapts never formats or writes. When the ring is full the record is dropped and counted instead of waiting,
+// the count is written to the file as an event of its own.
+class EventLog {
+public:
+    enum class EventType : uint16_t
+    {
+        GHOST_COST,     // ghost, src_block -> dest_block, costs[0]: the ghost's cost over the decision window
+        DECISION,       // ghost: the cheapest one, costs[0]: the main cache's cost, costs[1]: the cheapest ghost's,
+                        // src_block -> dest_block: the quantum moved, NO_BLOCK when the allocation is kept
+        QUANTUM_MOVE,   // src_block -> dest_block, quanta: the allocation after the move
+        SKETCH_AGING,   // the main cache halved its sketch counters
+        DROPPED,        // ghost: the number of records dropped on a full ring since the previous one
+        COUNT
+    };
+
+    constexpr static std::array<const char*, static_cast<size_t>(EventType::COUNT)> EVENT_NAMES = {
+        "ghost_cost", "decision", "quantum_move", "sketch_aging", "dropped"
+    };
+
+    constexpr static uint32_t NO_BLOCK = UINT32_MAX;
+    constexpr static size_t MAX_LOGGED_BLOCKS = 8;
+
+    // As stored in the file, in the byte order of the host.
+    struct Record
+    {
+        uint64_t sequence;
+        uint64_t time_ms;
+        EventType type;
+        uint16_t num_of_blocks;  // entries of quanta in use, the allocation of further blocks isn't logged
+        uint32_t ghost;
+        uint32_t src_block;
+        uint32_t dest_block;
+        std::array<double, 2> costs;
+        std::array<uint16_t, MAX_LOGGED_BLOCKS> quanta;
+    };
+
+    static_assert(sizeof(Record) == 64, "one record per cache line");
+
+    // Written once at the start of a new file, a file is appended to as long as its header matches.
+    struct FileHeader
+    {
+        std::array<char, 8> magic;
+        uint32_t version;
+        uint32_t record_size;
+    };
+
+    constexpr static std::array<char, 8> MAGIC = {'P', 'C', 'E', 'V', 'L', 'O', 'G', '\0'};
+    constexpr static uint32_t VERSION = 1;
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> published{0};  // the sequence of the record + 1, once it can be read
+        Record record{};
+    };
+
+    const uint64_t m_capacity;
+    const uint64_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<uint64_t> m_head;     // the next sequence to write
+    alignas(64) std::atomic<uint64_t> m_tail;     // the next sequence to flush
+    std::atomic<uint64_t> m_dropped;
+    uint64_t m_next_file_sequence;
+
+    std::string m_path;
+    std::FILE* m_file;
+    const uint64_t m_flush_interval_ms;
+    std::mutex m_flush_lock;
+    std::condition_variable m_flush_cv;
+    bool m_stopping;
+    std::thread m_flusher;
+
+    // Opens m_path for appending, an existing file must hold an event log of the same version.
+    void open_file();
+    [[nodiscard]] bool try_push(const Record& record);
+    // Drains the ring into the file, only called by the flushing thread or once it has stopped.
+    void drain();
+    void write_record(Record& record);
+    void run_flusher();
+
+    // fork() only copies the thread that called it, so every log is locked across it, between two drains, and the
+    // child restarts its flusher on a file of its own, path.<pid>. The records left in the ring are the parent's.
+    static void prepare_fork();
+    static void resume_parent_after_fork();
+    static void resume_child_after_fork();
+    void restart_in_child();
+
+public:
+    // Opens the file for appending, an existing file must hold an event log of the same version.
+    EventLog(const std::string& path, uint64_t capacity, uint64_t flush_interval_ms);
+    ~EventLog();
+
+    EventLog(const EventLog&) = delete;
+    EventLog& operator=(const EventLog&) = delete;
+
+    // Safe to call from any number of threads, never blocks.
+    void log_ghost_cost(uint64_t ghost, uint64_t src_block, uint64_t dest_block, double cost);
+    void log_decision(uint64_t best_ghost, double current_cost, double best_ghost_cost,
+                      uint64_t src_block, uint64_t dest_block);
+    void log_quantum_move(uint64_t src_block, uint64_t dest_block, std::span<const uint64_t> quanta_alloc);
+    void log_sketch_aging();
+
+    // Wakes the flushing thread and waits until everything logged so far is in the file.
+    void flush();
+
+    [[nodiscard]] uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+    [[nodiscard]] uint64_t capacity() const { return m_capacity; }
+};
@@ -1,14 +1,22 @@
 #include <cassert>
 #include <string>
 #include <cstdint>
+#include <algorithm>
 
 #include "pipeline_block.hpp"
 
 
 class FIFOBlock : public BasePipelineBlock {
+private:
+    // The block is used as a ring over [0, size), so entries keep their index until they are evicted.
+    uint64_t m_oldest_idx;
+
 public:
-    explicit FIFOBlock(uint64_t capacity, uint64_t quantum_size, uint64_t quanta_allocation) 
-            : BasePipelineBlock(capacity, quantum_size, quanta_allocation, "FIFO") {}
+    explicit FIFOBlock(uint64_t capacity,
+                       uint64_t quantum_size,
+                       uint64_t quanta_allocation,
+                       const MemoryPolicy& memory_policy = {})
+            : BasePipelineBlock(capacity, quantum_size, quanta_allocation, "FIFO", memory_policy), m_oldest_idx{0} {}
             
             FIFOBlock(const FIFOBlock& other) = default;
 
@@ -17,6 +25,7 @@ public:
         if (this != &other)
         {
             BasePipelineBlock::operator=(other);
+            m_oldest_idx = other.m_oldest_idx;
         }
 
         return *this;
@@ -24,14 +33,14 @@ public:
 
     QuantumMoveResult move_quanta_to(PipelineBlock& other) override {
         assert(m_cache_max_capacity >= m_quantum_size);
-        m_arr.rotate();
+        prepare_for_copy();
 
         QuantumMoveResult result;
         result.items_moved = other.accept_quanta(m_arr);
 
         const uint64_t remaining_count = m_arr.size();
         for (uint64_t i = 0; i < remaining_count; ++i) {
-            result.items_remaining.emplace_back(m_arr[i].id, i);
+            result.items_remaining.emplace_back(m_arr[i].value_idx, i);
         }
 
         m_curr_max_capacity -= m_quantum_size;
@@ -39,7 +48,7 @@ public:
     }
 
 
-    InsertionResult insert_item(const EntryData& item) override {
+    InsertionResult insert_item(const CompactEntry& item) override {
         if (m_arr.size() < m_curr_max_capacity) {
             assert(!m_arr.is_rotated());
             m_arr.push_tail(item);
@@ -48,15 +57,44 @@ public:
                                    .removed_entry = std::nullopt};
         }
 
-        EntryData evicted_item = m_arr.pop_head();
-        m_arr.push_tail(item);
+        const uint64_t idx_to_remove = m_oldest_idx;
+        CompactEntry evicted_item = m_arr.replace(idx_to_remove, item);
+        m_oldest_idx = m_oldest_idx + 1 < m_arr.size() ? m_oldest_idx + 1 : 0;
+
         return InsertionResult{.was_item_inserted = true,
-                               .replaced_idx = m_arr.size() - 1,
+                               .replaced_idx = idx_to_remove,
                                .removed_entry = evicted_item};
     }
 
+    // The last entry takes the removed slot, so the insertion order is only kept approximately.
+    std::optional<uint64_t> remove_item(uint64_t idx) override
+    {
+        std::optional<uint64_t> moved_id = BasePipelineBlock::remove_item(idx);
+        if (m_oldest_idx >= m_arr.size())
+        {
+            m_oldest_idx = 0;
+        }
+
+        return moved_id;
+    }
+
+    const CompactEntry* peek_victim() override
+    {
+        return m_arr.size() < m_curr_max_capacity ? nullptr : &m_arr[m_oldest_idx];
+    }
+
+    // Puts the entries back in insertion order, so the oldest ones are handed over on a quantum move.
     void prepare_for_copy() override
     {
         this->m_arr.rotate();
+        CompactEntry* data = m_arr.data();
+        std::rotate(data, data + m_oldest_idx, data + m_arr.size());
+        m_oldest_idx = 0;
+    }
+
+    void clear() override
+    {
+        BasePipelineBlock::clear();
+        m_oldest_idx = 0;
     }
 };
\ No newline at end of file
@@ -1,11 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <cassert>
+#include <memory>
+#include <type_traits>
+
+#include "memory_policy.hpp"
 
 template<typename T>
 class FixedSizeArray {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+                  "items are moved with memcpy and never destroyed");
 
 private:
     T* m_data = nullptr;
@@ -13,11 +20,32 @@ private:
     uint64_t m_size;
     uint64_t m_head;
     uint64_t m_tail;
+    MemoryPolicy m_policy;
+
+    [[nodiscard]] T* allocate_data() const
+    {
+        T* data = static_cast<T*>(memory::allocate(m_capacity * sizeof(T), m_policy));
+        // Mapped memory is already zeroed, touching every page of it again would only fault it all in.
+        if (!memory::allocates_zeroed(m_policy))
+        {
+            std::uninitialized_value_construct_n(data, m_capacity);
+        }
+        return data;
+    }
+
+    void deallocate_data(T* data) const
+    {
+        memory::deallocate(data, m_capacity * sizeof(T), m_policy);
+    }
 
 public:
-    explicit FixedSizeArray(uint64_t capacity) : m_capacity(capacity), m_size(0), m_head(0), m_tail(0) 
+    explicit FixedSizeArray(uint64_t capacity, const MemoryPolicy& policy = {}) : m_capacity(capacity),
+                                                                                   m_size(0),
+                                                                                   m_head(0),
+                                                                                   m_tail(0),
+                                                                                   m_policy{policy}
     {
-        m_data = new T[m_capacity];
+        m_data = allocate_data();
     }
 
     FixedSizeArray(const FixedSizeArray& other) 
@@ -30,7 +58,8 @@ public:
         else
         {
             m_capacity = other.m_capacity;
-            m_data = new T[m_capacity];
+            m_policy = other.m_policy;
+            m_data = allocate_data();
         }
 
         m_size = other.m_size;
@@ -51,7 +80,8 @@ public:
             else 
             {
                 m_capacity = other.m_capacity;
-                m_data = new T[m_capacity];
+                m_policy = other.m_policy;
+                m_data = allocate_data();
             }
 
             m_size = other.m_size;
@@ -64,7 +94,7 @@ public:
     }
 
     FixedSizeArray(FixedSizeArray&& other) noexcept 
-        : m_capacity(other.m_capacity), m_size(other.m_size) 
+        : m_capacity(other.m_capacity), m_size(other.m_size), m_policy{other.m_policy}
     {
         other.rotate();
         m_data = other.m_data;
@@ -105,7 +135,7 @@ private:
 public:
     [[nodiscard]] bool is_rotated() const { return m_tail < m_head || m_head > 0; }
 
-    ~FixedSizeArray() { delete[] m_data; }
+    ~FixedSizeArray() { deallocate_data(m_data); }
 
     void push_tail(const T& value) 
     {
@@ -130,6 +160,18 @@ public:
         return value;
     }
 
+    T pop_tail()
+    {
+        assert(!empty());
+
+        m_tail = m_tail == 0 ? m_capacity - 1 : m_tail - 1;
+        T value = m_data[m_tail];
+        --m_size;
+
+        assert(calc_size() == m_size);
+        return value;
+    }
+
     T& operator[](uint64_t index) 
     {
         assert(index < m_capacity);
@@ -186,13 +228,15 @@ public:
         return m_size == 0;
     }
 
+    // Moves up to count items from the head, fewer if this array holds fewer.
     void partial_move_to(FixedSizeArray& other, uint64_t count) 
     {
         if (!empty())
         {
+            count = count < m_size ? count : m_size;
             assert(calc_size() == m_size);
             assert(other.calc_size() == other.m_size);
-            assert(count <= m_size || count + other.m_size > other.m_capacity);
+            assert(count + other.m_size <= other.m_capacity);
             assert(m_head == 0 && m_tail == m_head + m_size || this->is_full());
             
             std::memcpy(other.m_data + other.m_size, m_data, count * sizeof(T));
@@ -214,17 +258,12 @@ public:
 
         if (m_head < m_tail) 
         {
-            std::memcpy(m_data, m_data + m_head, m_size * sizeof(T));
+            std::memmove(m_data, m_data + m_head, m_size * sizeof(T));
         }
         else
         {
-            T* temp = new T[m_capacity];
-            const uint64_t items_to_move_to_beginning = m_capacity - m_head; 
-            std::memcpy(temp, m_data + m_head, items_to_move_to_beginning * sizeof(T));
-            std::memcpy(temp + items_to_move_to_beginning, m_data, m_tail * sizeof(T));
-
-            delete[] m_data;
-            m_data = temp;
+            // In place, the items from the head to the end come first, followed by those from the start to the tail.
+            std::rotate(m_data, m_data + m_head, m_data + m_capacity);
         }
 
         m_head = 0;
@@ -0,0 +1,282 @@
+#include <cassert>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include "pipeline_block.hpp"
+#include "count_min_sketch.hpp"
+
+// GreedyDual-Size-Frequency: priority = inflation + frequency * cost / size.
+// Every entry occupies a single slot, so the size term is 1.
+// The victim is always the minimal priority, kept at the top of an indexed min-heap over the slots,
+// and the inflation is raised to the priority of every victim so old entries age out over time.
+class GDSFBlock : public BasePipelineBlock {
+private:
+    const CountMinSketch& m_sketch;
+    double m_inflation;
+    std::vector<double> m_priorities;       // slot -> priority
+    std::vector<uint64_t> m_heap;           // heap position -> slot
+    std::vector<uint64_t> m_heap_positions; // slot -> heap position
+
+    [[nodiscard]] double calc_priority(const CompactEntry& entry) const
+    {
+        const uint64_t freq = m_sketch.estimate_fingerprint(entry.fingerprint);
+        return m_inflation + entry.cost() * static_cast<double>(freq);
+    }
+
+    void swap_heap_nodes(uint64_t pos_a, uint64_t pos_b)
+    {
+        std::swap(m_heap[pos_a], m_heap[pos_b]);
+        m_heap_positions[m_heap[pos_a]] = pos_a;
+        m_heap_positions[m_heap[pos_b]] = pos_b;
+    }
+
+    void sift_up(uint64_t pos)
+    {
+        while (pos > 0)
+        {
+            const uint64_t parent = (pos - 1) / 2;
+            if (m_priorities[m_heap[parent]] <= m_priorities[m_heap[pos]])
+            {
+                break;
+            }
+            swap_heap_nodes(pos, parent);
+            pos = parent;
+        }
+    }
+
+    void sift_down(uint64_t pos)
+    {
+        const uint64_t heap_size = m_heap.size();
+        while (true)
+        {
+            const uint64_t left = 2 * pos + 1;
+            const uint64_t right = left + 1;
+            uint64_t smallest = pos;
+            if (left < heap_size && m_priorities[m_heap[left]] < m_priorities[m_heap[smallest]])
+            {
+                smallest = left;
+            }
+            if (right < heap_size && m_priorities[m_heap[right]] < m_priorities[m_heap[smallest]])
+            {
+                smallest = right;
+            }
+            if (smallest == pos)
+            {
+                break;
+            }
+            swap_heap_nodes(pos, smallest);
+            pos = smallest;
+        }
+    }
+
+    void push_to_heap(uint64_t slot)
+    {
+        m_heap.push_back(slot);
+        m_heap_positions[slot] = m_heap.size() - 1;
+        sift_up(m_heap.size() - 1);
+    }
+
+    void rebuild_heap()
+    {
+        m_heap.resize(m_arr.size());
+        std::iota(m_heap.begin(), m_heap.end(), 0);
+        for (uint64_t slot = 0; slot < m_heap.size(); ++slot)
+        {
+            m_heap_positions[slot] = slot;
+        }
+
+        for (uint64_t pos = m_heap.size() / 2; pos > 0; --pos)
+        {
+            sift_down(pos - 1);
+        }
+    }
+
+public:
+    explicit GDSFBlock(uint64_t capacity,
+                       uint64_t quantum_size,
+                       uint64_t quanta_allocation,
+                       const CountMinSketch& sketch,
+                       const MemoryPolicy& memory_policy = {})
+            : BasePipelineBlock(capacity, quantum_size, quanta_allocation, "GDSF", memory_policy),
+              m_sketch(sketch),
+              m_inflation{0.0},
+              m_priorities(capacity, 0.0),
+              m_heap{},
+              m_heap_positions(capacity, 0)
+              {
+                  m_heap.reserve(capacity);
+              }
+
+    GDSFBlock(const GDSFBlock& other) = default;
+
+    GDSFBlock& operator=(const GDSFBlock& other)
+    {
+        if (this != &other)
+        {
+            BasePipelineBlock::operator=(other);
+            m_inflation = other.m_inflation;
+            m_priorities = other.m_priorities;
+            m_heap = other.m_heap;
+            m_heap_positions = other.m_heap_positions;
+        }
+
+        return *this;
+    }
+
+    QuantumMoveResult move_quanta_to(PipelineBlock& other) override {
+        assert(m_arr.size() <= m_curr_max_capacity);
+        assert(m_curr_max_capacity >= m_quantum_size);
+        assert(!m_arr.is_rotated());
+
+        const uint64_t size_before_move = m_arr.size();
+
+        QuantumMoveResult result;
+        result.items_moved = other.accept_quanta(m_arr);
+
+        const uint64_t moved_count = size_before_move - m_arr.size();
+        const uint64_t remaining_count = m_arr.size();
+        std::copy(m_priorities.begin() + static_cast<int64_t>(moved_count),
+                  m_priorities.begin() + static_cast<int64_t>(size_before_move),
+                  m_priorities.begin());
+        rebuild_heap();
+
+        for (uint64_t i = 0; i < remaining_count; ++i) {
+            result.items_remaining.emplace_back(m_arr[i].value_idx, i);
+        }
+
+        m_curr_max_capacity -= m_quantum_size;
+
+        return result;
+    }
+
+    NewLocationData accept_quanta(FixedSizeArray<CompactEntry>& arr) override
+    {
+        const uint64_t first_new_slot = m_arr.size();
+        NewLocationData locations = BasePipelineBlock::accept_quanta(arr);
+
+        for (uint64_t slot = first_new_slot; slot < m_arr.size(); ++slot)
+        {
+            m_priorities[slot] = calc_priority(m_arr[slot]);
+            push_to_heap(slot);
+        }
+
+        return locations;
+    }
+
+    InsertionResult insert_item(const CompactEntry& item) override {
+        if (m_arr.size() < m_curr_max_capacity) {
+            assert(!m_arr.is_rotated());
+            m_arr.push_tail(item);
+            const uint64_t slot = m_arr.size() - 1;
+            m_priorities[slot] = calc_priority(item);
+            push_to_heap(slot);
+            return InsertionResult{.was_item_inserted = true,
+                                   .replaced_idx = slot,
+                                   .removed_entry = std::nullopt};
+        }
+
+        const uint64_t victim_slot = m_heap.front();
+        const double victim_priority = m_priorities[victim_slot];
+        if (calc_priority(item) < victim_priority) {
+            return InsertionResult{.was_item_inserted = false,
+                                   .replaced_idx = std::numeric_limits<uint64_t>::max(),
+                                   .removed_entry = std::nullopt};
+        }
+
+        m_inflation = victim_priority;
+        CompactEntry evicted_item = m_arr.replace(victim_slot, item);
+        m_priorities[victim_slot] = calc_priority(item);
+        sift_down(0);
+
+        return InsertionResult{.was_item_inserted = true,
+                               .replaced_idx = victim_slot,
+                               .removed_entry = evicted_item};
+    }
+
+    std::optional<uint64_t> remove_item(uint64_t idx) override
+    {
+        // Take the slot out of the heap first, then re-point the heap node of the last slot to idx.
+        const uint64_t heap_pos = m_heap_positions[idx];
+        const uint64_t last_heap_pos = m_heap.size() - 1;
+        if (heap_pos != last_heap_pos)
+        {
+            swap_heap_nodes(heap_pos, last_heap_pos);
+        }
+        m_heap.pop_back();
+        if (heap_pos < m_heap.size())
+        {
+            const uint64_t swapped_slot = m_heap[heap_pos];
+            sift_up(heap_pos);
+            sift_down(m_heap_positions[swapped_slot]);
+        }
+
+        const uint64_t last_slot = m_arr.size() - 1;
+        if (idx != last_slot)
+        {
+            m_priorities[idx] = m_priorities[last_slot];
+            const uint64_t moved_heap_pos = m_heap_positions[last_slot];
+            m_heap[moved_heap_pos] = idx;
+            m_heap_positions[idx] = moved_heap_pos;
+        }
+
+        return BasePipelineBlock::remove_item(idx);
+    }
+
+    const CompactEntry* peek_victim() override
+    {
+        return m_arr.size() < m_curr_max_capacity ? nullptr : &m_arr[m_heap.front()];
+    }
+
+    void record_access(uint64_t idx) override
+    {
+        BasePipelineBlock::record_access(idx);
+
+        // The frequency may also have dropped since the last access due to aging, so sift both ways.
+        m_priorities[idx] = calc_priority(m_arr[idx]);
+        const uint64_t pos = m_heap_positions[idx];
+        sift_up(pos);
+        sift_down(m_heap_positions[idx]);
+    }
+
+    // Moves the quantum with the lowest priorities to the front, these are handed over on a quantum move.
+    void prepare_for_copy() override
+    {
+        m_arr.rotate();
+
+        const uint64_t size = m_arr.size();
+        if (size > m_quantum_size)
+        {
+            std::vector<uint64_t> order(size);
+            std::iota(order.begin(), order.end(), 0);
+            std::nth_element(order.begin(), order.begin() + static_cast<int64_t>(m_quantum_size), order.end(),
+                [this](uint64_t a, uint64_t b) {
+                    return m_priorities[a] < m_priorities[b];
+                });
+
+            std::vector<CompactEntry> entries(size);
+            std::vector<double> priorities(size);
+            for (uint64_t i = 0; i < size; ++i)
+            {
+                entries[i] = m_arr[order[i]];
+                priorities[i] = m_priorities[order[i]];
+            }
+            for (uint64_t i = 0; i < size; ++i)
+            {
+                m_arr[i] = entries[i];
+                m_priorities[i] = priorities[i];
+            }
+        }
+
+        rebuild_heap();
+    }
+
+    void clear() override
+    {
+        BasePipelineBlock::clear();
+        m_heap.clear();
+        m_inflation = 0.0;
+    }
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+#include "xxhash.h"
+
+// A key together with its XXH3 hash, computed once when an operation enters the cache and carried to
+// every structure that needs it: the sampling decision, the sketch rows, the key index and the shared tier.
+// The sampling decision uses the high half of the hash, the index probes from the low bits,
+// and the sketch only reads the low half.
+struct HashedKey
+{
+    uint64_t id;
+    uint64_t hash;
+
+    HashedKey() : id(0), hash(0) {}
+    HashedKey(uint64_t id, uint64_t hash) : id(id), hash(hash) {}
+    // Hashes the id, meant for the API boundary (and tests), everything past it passes the HashedKey along.
+    HashedKey(uint64_t id) : id(id), hash(XXH3_64bits(&id, sizeof(id))) {}
+
+    // The part of the hash kept by the resident entries, enough for the sketch rows.
+    [[nodiscard]] uint32_t fingerprint() const { return static_cast<uint32_t>(hash); }
+};
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <bit>
+#include <cassert>
+
+#include "hashed_key.hpp"
+#include "memory_policy.hpp"
+#include "utils.cpp"
+
+struct EntryPosition {
+    uint64_t id;
+    uint64_t block_num;
+    uint64_t idx;
+};
+
+// Open-addressing map from a key to the position of its entry, probing linearly from the key's hash,
+// so a lookup never hashes again. Sized once for the cache capacity with a load factor of at most 1/2,
+// erasing shifts the following entries of the probe run back instead of leaving tombstones.
+class KeyIndex {
+private:
+    constexpr static uint64_t EMPTY = UINT64_MAX;
+
+    struct Slot
+    {
+        uint64_t hash;
+        EntryPosition pos;  // block_num is EMPTY for a free slot
+    };
+
+    std::vector<Slot, memory::PolicyAllocator<Slot>> m_slots;
+    uint64_t m_mask;
+    uint64_t m_size;
+
+    [[nodiscard]] static bool is_free(const Slot& slot) { return slot.pos.block_num == EMPTY; }
+
+    [[nodiscard]] uint64_t find_slot(const HashedKey& key) const
+    {
+        for (uint64_t idx = key.hash & m_mask; ; idx = (idx + 1) & m_mask)
+        {
+            const Slot& slot = m_slots[idx];
+            if (is_free(slot) || (slot.hash == key.hash && slot.pos.id == key.id))
+            {
+                return idx;
+            }
+        }
+    }
+
+public:
+    KeyIndex() : m_slots{}, m_mask{0}, m_size{0} {}
+
+    // An insertion may briefly hold one entry over the capacity, before the evicted one is erased.
+    explicit KeyIndex(uint64_t capacity, const MemoryPolicy& policy = {})
+        : m_slots(std::bit_ceil(2 * (capacity + 1)), Slot{0, EntryPosition{0, EMPTY, 0}}, memory::PolicyAllocator<Slot>{policy}),
+          m_mask{m_slots.size() - 1},
+          m_size{0} {}
+
+    [[nodiscard]] const EntryPosition* find(const HashedKey& key) const
+    {
+        if (m_size == 0)
+        {
+            return nullptr;
+        }
+        const Slot& slot = m_slots[find_slot(key)];
+        return is_free(slot) ? nullptr : &slot.pos;
+    }
+
+    // Prefetches the home slot of the key, where its probe starts.
+    void prefetch(const HashedKey& key) const
+    {
+        if (!m_slots.empty())
+        {
+            utils::prefetch(&m_slots[key.hash & m_mask]);
+        }
+    }
+
+    [[nodiscard]] bool contains(const HashedKey& key) const
+    {
+        return find(key) != nullptr;
+    }
+
+    void insert_or_assign(const HashedKey& key, uint64_t block_num, uint64_t idx)
+    {
+        assert(!m_slots.empty());
+        Slot& slot = m_slots[find_slot(key)];
+        if (is_free(slot))
+        {
+            assert(m_size + 1 < m_slots.size());
+            ++m_size;
+        }
+        slot = Slot{key.hash, EntryPosition{key.id, block_num, idx}};
+    }
+
+    void erase(const HashedKey& key)
+    {
+        if (m_size == 0)
+        {
+            return;
+        }
+        uint64_t hole = find_slot(key);
+        if (is_free(m_slots[hole]))
+        {
+            return;
+        }
+        --m_size;
+
+        // Moves back every entry of the run that can't be reached from its home slot once the hole is free.
+        for (uint64_t idx = (hole + 1) & m_mask; !is_free(m_slots[idx]); idx = (idx + 1) & m_mask)
+        {
+            const uint64_t home = m_slots[idx].hash & m_mask;
+            if (((idx - home) & m_mask) >= ((idx - hole) & m_mask))
+            {
+                m_slots[hole] = m_slots[idx];
+                hole = idx;
+            }
+        }
+        m_slots[hole].pos.block_num = EMPTY;
+    }
+
+    void clear()
+    {
+        for (Slot& slot : m_slots)
+        {
+            slot.pos.block_num = EMPTY;
+        }
+        m_size = 0;
+    }
+
+    [[nodiscard]] uint64_t size() const { return m_size; }
+
+    template <typename Func>
+    void for_each(Func&& func) const
+    {
+        for (const Slot& slot : m_slots)
+        {
+            if (!is_free(slot))
+            {
+                func(slot.pos);
+            }
+        }
+    }
+};
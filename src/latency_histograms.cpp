@@ -0,0 +1,194 @@
+#include <cstdint>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <sstream>
+#include <unordered_map>
+
+#include "latency_histograms.hpp"
+
+namespace {
+    std::atomic<uint64_t> next_histograms_id{1};
+
+    // Prometheus buckets at every power of 2 of nanoseconds, from 256ns to about 17s.
+    constexpr uint64_t MIN_EXPORTED_EXPONENT = 8;
+    constexpr uint64_t MAX_EXPORTED_EXPONENT = 34;
+}
+
+LatencyHistograms::LatencyHistograms() : m_id{next_histograms_id.fetch_add(1, std::memory_order_relaxed)} {}
+
+LatencyHistograms::Shard& LatencyHistograms::local_shard()
+{
+    // The last shard used by the thread is checked first, a thread serving a single cache never takes the lock again.
+    thread_local uint64_t last_id = 0;
+    thread_local Shard* last_shard = nullptr;
+    thread_local std::unordered_map<uint64_t, Shard*> shards;
+
+    if (last_id == m_id)
+    {
+        return *last_shard;
+    }
+
+    Shard*& shard = shards[m_id];
+    if (shard == nullptr)
+    {
+        std::lock_guard<std::mutex> guard(m_shards_lock);
+        shard = m_shards.emplace_back(std::make_unique<Shard>()).get();
+    }
+    last_id = m_id;
+    last_shard = shard;
+
+    return *shard;
+}
+
+size_t LatencyHistograms::bucket_index(uint64_t nanoseconds)
+{
+    if (nanoseconds < SUB_BUCKETS)
+    {
+        return nanoseconds;
+    }
+
+    const uint64_t exponent = std::bit_width(nanoseconds) - 1;
+    if (exponent > MAX_EXPONENT)
+    {
+        return NUM_OF_BUCKETS - 1;
+    }
+    const uint64_t sub_bucket = (nanoseconds >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+
+    return SUB_BUCKETS + (exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t LatencyHistograms::bucket_upper_bound(size_t idx)
+{
+    if (idx < SUB_BUCKETS)
+    {
+        return idx + 1;
+    }
+
+    const uint64_t exponent = (idx - SUB_BUCKETS) / SUB_BUCKETS + SUB_BUCKET_BITS;
+    const uint64_t sub_bucket = (idx - SUB_BUCKETS) % SUB_BUCKETS;
+
+    return (SUB_BUCKETS + sub_bucket + 1) << (exponent - SUB_BUCKET_BITS);
+}
+
+void LatencyHistograms::record(Op op, uint64_t nanoseconds)
+{
+    // Only this thread writes its shard, readers may see the count and the sum of a call apart.
+    Shard& shard = local_shard();
+    const auto op_idx = static_cast<size_t>(op);
+    std::atomic<uint64_t>& count = shard.counts[op_idx][bucket_index(nanoseconds)];
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic<uint64_t>& sum = shard.sums_ns[op_idx];
+    sum.store(sum.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+}
+
+LatencyHistograms::Snapshot LatencyHistograms::snapshot() const
+{
+    Snapshot res;
+    std::lock_guard<std::mutex> guard(m_shards_lock);
+    for (const std::unique_ptr<Shard>& shard : m_shards)
+    {
+        for (size_t op = 0; op < NUM_OF_OPS; ++op)
+        {
+            for (size_t idx = 0; idx < NUM_OF_BUCKETS; ++idx)
+            {
+                res.counts[op][idx] += shard->counts[op][idx].load(std::memory_order_relaxed);
+            }
+            res.sums_ns[op] += shard->sums_ns[op].load(std::memory_order_relaxed);
+        }
+    }
+
+    return res;
+}
+
+uint64_t LatencyHistograms::count(Op op) const
+{
+    const Snapshot merged = snapshot();
+    const auto& counts = merged.counts[static_cast<size_t>(op)];
+    uint64_t total = 0;
+    for (uint64_t count : counts)
+    {
+        total += count;
+    }
+
+    return total;
+}
+
+double LatencyHistograms::quantile(Op op, double q) const
+{
+    const Snapshot merged = snapshot();
+    const auto& counts = merged.counts[static_cast<size_t>(op)];
+    uint64_t total = 0;
+    for (uint64_t count : counts)
+    {
+        total += count;
+    }
+    if (total == 0)
+    {
+        return 0.0;
+    }
+
+    // The upper bound of the bucket holding the rank, so the quantile is never under-reported.
+    const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(std::clamp(q, 0.0, 1.0) * static_cast<double>(total))));
+    uint64_t seen = 0;
+    for (size_t idx = 0; idx < NUM_OF_BUCKETS; ++idx)
+    {
+        seen += counts[idx];
+        if (seen >= rank)
+        {
+            return static_cast<double>(bucket_upper_bound(idx)) * 1e-9;
+        }
+    }
+
+    return static_cast<double>(bucket_upper_bound(NUM_OF_BUCKETS - 1)) * 1e-9;
+}
+
+std::string LatencyHistograms::to_prometheus(const std::string& prefix) const
+{
+    const Snapshot merged = snapshot();
+    const std::string name = prefix + "_operation_duration_seconds";
+
+    std::ostringstream os;
+    os << "# HELP " << name << " Duration of the cache operations, including the wait for the cache locks.\n";
+    os << "# TYPE " << name << " histogram\n";
+    for (size_t op = 0; op < NUM_OF_OPS; ++op)
+    {
+        const auto& counts = merged.counts[op];
+        const std::string label = std::string("op=\"") + OP_NAMES[op] + "\"";
+
+        // The buckets are aligned on powers of 2, so every exported bound is the edge of a bucket.
+        uint64_t cumulative = 0;
+        size_t idx = 0;
+        for (uint64_t exponent = MIN_EXPORTED_EXPONENT; exponent <= MAX_EXPORTED_EXPONENT; ++exponent)
+        {
+            const uint64_t bound_ns = 1ULL << exponent;
+            for (; idx < NUM_OF_BUCKETS && bucket_upper_bound(idx) <= bound_ns; ++idx)
+            {
+                cumulative += counts[idx];
+            }
+            os << name << "_bucket{" << label << ",le=\"" << static_cast<double>(bound_ns) * 1e-9 << "\"} " << cumulative << "\n";
+        }
+        for (; idx < NUM_OF_BUCKETS; ++idx)
+        {
+            cumulative += counts[idx];
+        }
+        os << name << "_bucket{" << label << ",le=\"+Inf\"} " << cumulative << "\n";
+        os << name << "_sum{" << label << "} " << static_cast<double>(merged.sums_ns[op]) * 1e-9 << "\n";
+        os << name << "_count{" << label << "} " << cumulative << "\n";
+    }
+
+    return os.str();
+}
+
+std::optional<LatencyHistograms::Op> LatencyHistograms::parse_op(const std::string& name)
+{
+    for (size_t op = 0; op < NUM_OF_OPS; ++op)
+    {
+        if (name == OP_NAMES[op])
+        {
+            return static_cast<Op>(op);
+        }
+    }
+
+    return std::nullopt;
+}
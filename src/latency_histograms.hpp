@@ -0,0 +1,110 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Latency distribution of the cache's own operations, in log buckets: 8 sub-buckets per power of 2 of
+// nanoseconds, so a recorded duration is known within 12.5%, from 1ns up to about 2 hours.
+// Every thread records into a shard of its own, which only that thread writes, so recording takes no lock
+// and shares no cache line. Reading merges the shards of all the threads that ever recorded.
+class LatencyHistograms {
+public:
+    enum class Op : uint8_t
+    {
+        LOOKUP_HIT,
+        LOOKUP_MISS,
+        LOOKUP_BATCH,
+        SETITEM,
+        SETITEM_BATCH,
+        GHOST_SIMULATION,
+        ADAPT,
+        CREATE_GHOST_CACHES,
+        COUNT
+    };
+
+    constexpr static size_t NUM_OF_OPS = static_cast<size_t>(Op::COUNT);
+    constexpr static std::array<const char*, NUM_OF_OPS> OP_NAMES = {
+        "lookup_hit", "lookup_miss", "lookup_batch", "setitem", "setitem_batch",
+        "ghost_simulation", "adapt", "create_ghost_caches"
+    };
+
+    constexpr static uint64_t SUB_BUCKET_BITS = 3;
+    constexpr static uint64_t SUB_BUCKETS = 1ULL << SUB_BUCKET_BITS;
+    constexpr static uint64_t MAX_EXPONENT = 42;
+    constexpr static size_t NUM_OF_BUCKETS = SUB_BUCKETS + (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    struct Snapshot
+    {
+        std::array<std::array<uint64_t, NUM_OF_BUCKETS>, NUM_OF_OPS> counts{};
+        std::array<uint64_t, NUM_OF_OPS> sums_ns{};
+    };
+
+    // Records the time until the end of the scope, does nothing without histograms.
+    class ScopedTimer {
+    private:
+        LatencyHistograms* m_histograms;
+        Op m_op;
+        std::chrono::steady_clock::time_point m_start;
+
+    public:
+        ScopedTimer(LatencyHistograms* histograms, Op op) : m_histograms{histograms},
+                                                            m_op{op},
+                                                            m_start{histograms != nullptr
+                                                                        ? std::chrono::steady_clock::now()
+                                                                        : std::chrono::steady_clock::time_point{}} {}
+        ~ScopedTimer()
+        {
+            if (m_histograms != nullptr)
+            {
+                const auto elapsed = std::chrono::steady_clock::now() - m_start;
+                m_histograms->record(m_op, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+            }
+        }
+
+        // Records under another op, e.g. once a lookup turns out to be a hit.
+        void set_op(Op op) { m_op = op; }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+    };
+
+private:
+    struct Shard
+    {
+        std::array<std::array<std::atomic<uint64_t>, NUM_OF_BUCKETS>, NUM_OF_OPS> counts{};
+        std::array<std::atomic<uint64_t>, NUM_OF_OPS> sums_ns{};
+    };
+
+    // Threads find their shard by this id rather than by the address, which a later instance may reuse.
+    const uint64_t m_id;
+    mutable std::mutex m_shards_lock;
+    std::vector<std::unique_ptr<Shard>> m_shards;
+
+    Shard& local_shard();
+
+public:
+    LatencyHistograms();
+
+    LatencyHistograms(const LatencyHistograms&) = delete;
+    LatencyHistograms& operator=(const LatencyHistograms&) = delete;
+
+    void record(Op op, uint64_t nanoseconds);
+
+    [[nodiscard]] Snapshot snapshot() const;
+    // The duration under which a fraction q of the op's calls completed, in seconds, 0 before any call.
+    [[nodiscard]] double quantile(Op op, double q) const;
+    [[nodiscard]] uint64_t count(Op op) const;
+    // One histogram metric, labeled by op, in the Prometheus text exposition format.
+    [[nodiscard]] std::string to_prometheus(const std::string& prefix) const;
+
+    [[nodiscard]] static std::optional<Op> parse_op(const std::string& name);
+    [[nodiscard]] static size_t bucket_index(uint64_t nanoseconds);
+    // The smallest duration above the bucket, in nanoseconds.
+    [[nodiscard]] static uint64_t bucket_upper_bound(size_t idx);
+};
@@ -0,0 +1,123 @@
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#endif
+
+#include "memory_policy.hpp"
+
+namespace {
+#ifdef __linux__
+    constexpr int MPOL_BIND = 2;  // from <numaif.h>, which would pull in libnuma for a single syscall
+
+    size_t mapping_size(size_t bytes, const MemoryPolicy& policy)
+    {
+        const size_t page_size = policy.huge_pages && bytes >= memory::HUGE_PAGE_SIZE
+                                     ? memory::HUGE_PAGE_SIZE
+                                     : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return (bytes + page_size - 1) / page_size * page_size;
+    }
+
+    void* map_pages(size_t size, const MemoryPolicy& policy)
+    {
+        constexpr int PROT = PROT_READ | PROT_WRITE;
+        constexpr int FLAGS = MAP_PRIVATE | MAP_ANONYMOUS;
+
+        if (policy.huge_pages && size % memory::HUGE_PAGE_SIZE == 0)
+        {
+            // Reserved huge pages first, they are usually not configured, then transparent ones.
+            void* addr = mmap(nullptr, size, PROT, FLAGS | MAP_HUGETLB, -1, 0);
+            if (addr != MAP_FAILED)
+            {
+                return addr;
+            }
+            addr = mmap(nullptr, size, PROT, FLAGS, -1, 0);
+            if (addr != MAP_FAILED)
+            {
+                madvise(addr, size, MADV_HUGEPAGE);
+            }
+            return addr;
+        }
+
+        return mmap(nullptr, size, PROT, FLAGS, -1, 0);
+    }
+
+    void bind_to_node(void* addr, size_t size, int node)
+    {
+        constexpr unsigned long BITS_PER_WORD = 8 * sizeof(unsigned long);
+        unsigned long node_mask[4] = {};
+        if (node < 0 || static_cast<unsigned long>(node) >= 4 * BITS_PER_WORD)
+        {
+            return;
+        }
+        node_mask[node / BITS_PER_WORD] = 1UL << (node % BITS_PER_WORD);
+        // A failure leaves the default placement, the memory is still usable.
+        syscall(SYS_mbind, addr, size, MPOL_BIND, node_mask, 4 * BITS_PER_WORD + 1, 0);
+    }
+#endif
+}
+
+namespace memory {
+    bool allocates_zeroed(const MemoryPolicy& policy)
+    {
+#ifdef __linux__
+        return !policy.is_default();
+#else
+        (void)policy;
+        return false;
+#endif
+    }
+
+    void* allocate(size_t bytes, const MemoryPolicy& policy)
+    {
+#ifdef __linux__
+        if (!policy.is_default() && bytes > 0)
+        {
+            const size_t size = mapping_size(bytes, policy);
+            void* addr = map_pages(size, policy);
+            if (addr == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+            if (policy.numa_node >= 0)
+            {
+                bind_to_node(addr, size, policy.numa_node);
+            }
+            return addr;
+        }
+#endif
+        return ::operator new(bytes);
+    }
+
+    void deallocate(void* ptr, size_t bytes, const MemoryPolicy& policy)
+    {
+        if (ptr == nullptr)
+        {
+            return;
+        }
+#ifdef __linux__
+        if (!policy.is_default() && bytes > 0)
+        {
+            munmap(ptr, mapping_size(bytes, policy));
+            return;
+        }
+#endif
+        ::operator delete(ptr);
+    }
+
+    bool is_numa_node_available(int node)
+    {
+#ifdef __linux__
+        struct stat st{};
+        return node >= 0 && stat(("/sys/devices/system/node/node" + std::to_string(node)).c_str(), &st) == 0;
+#else
+        return false;
+#endif
+    }
+}
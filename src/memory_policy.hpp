@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+// Where the large arrays of a cache (the block arrays, the key index and the sketch) get their memory.
+// The default policy uses the regular allocator. Otherwise the arrays are mapped directly: with huge pages
+// an array of at least one huge page is backed by 2MB pages, explicitly reserved ones when the system has
+// them and transparent ones otherwise, which cuts the TLB misses of the random accesses into it.
+// With a NUMA node, the pages of the mapping are bound to that node before they are first touched.
+// Both are hints: when the system can't honour them, the arrays fall back to regular pages and placement.
+struct MemoryPolicy
+{
+    bool huge_pages = false;
+    int numa_node = -1;  // -1 leaves the placement to the kernel
+
+    [[nodiscard]] bool is_default() const { return !huge_pages && numa_node < 0; }
+    bool operator==(const MemoryPolicy& other) const = default;
+};
+
+namespace memory {
+    constexpr size_t HUGE_PAGE_SIZE = size_t{2} << 20;
+
+    // The returned memory is zeroed when it is mapped, and uninitialized otherwise.
+    [[nodiscard]] void* allocate(size_t bytes, const MemoryPolicy& policy);
+    // Whether allocate maps the memory of the policy, and so returns it zeroed.
+    [[nodiscard]] bool allocates_zeroed(const MemoryPolicy& policy);
+    // Takes the same size and policy the memory was allocated with.
+    void deallocate(void* ptr, size_t bytes, const MemoryPolicy& policy);
+
+    // Whether the NUMA node exists on this host, always false where NUMA placement isn't supported.
+    [[nodiscard]] bool is_numa_node_available(int node);
+
+    // Allocator for the standard containers of the cache, carrying the policy of the cache it belongs to.
+    // A copied or assigned container takes the policy of its source along with the items.
+    template <typename T>
+    class PolicyAllocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        MemoryPolicy policy;
+
+        PolicyAllocator() = default;
+        explicit PolicyAllocator(const MemoryPolicy& policy) : policy{policy} {}
+        template <typename U>
+        PolicyAllocator(const PolicyAllocator<U>& other) : policy{other.policy} {}
+
+        [[nodiscard]] T* allocate(size_t count)
+        {
+            return static_cast<T*>(memory::allocate(count * sizeof(T), policy));
+        }
+
+        void deallocate(T* ptr, size_t count)
+        {
+            memory::deallocate(ptr, count * sizeof(T), policy);
+        }
+
+        template <typename U>
+        bool operator==(const PolicyAllocator<U>& other) const { return policy == other.policy; }
+    };
+}
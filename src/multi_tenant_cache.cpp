@@ -0,0 +1,223 @@
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+#include <unordered_set>
+#include <chrono>
+
+#include "multi_tenant_cache.hpp"
+
+Json MultiTenantCache::tenant_config(const Json& config, const std::string& name, uint64_t capacity)
+{
+    Json res = config;
+    res.erase("tenants");
+    res["cache"]["capacity"] = capacity;
+    for (const char* section : {"spill", "event_log", "capture"})
+    {
+        if (res.contains(section))
+        {
+            res[section]["path"] = res[section]["path"].get<std::string>() + "." + name;
+        }
+    }
+    if (res.contains("shared"))
+    {
+        res["shared"]["name"] = res["shared"]["name"].get<std::string>() + "-" + name;
+    }
+
+    return res;
+}
+
+void MultiTenantCache::run_rebalancer()
+{
+    std::unique_lock<std::mutex> lock(m_rebalancer_lock);
+    while (!m_stopping)
+    {
+        m_rebalancer_cv.wait_for(lock, std::chrono::milliseconds(m_rebalance_interval_ms));
+        if (!m_stopping)
+        {
+            lock.unlock();
+            rebalance();
+            lock.lock();
+        }
+    }
+}
+
+MultiTenantCache::MultiTenantCache(Json config) : m_names{},
+                                                  m_tenants{},
+                                                  m_capacity{0},
+                                                  m_quantum_size{0},
+                                                  m_min_quanta{1},
+                                                  m_quanta_alloc{},
+                                                  m_rebalance_interval_ms{0},
+                                                  m_stopping{false}
+{
+    try {
+        const Json& tenants_config = config["tenants"];
+        m_names = tenants_config["names"].get<std::vector<std::string>>();
+        const std::unordered_set<std::string> unique_names(m_names.begin(), m_names.end());
+        if (m_names.empty() || unique_names.size() != m_names.size())
+        {
+            std::cerr << "the tenants need distinct names" << std::endl;
+            exit(1);
+        }
+
+        m_capacity = config["cache"]["capacity"].get<uint64_t>();
+        const uint64_t num_of_quanta = tenants_config["num_of_quanta"].get<uint64_t>();
+        const uint64_t tenant_granularity = config["cache"]["num_of_quanta"].get<uint64_t>()
+                                            * config["cache"]["sample_rate"].get<uint64_t>();
+        if (num_of_quanta < m_names.size() || m_capacity % num_of_quanta != 0
+            || (m_capacity / num_of_quanta) % tenant_granularity != 0)
+        {
+            std::cerr << "the tenants' num_of_quanta must be at least the number of tenants, and divide the capacity "
+                      << "into quanta that are multiples of num_of_quanta * sample_rate" << std::endl;
+            exit(1);
+        }
+        m_quantum_size = m_capacity / num_of_quanta;
+
+        // An even split by default, the first tenants get the remainder.
+        if (tenants_config.contains("initial_quanta"))
+        {
+            m_quanta_alloc = tenants_config["initial_quanta"].get<std::vector<uint64_t>>();
+        }
+        else
+        {
+            for (size_t idx = 0; idx < m_names.size(); ++idx)
+            {
+                m_quanta_alloc.push_back(num_of_quanta / m_names.size() + (idx < num_of_quanta % m_names.size() ? 1 : 0));
+            }
+        }
+
+        m_min_quanta = tenants_config.value("min_quanta", 1ULL);
+        uint64_t total_quanta = 0;
+        for (uint64_t quanta : m_quanta_alloc)
+        {
+            total_quanta += quanta;
+        }
+        if (m_quanta_alloc.size() != m_names.size() || total_quanta != num_of_quanta || m_min_quanta == 0
+            || *std::min_element(m_quanta_alloc.begin(), m_quanta_alloc.end()) < m_min_quanta)
+        {
+            std::cerr << "every tenant needs initial_quanta of at least min_quanta (1 or more), summing to num_of_quanta" << std::endl;
+            exit(1);
+        }
+
+        m_rebalance_interval_ms = tenants_config.value("rebalance_interval_ms", 1000ULL);
+    }
+    catch (const Json::exception& e) {
+        std::cerr << "ERROR: Failed to read cache config: " << e.what() << "\n";
+        exit(1);
+    }
+
+    for (size_t idx = 0; idx < m_names.size(); ++idx)
+    {
+        m_tenants.push_back(std::make_unique<AdaptivePipelineCache>(
+            tenant_config(config, m_names[idx], m_quanta_alloc[idx] * m_quantum_size)));
+        m_tenants.back()->enable_budget_ghosts(m_quantum_size);
+    }
+
+    // Without an interval the tenants are only rebalanced by calling rebalance().
+    if (m_rebalance_interval_ms > 0)
+    {
+        m_rebalancer = std::thread(&MultiTenantCache::run_rebalancer, this);
+    }
+}
+
+MultiTenantCache::~MultiTenantCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_rebalancer_lock);
+        m_stopping = true;
+    }
+    m_rebalancer_cv.notify_one();
+    if (m_rebalancer.joinable())
+    {
+        m_rebalancer.join();
+    }
+}
+
+bool MultiTenantCache::rebalance()
+{
+    std::lock_guard<std::mutex> guard(m_rebalance_lock);
+    const size_t num_of_tenants = m_tenants.size();
+    std::vector<AdaptivePipelineCache::BudgetCosts> costs;
+    costs.reserve(num_of_tenants);
+    for (const std::unique_ptr<AdaptivePipelineCache>& tenant : m_tenants)
+    {
+        costs.push_back(tenant->budget_costs());
+    }
+
+    // The costs are totals over the same timeframe and sample rate, so a busier tenant saves more with the same quantum.
+    size_t dest = num_of_tenants;
+    double max_saving = 0.0;
+    for (size_t idx = 0; idx < num_of_tenants; ++idx)
+    {
+        if (const double saving = costs[idx].current - costs[idx].grown; saving > max_saving)
+        {
+            max_saving = saving;
+            dest = idx;
+        }
+    }
+
+    size_t src = num_of_tenants;
+    double min_loss = std::numeric_limits<double>::max();
+    for (size_t idx = 0; idx < num_of_tenants; ++idx)
+    {
+        if (idx == dest || m_quanta_alloc[idx] <= m_min_quanta)
+        {
+            continue;
+        }
+        if (const double loss = costs[idx].shrunk - costs[idx].current; loss < min_loss)
+        {
+            min_loss = loss;
+            src = idx;
+        }
+    }
+
+    const bool should_move = dest < num_of_tenants && src < num_of_tenants && max_saving > min_loss;
+    if (should_move)
+    {
+        // The source shrinks first, so the tenants never hold more than the capacity together.
+        --m_quanta_alloc[src];
+        ++m_quanta_alloc[dest];
+        m_tenants[src]->resize(m_quanta_alloc[src] * m_quantum_size);
+        m_tenants[dest]->resize(m_quanta_alloc[dest] * m_quantum_size);
+    }
+
+    // The resized tenants already started a new timeframe.
+    for (size_t idx = 0; idx < num_of_tenants; ++idx)
+    {
+        if (!should_move || (idx != src && idx != dest))
+        {
+            m_tenants[idx]->reset_budget_ghosts();
+        }
+    }
+
+    return should_move;
+}
+
+AdaptivePipelineCache* MultiTenantCache::find_tenant(const std::string& name)
+{
+    const auto itr = std::find(m_names.begin(), m_names.end(), name);
+    return itr != m_names.end() ? m_tenants[itr - m_names.begin()].get() : nullptr;
+}
+
+std::vector<uint64_t> MultiTenantCache::quanta_alloc() const
+{
+    std::lock_guard<std::mutex> guard(m_rebalance_lock);
+    return m_quanta_alloc;
+}
+
+void MultiTenantCache::set_payload_hooks(AdaptivePipelineCache::PayloadHook retain, AdaptivePipelineCache::PayloadHook release)
+{
+    for (const std::unique_ptr<AdaptivePipelineCache>& tenant : m_tenants)
+    {
+        tenant->set_payload_hooks(retain, release);
+    }
+}
+
+void MultiTenantCache::release_pending_payloads()
+{
+    for (const std::unique_ptr<AdaptivePipelineCache>& tenant : m_tenants)
+    {
+        tenant->release_pending_payloads();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "adaptive_pipeline_cache.hpp"
+
+// Several AdaptivePipelineCache tenants, e.g. one per model, sharing the capacity of the config's "cache" section.
+// The capacity is split into budget quanta which move between the tenants as the quanta of the blocks move within
+// a tenant: every tenant simulates its sampled stream on ghosts a budget quantum smaller and larger, and each
+// rebalance moves one quantum from the tenant that would lose the least without it to the one that would save the most
+// with it, when the saving is the larger. The tenants are used directly, a background thread rebalances them.
+class MultiTenantCache {
+private:
+    std::vector<std::string> m_names;
+    std::vector<std::unique_ptr<AdaptivePipelineCache>> m_tenants;
+    uint64_t m_capacity;
+    uint64_t m_quantum_size;
+    uint64_t m_min_quanta;
+
+    // Guards the allocation, rebalances run one at a time.
+    mutable std::mutex m_rebalance_lock;
+    std::vector<uint64_t> m_quanta_alloc;
+
+    uint64_t m_rebalance_interval_ms;
+    std::mutex m_rebalancer_lock;
+    std::condition_variable m_rebalancer_cv;
+    bool m_stopping;
+    std::thread m_rebalancer;
+
+    // The config of one tenant: the shared one with its share of the capacity, and files and segments of its own.
+    static Json tenant_config(const Json& config, const std::string& name, uint64_t capacity);
+
+    void run_rebalancer();
+
+public:
+    explicit MultiTenantCache(const std::string& config_path)
+        : MultiTenantCache(PipelineCache::load_config(config_path)) {}
+
+    explicit MultiTenantCache(const char* config_path) : MultiTenantCache(std::string{config_path}) {}
+
+    explicit MultiTenantCache(Json config);
+
+    ~MultiTenantCache();
+
+    MultiTenantCache(const MultiTenantCache&) = delete;
+    MultiTenantCache& operator=(const MultiTenantCache&) = delete;
+
+    // Moves at most one budget quantum, comparing the costs of the tenants since the previous rebalance.
+    // Returns whether a quantum was moved.
+    bool rebalance();
+
+    // nullptr when there is no tenant of that name.
+    AdaptivePipelineCache* find_tenant(const std::string& name);
+
+    AdaptivePipelineCache& tenant(size_t idx) { return *m_tenants.at(idx); }
+
+    const std::vector<std::string>& tenant_names() const { return m_names; }
+
+    std::vector<uint64_t> quanta_alloc() const;
+
+    size_t capacity() const { return m_capacity; }
+    size_t quantum_size() const { return m_quantum_size; }
+
+    void set_payload_hooks(AdaptivePipelineCache::PayloadHook retain, AdaptivePipelineCache::PayloadHook release);
+
+    // Like AdaptivePipelineCache::release_pending_payloads, for the payloads of every tenant.
+    void release_pending_payloads();
+};
@@ -7,25 +7,119 @@
 #include <tuple>
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <array>
 
 #include "utils.cpp"
 #include "fixed_size_array.hpp"
+#include "hashed_key.hpp"
 
+// The key, the exact costs and the owner's data of a cached entry, read on a hit or when the entry leaves the cache.
+// They are kept out of the block arrays, in a side array of the cache indexed by CompactEntry::value_idx.
+struct EntryValue
+{
+    uint64_t id;
+    uint64_t hash;
+    double latency;
+    uint64_t tokens;
+    uint64_t digest;
+    void* payload;
+
+    [[nodiscard]] HashedKey key() const { return HashedKey{id, hash}; }
+};
+
+namespace cost_scale {
+    // 2^(step / 256) split into its fractional and its integer power of 2, so a step is read back with two lookups
+    // and an exact multiplication by a power of 2, instead of an exp2 for every sampled candidate.
+    inline const std::array<double, 256> FRACTION_POWERS = [] {
+        std::array<double, 256> powers{};
+        for (size_t idx = 0; idx < powers.size(); ++idx)
+        {
+            powers[idx] = std::exp2(static_cast<double>(idx) / 256.0);
+        }
+        return powers;
+    }();
+
+    inline const std::array<double, 256> INTEGER_POWERS = [] {
+        std::array<double, 256> powers{};
+        for (size_t idx = 0; idx < powers.size(); ++idx)
+        {
+            powers[idx] = std::ldexp(1.0, static_cast<int>(idx) - 64);
+        }
+        return powers;
+    }();
+}
+
+// The entry as stored in the block arrays: only what the policies scan while picking a victim,
+// so four entries share a cache line. The key itself is in the EntryValue, the entry keeps the fingerprint
+// of its hash for the sketch, and its value_idx, which is unique among the resident entries, identifies it
+// within its block. Its cost, latency * tokens or the one of the cache's CostModel, is kept on a log scale
+// in 16 bits, 1/256 of a power of 2 per step, which ranks entries within 0.3% of their exact cost.
+struct CompactEntry
+{
+    uint32_t value_idx;  // of its EntryValue in the cache
+    uint32_t fingerprint;
+    uint64_t last_access_time : 48;  // in ms, as utils::get_current_time_in_ms, which fits 48 bits until the year 10000
+    uint64_t quantized_cost : 16;
+
+    CompactEntry(const HashedKey& key, double latency, uint64_t tokens, uint32_t value_idx = 0)
+        : value_idx(value_idx), fingerprint(key.fingerprint()), last_access_time(utils::get_current_time_in_ms()),
+          quantized_cost(quantize_cost(latency * static_cast<double>(tokens))) {}
+    CompactEntry() : value_idx(0), fingerprint(0), last_access_time(0), quantized_cost(0) {}
+
+    [[nodiscard]] static CompactEntry with_cost(const HashedKey& key, double cost, uint32_t value_idx)
+    {
+        CompactEntry entry{key, 0.0, 0, value_idx};
+        entry.quantized_cost = quantize_cost(cost);
+        return entry;
+    }
+
+    [[nodiscard]] double cost() const { return dequantize_cost(static_cast<uint16_t>(quantized_cost)); }
+
+    // 0 is kept for a free entry, the other steps cover costs from 2^-64 to 2^192.
+    [[nodiscard]] static uint16_t quantize_cost(double cost)
+    {
+        if (!(cost > 0))
+        {
+            return 0;
+        }
+        const double step = std::round((std::log2(cost) + 64.0) * 256.0);
+        return static_cast<uint16_t>(std::clamp(step, 1.0, 65535.0));
+    }
+
+    [[nodiscard]] static double dequantize_cost(uint16_t quantized_cost)
+    {
+        return quantized_cost == 0
+                   ? 0.0
+                   : cost_scale::FRACTION_POWERS[quantized_cost & 0xFF] * cost_scale::INTEGER_POWERS[quantized_cost >> 8];
+    }
+};
+
+static_assert(sizeof(CompactEntry) == 16, "four entries per cache line");
+
+// A whole entry, as it enters or leaves the cache: popped, erased, spilled or shared.
 struct EntryData
 {
     uint64_t id;
+    uint64_t hash;    // of the id, so the sketch and the key index never hash a resident entry again
     double latency;
     uint64_t tokens;
     uint64_t last_access_time;
-    EntryData(uint64_t id, double latency, uint64_t tokens) : id(id), latency(latency), tokens(tokens), last_access_time(utils::get_current_time_in_ms()) {}
-    EntryData() : id(0), latency(0.0), tokens(0), last_access_time(0) {}
+    uint64_t digest;  // verifies the full key when id is a fingerprint of a str/bytes key, 0 otherwise
+    void* payload;    // opaque value owned by AdaptivePipelineCache, never dereferenced by the blocks
+    EntryData(const HashedKey& key, double latency, uint64_t tokens) : id(key.id), hash(key.hash), latency(latency), tokens(tokens), last_access_time(utils::get_current_time_in_ms()), digest(0), payload(nullptr) {}
+    EntryData(const CompactEntry& entry, const EntryValue& value) : id(value.id), hash(value.hash), latency(value.latency), tokens(value.tokens), last_access_time(entry.last_access_time), digest(value.digest), payload(value.payload) {}
+    EntryData() : id(0), hash(0), latency(0.0), tokens(0), last_access_time(0), digest(0), payload(nullptr) {}
+
+    [[nodiscard]] HashedKey key() const { return HashedKey{id, hash}; }
 };
 
 struct InsertionResult
 {
     bool was_item_inserted{false};
     uint64_t replaced_idx{std::numeric_limits<uint64_t>::max()};
-    std::optional<EntryData> removed_entry;
+    std::optional<CompactEntry> removed_entry;
 };
 
 using NewLocationData = std::vector<std::pair<uint64_t, uint64_t>>;
@@ -36,19 +130,99 @@ struct QuantumMoveResult
     NewLocationData items_remaining;
 };
 
+// The best eviction candidates of the previous samples of a sampling block, lowest score first, like Redis's
+// eviction pool. A candidate is a hint: its slot may hold another entry by now, or its score may have changed,
+// so it is revalidated when it is about to be picked. Disabled with a capacity of 0.
+class EvictionPool {
+private:
+    struct Candidate
+    {
+        uint64_t idx;
+        uint64_t value_idx;
+        double score;
+    };
+
+    std::vector<Candidate> m_candidates;  // sorted by score
+    size_t m_capacity;
+
+public:
+    explicit EvictionPool(size_t capacity = 0) : m_candidates{}, m_capacity{capacity}
+    {
+        m_candidates.reserve(capacity + 1);
+    }
+
+    [[nodiscard]] bool enabled() const { return m_capacity > 0; }
+
+    void offer(uint64_t idx, uint64_t value_idx, double score)
+    {
+        // An entry sampled again replaces its previous score.
+        const auto same_entry = std::find_if(m_candidates.begin(), m_candidates.end(),
+                                             [value_idx](const Candidate& candidate) { return candidate.value_idx == value_idx; });
+        if (same_entry != m_candidates.end())
+        {
+            m_candidates.erase(same_entry);
+        }
+        else if (m_candidates.size() == m_capacity && score >= m_candidates.back().score)
+        {
+            return;
+        }
+
+        const auto position = std::upper_bound(m_candidates.begin(), m_candidates.end(), score,
+                                               [](double value, const Candidate& candidate) { return value < candidate.score; });
+        m_candidates.insert(position, Candidate{idx, value_idx, score});
+        if (m_candidates.size() > m_capacity)
+        {
+            m_candidates.pop_back();
+        }
+    }
+
+    // The slot of the lowest scored candidate that is still in place. score_of(idx, value_idx) returns the current score
+    // of the entry, or nullopt once its slot holds another one. Candidates whose score changed are re-sorted.
+    template <typename ScoreOf>
+    std::optional<uint64_t> best(ScoreOf score_of)
+    {
+        while (!m_candidates.empty())
+        {
+            const Candidate candidate = m_candidates.front();
+            const std::optional<double> score = score_of(candidate.idx, candidate.value_idx);
+            if (score.has_value() && *score == candidate.score)
+            {
+                return candidate.idx;
+            }
+
+            m_candidates.erase(m_candidates.begin());
+            if (score.has_value())
+            {
+                offer(candidate.idx, candidate.value_idx, *score);
+            }
+        }
+
+        return std::nullopt;
+    }
+
+    void clear() { m_candidates.clear(); }
+};
+
 class PipelineBlock {
 public:
     virtual ~PipelineBlock() = default;
     // Using the Visitor pattern to allow direct memcpy.
     virtual QuantumMoveResult move_quanta_to(PipelineBlock& other) = 0;
-    virtual NewLocationData accept_quanta(FixedSizeArray<EntryData>& arr) = 0;
+    virtual NewLocationData accept_quanta(FixedSizeArray<CompactEntry>& arr) = 0;
 
-    virtual FixedSizeArray<EntryData>& get_arr() = 0;
-    virtual InsertionResult insert_item(const EntryData& item) = 0;
+    virtual FixedSizeArray<CompactEntry>& get_arr() = 0;
+    virtual InsertionResult insert_item(const CompactEntry& item) = 0;
+    // The entry the next insert_item() would replace, or nullptr while the block still has room.
+    virtual const CompactEntry* peek_victim() = 0;
     [[nodiscard]] virtual uint64_t size() const = 0;
     [[nodiscard]] virtual uint64_t capacity() const = 0;
     [[nodiscard]] virtual bool is_full() const = 0;
-    virtual EntryData* get_entry(uint64_t idx) = 0;
+    virtual CompactEntry* get_entry(uint64_t idx) = 0;
+    // Removes the entry at idx by moving the last entry of the block into its slot.
+    // Returns the value_idx of the moved entry, if an entry was moved.
+    virtual std::optional<uint64_t> remove_item(uint64_t idx) = 0;
+    // Called on every hit, lets each policy keep its own recency / frequency state.
+    virtual void record_access(uint64_t idx) = 0;
     virtual void prepare_for_copy() = 0;
     [[nodiscard]] virtual std::string get_type() const = 0;
     virtual void clear() = 0;
@@ -57,27 +231,57 @@ public:
 class BasePipelineBlock : public PipelineBlock 
 {
 protected:
-    FixedSizeArray<EntryData> m_arr;
+    FixedSizeArray<CompactEntry> m_arr;
     const uint64_t m_cache_max_capacity;
     const uint64_t m_quantum_size;
     uint64_t m_curr_max_capacity;
     const std::string m_type;
+
+    // A victim sampled by peek_victim(), reused by the next insertion as long as its slot still holds it.
+    struct SampledVictim
+    {
+        uint64_t idx;
+        uint64_t value_idx;
+    };
+    std::optional<SampledVictim> m_sampled_victim;
+
+    void remember_sampled_victim(uint64_t idx)
+    {
+        m_sampled_victim = SampledVictim{idx, m_arr[idx].value_idx};
+    }
+
+    std::optional<uint64_t> take_sampled_victim()
+    {
+        std::optional<uint64_t> idx{};
+        if (m_sampled_victim.has_value()
+            && m_sampled_victim->idx < m_arr.size()
+            && m_arr[m_sampled_victim->idx].value_idx == m_sampled_victim->value_idx)
+        {
+            idx = m_sampled_victim->idx;
+        }
+        m_sampled_victim.reset();
+
+        return idx;
+    }
 public:
     BasePipelineBlock(uint64_t cache_capacity,
                       uint64_t quantum_size,
                       uint64_t curr_quanta_alloc,
-                      const std::string& type) : m_arr{cache_capacity},
+                      const std::string& type,
+                      const MemoryPolicy& memory_policy = {}) : m_arr{cache_capacity, memory_policy},
                                                  m_cache_max_capacity {cache_capacity},
                                                  m_quantum_size{quantum_size},
                                                  m_curr_max_capacity{m_quantum_size * curr_quanta_alloc},
-                                                 m_type {type}
+                                                 m_type {type},
+                                                 m_sampled_victim{}
                                                  {}
 
     BasePipelineBlock(const BasePipelineBlock& other) : m_arr{other.m_arr},
                                                         m_cache_max_capacity{other.m_cache_max_capacity},
                                                         m_quantum_size{other.m_quantum_size},
                                                         m_curr_max_capacity{other.m_curr_max_capacity},
-                                                        m_type{other.m_type}
+                                                        m_type{other.m_type},
+                                                        m_sampled_victim{}
                                                   {}
 
     BasePipelineBlock& operator=(const BasePipelineBlock& other)
@@ -93,7 +297,7 @@ public:
     virtual ~BasePipelineBlock() = default;
 
     
-    NewLocationData accept_quanta(FixedSizeArray<EntryData>& arr) override
+    NewLocationData accept_quanta(FixedSizeArray<CompactEntry>& arr) override
     {
         this->m_curr_max_capacity += this->m_quantum_size;
         assert(this->m_curr_max_capacity <= this->m_cache_max_capacity);
@@ -107,9 +311,9 @@ public:
             const uint64_t dest_start_idx = m_arr.size();
             arr.partial_move_to(m_arr, this->m_quantum_size);
 
-            for (uint64_t i = 0; i < this->m_quantum_size; ++i) 
+            for (uint64_t idx = dest_start_idx; idx < m_arr.size(); ++idx) 
             {
-                locations.emplace_back(m_arr[dest_start_idx + i].id, dest_start_idx + i);
+                locations.emplace_back(m_arr[idx].value_idx, idx);
             }
         }
 
@@ -117,7 +321,7 @@ public:
         return locations;
     }
 
-    FixedSizeArray<EntryData>& get_arr() override { return m_arr; };
+    FixedSizeArray<CompactEntry>& get_arr() override { return m_arr; };
 
     uint64_t size() const override { return m_arr.size(); };
 
@@ -125,12 +329,34 @@ public:
 
     bool is_full() const override { return size() == capacity();}
 
-    EntryData* get_entry(uint64_t idx) override 
+    CompactEntry* get_entry(uint64_t idx) override 
     {
         assert(idx >= 0 && idx < m_arr.size());
         return m_arr.get_item(idx);
     }
 
+    std::optional<uint64_t> remove_item(uint64_t idx) override
+    {
+        assert(idx < m_arr.size());
+        assert(!m_arr.is_rotated());
+
+        std::optional<uint64_t> moved_id{};
+        const CompactEntry last_entry = m_arr.pop_tail();
+        if (idx < m_arr.size())
+        {
+            m_arr[idx] = last_entry;
+            moved_id = last_entry.value_idx;
+        }
+
+        return moved_id;
+    }
+
+    void record_access(uint64_t idx) override
+    {
+        assert(idx < m_arr.size());
+        m_arr[idx].last_access_time = utils::get_current_time_in_ms();
+    }
+
     std::string get_type() const override { return m_type; }
 
     void clear() override { m_arr.clear(); }
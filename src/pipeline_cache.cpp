@@ -1,6 +1,7 @@
 #include <cassert>
 #include <cstdint>
 #include <limits>
+#include <algorithm>
 #include <sstream>
 #include <fstream>
 #include <stdexcept>
@@ -8,29 +9,37 @@
 #include <nlohmann/json.hpp>
 
 #include "pipeline_cache.hpp"
+#include "event_log.hpp"
 
 #include "pipeline_block.hpp"
 #include "utils.cpp"
 
 #include "fifo_block.cpp"
 #include "approximate_lru_block.cpp"
+#include "clock_block.cpp"
 #include "cost_aware_lfu_block.cpp"
+#include "gdsf_block.cpp"
 
 using Json = nlohmann::json;
 
 IPipelineCache::~IPipelineCache() = default;
 
-PipelineCache::PipelineCache() : m_cache_capacity(0), m_quantum_size(0), m_num_of_quanta(0) {}
+PipelineCache::PipelineCache() : m_cache_capacity(0), m_quantum_size(0), m_num_of_quanta(0), m_updates_sketch(false) {}
 PipelineCache::PipelineCache(const std::string& config_path) : PipelineCache(false, config_path) {}
 
 PipelineCache::PipelineCache(const PipelineCache& other) : m_cache_capacity {other.m_cache_capacity},
                                                            m_quantum_size{other.m_quantum_size},
                                                            m_items{other.m_items},
+                                                           m_values{other.m_values},
+                                                           m_free_values{other.m_free_values},
                                                            m_blocks{},
                                                            m_quanta_alloc{other.m_quanta_alloc},
+                                                           m_admission{other.m_admission},
+                                                           m_cost_model{other.m_cost_model},
                                                            m_eviction_queue{},
                                                            m_num_of_quanta(other.m_num_of_quanta),
                                                            m_sketch{other.m_sketch},
+                                                           m_updates_sketch{false},
                                                            m_aging_window_size(other.m_aging_window_size),
                                                            m_ops_since_last_aging{0},
                                                            m_stats{}
@@ -44,8 +53,12 @@ PipelineCache::PipelineCache(const PipelineCache& other) : m_cache_capacity {oth
             m_blocks[i] = std::make_unique<FIFOBlock>(*dynamic_cast<FIFOBlock*>(other.m_blocks[i].get()));
         } else if (block_type == "ALRU") {
             m_blocks[i] = std::make_unique<ALRUBlock>(*dynamic_cast<ALRUBlock*>(other.m_blocks[i].get()));
+        } else if (block_type == "Clock") {
+            m_blocks[i] = std::make_unique<ClockBlock>(*dynamic_cast<ClockBlock*>(other.m_blocks[i].get()));
         } else if (block_type == "CostAwareLFU") {
             m_blocks[i] = std::make_unique<CostAwareLFUBlock>(*dynamic_cast<CostAwareLFUBlock*>(other.m_blocks[i].get()));
+        } else if (block_type == "GDSF") {
+            m_blocks[i] = std::make_unique<GDSFBlock>(*dynamic_cast<GDSFBlock*>(other.m_blocks[i].get()));
         } else {
             throw std::runtime_error("Unknown block type during copy: " + block_type);
         }
@@ -64,6 +77,8 @@ PipelineCache& PipelineCache::operator=(const PipelineCache& other)
     m_num_of_quanta = other.m_num_of_quanta;
 
     m_items = other.m_items;
+    m_values = other.m_values;
+    m_free_values = other.m_free_values;
 
     m_blocks.resize(other.m_blocks.size());
 
@@ -74,8 +89,12 @@ PipelineCache& PipelineCache::operator=(const PipelineCache& other)
             m_blocks[i] = std::make_unique<FIFOBlock>(*dynamic_cast<FIFOBlock*>(other.m_blocks[i].get()));
         } else if (block_type == "ALRU") {
             m_blocks[i] = std::make_unique<ALRUBlock>(*dynamic_cast<ALRUBlock*>(other.m_blocks[i].get()));
+        } else if (block_type == "Clock") {
+            m_blocks[i] = std::make_unique<ClockBlock>(*dynamic_cast<ClockBlock*>(other.m_blocks[i].get()));
         } else if (block_type == "CostAwareLFU") {
             m_blocks[i] = std::make_unique<CostAwareLFUBlock>(*dynamic_cast<CostAwareLFUBlock*>(other.m_blocks[i].get()));
+        } else if (block_type == "GDSF") {
+            m_blocks[i] = std::make_unique<GDSFBlock>(*dynamic_cast<GDSFBlock*>(other.m_blocks[i].get()));
         } else {
             throw std::runtime_error("Unknown block type during copy assignment: " + block_type);
         }
@@ -85,8 +104,11 @@ PipelineCache& PipelineCache::operator=(const PipelineCache& other)
     }
 
     m_quanta_alloc = other.m_quanta_alloc;
+    m_admission = other.m_admission;
+    m_cost_model = other.m_cost_model;
     m_eviction_queue = std::vector<EntryData>();
     m_sketch = other.m_sketch;
+    m_updates_sketch = false;
     m_ops_since_last_aging = 0;
     m_stats = {};
 
@@ -95,41 +117,79 @@ PipelineCache& PipelineCache::operator=(const PipelineCache& other)
     return *this;
 }
 
-const EntryData& PipelineCache::get_item(uint64_t key)
+const EntryValue& PipelineCache::get_item(const HashedKey& key)
 {
     assert(contains(key));
-    const EntryPosition& pos = m_items[key];
-    assert(pos.id == key);
+    const EntryPosition& pos = *m_items.find(key);
+    assert(pos.id == key.id);
 
-    EntryData* item_entry = m_blocks[pos.block_num]->get_entry(pos.idx);
+    if (m_updates_sketch)
+    {
+        m_sketch->add(key);
+    }
+    m_blocks[pos.block_num]->record_access(pos.idx);
+    const CompactEntry* item_entry = m_blocks[pos.block_num]->get_entry(pos.idx);
+    assert(key_of(*item_entry).id == key.id);
 
-    item_entry->last_access_time = utils::get_current_time_in_ms();
-    m_sketch.add(key);
     ++m_ops_since_last_aging;
     age_sketch_if_needed();
     ++m_stats.ops;
 
-    return *item_entry;
+    return m_values[item_entry->value_idx];
 }
 
-void PipelineCache::insert_item(uint64_t key, double latency, uint64_t tokens)
+void PipelineCache::insert_item(const HashedKey& key, double latency, uint64_t tokens)
 {
-    EntryData item{key, latency, tokens};
-    m_sketch.add(key);
+    // Setting a cached key updates it in place and counts as an access.
+    if (const EntryPosition* itr = m_items.find(key); itr != nullptr)
+    {
+        const EntryPosition pos = *itr;
+        CompactEntry* entry = m_blocks[pos.block_num]->get_entry(pos.idx);
+        entry->quantized_cost = CompactEntry::quantize_cost(cost::evaluate(m_cost_model, latency, tokens));
+        m_values[entry->value_idx].latency = latency;
+        m_values[entry->value_idx].tokens = tokens;
+        get_item(key);
+        return;
+    }
+
+    assert(!m_free_values.empty());
+    const uint32_t value_idx = m_free_values.back();
+    m_free_values.pop_back();
+    m_values[value_idx] = EntryValue{key.id, key.hash, latency, tokens, 0, nullptr};
+
+    const double item_cost = cost::evaluate(m_cost_model, latency, tokens);
+    CompactEntry item = CompactEntry::with_cost(key, item_cost, value_idx);
+    if (m_updates_sketch)
+    {
+        m_sketch->add(key);
+    }
     ++m_ops_since_last_aging;
-    m_stats.aggregated_cost += latency * static_cast<double>(tokens);
+    m_stats.aggregated_cost += item_cost;
     ++m_stats.ops;
 
     bool was_item_evicted = true;
+    // The gates only filter entries evicted from a previous block, so the new item enters the first block that has
+    // quanta unconditionally, even when the blocks before it were left empty.
+    bool reached_first_block = false;
     for (size_t idx = 0; idx < m_blocks.size() && was_item_evicted; ++idx)
     {
         if (m_quanta_alloc[idx] > 0)
         {
+            if (reached_first_block && m_admission[idx] != AdmissionPolicy::NONE)
+            {
+                const CompactEntry* victim = m_blocks[idx]->peek_victim();
+                if (victim != nullptr && !admission::should_admit(m_admission[idx], item, *victim, *m_sketch))
+                {
+                    break;
+                }
+            }
+            reached_first_block = true;
+
             if (InsertionResult result = m_blocks[idx]->insert_item(item);
                 result.was_item_inserted)
             {
                 assert(result.replaced_idx < m_blocks[idx]->capacity());
-                m_items.insert_or_assign(item.id, EntryPosition{item.id, idx, result.replaced_idx});
+                m_items.insert_or_assign(key_of(item), idx, result.replaced_idx);
 
                 was_item_evicted = result.removed_entry.has_value();
                 if (was_item_evicted)
@@ -140,11 +200,16 @@ void PipelineCache::insert_item(uint64_t key, double latency, uint64_t tokens)
         }
     }
 
-    if (item.id != key && was_item_evicted)
+    if (item.value_idx != value_idx && was_item_evicted)
     {
-        m_items.erase(item.id);
+        m_items.erase(key_of(item));
 
-        m_eviction_queue.push_back(item);
+        m_eviction_queue.push_back(detach(item));
+    }
+    else if (was_item_evicted)
+    {
+        // The new item was rejected by every block.
+        m_free_values.push_back(value_idx);
     }
 
     validate_sizes();
@@ -152,31 +217,118 @@ void PipelineCache::insert_item(uint64_t key, double latency, uint64_t tokens)
 }
 
 PipelineCache::PipelineCache(bool is_sampled, const std::string& config_path)
+    : PipelineCache(is_sampled, load_config(config_path)) {}
+
+Json PipelineCache::load_config(const std::string& config_path)
+{
+    std::ifstream config_file(config_path);
+    if (!config_file.is_open()) {
+        std::cerr << "ERROR: Failed to open config file: " << config_path << "\n";
+        exit(1);
+    }
+
+    try
+    {
+        return Json::parse(config_file);
+    }
+    catch (const Json::exception& e) {
+        std::cerr << "ERROR: Failed to read cache config: " << e.what() << "\n";
+        exit(1);
+    }
+}
+
+CostModel PipelineCache::parse_cost_model(const Json& config)
+{
+    if (!config.contains("cost"))
+    {
+        return cost::LatencyTokens{};
+    }
+
+    try
+    {
+        const Json& cost_config = config["cost"];
+        const std::string model = cost_config.value("model", cost::LatencyTokens::NAME);
+        CostModel cost_model{};
+        bool has_negative_weight = false;
+        if (model == cost::LatencyTokens::NAME)
+        {
+            cost_model = cost::LatencyTokens{};
+        }
+        else if (model == cost::Latency::NAME)
+        {
+            cost_model = cost::Latency{};
+        }
+        else if (model == cost::Tokens::NAME)
+        {
+            cost_model = cost::Tokens{};
+        }
+        else if (model == cost::Affine::NAME)
+        {
+            const cost::Affine affine{cost_config.value("per_request", 0.0),
+                                      cost_config.value("per_second", 0.0),
+                                      cost_config.value("per_token", 0.0)};
+            has_negative_weight = affine.per_request < 0 || affine.per_second < 0 || affine.per_token < 0;
+            cost_model = affine;
+        }
+        else if (model == cost::Weighted::NAME)
+        {
+            const std::vector<double> weights = cost_config["weights"].get<std::vector<double>>();
+            if (weights.size() != cost::Weighted::NUM_OF_WEIGHTS)
+            {
+                std::cerr << "the weighted cost takes 4 weights, of 1, latency, tokens and latency * tokens" << std::endl;
+                exit(1);
+            }
+            cost::Weighted weighted{};
+            std::copy(weights.begin(), weights.end(), weighted.weights.begin());
+            has_negative_weight = std::any_of(weights.begin(), weights.end(), [](double weight) { return weight < 0; });
+            cost_model = weighted;
+        }
+        else
+        {
+            std::cerr << "Unknown cost model: " << model << std::endl;
+            exit(1);
+        }
+
+        if (has_negative_weight)
+        {
+            std::cerr << "the weights of the cost model must not be negative" << std::endl;
+            exit(1);
+        }
+
+        return cost_model;
+    }
+    catch (const Json::exception& e) {
+        std::cerr << "ERROR: Failed to read cache config: " << e.what() << "\n";
+        exit(1);
+    }
+}
+
+PipelineCache::PipelineCache(bool is_sampled, Json config) : PipelineCache(is_sampled, std::move(config), nullptr) {}
+
+PipelineCache::PipelineCache(bool is_sampled, Json config, std::shared_ptr<CountMinSketch> sketch)
     : m_cache_capacity{0},
       m_quantum_size{0},
       m_items{},
+      m_values{},
+      m_free_values{},
       m_blocks{},
       m_quanta_alloc{},
+      m_admission{},
+      m_cost_model{},
       m_eviction_queue{},
       m_num_of_quanta{0},
       m_sketch{},
+      m_updates_sketch{true},
       m_aging_window_size{0},
       m_ops_since_last_aging{0},
       m_stats{}
 {
-    std::ifstream config_file(config_path);
-    if (!config_file.is_open()) {
-        std::cerr << "ERROR: Failed to open config file: " << config_path << "\n";
-        exit(1);
-    }
-
-    Json config = Json::parse(config_file);
-
     const auto& blocks_config = config["blocks"];
     const size_t num_blocks = blocks_config.size();
 
     m_blocks.resize(num_blocks);
     m_quanta_alloc.resize(num_blocks);
+    m_admission.resize(num_blocks, AdmissionPolicy::NONE);
 
     try
     {
@@ -186,19 +338,20 @@ PipelineCache::PipelineCache(bool is_sampled, const std::string& config_path)
             std::cerr << "num_of_quanta is not a power of 2" << std::endl;
             exit(1);
         }
-        m_cache_capacity = config["cache"]["capacity"].get<uint64_t>();
-        if (!utils::is_power_of_two(m_cache_capacity))
-        {
-            std::cerr << "cache_capacity is not a power of 2" << std::endl;
-            exit(1);
-        }
-        const uint64_t non_sampled_quantum_size = m_cache_capacity / m_num_of_quanta;
         const uint64_t sample_rate = config["cache"]["sample_rate"].get<uint64_t>();
         if (!utils::is_power_of_two(sample_rate))
         {
             std::cerr << "sample_rate is not a power of 2" << std::endl;
             exit(1);
         }
+        // Every quantum, sampled ones included, holds a whole number of entries.
+        m_cache_capacity = config["cache"]["capacity"].get<uint64_t>();
+        if (m_cache_capacity == 0 || m_cache_capacity % (m_num_of_quanta * sample_rate) != 0)
+        {
+            std::cerr << "cache_capacity is not a multiple of num_of_quanta * sample_rate" << std::endl;
+            exit(1);
+        }
+        const uint64_t non_sampled_quantum_size = m_cache_capacity / m_num_of_quanta;
 
         const uint64_t aging_window_multiplier = config["cache"]["aging_window_multiplier"].get<uint64_t>();
         m_aging_window_size = aging_window_multiplier * m_cache_capacity;
@@ -206,13 +359,39 @@ PipelineCache::PipelineCache(bool is_sampled, const std::string& config_path)
         m_quantum_size = !is_sampled
                              ? non_sampled_quantum_size
                              : non_sampled_quantum_size / sample_rate;
+        MemoryPolicy memory_policy{};
+        if (config.contains("memory"))
+        {
+            memory_policy.huge_pages = config["memory"].value("huge_pages", false);
+            memory_policy.numa_node = config["memory"].value("numa_node", -1);
+            if (memory_policy.numa_node >= 0 && !memory::is_numa_node_available(memory_policy.numa_node))
+            {
+                std::cerr << "NUMA node " << memory_policy.numa_node << " is not available on this host" << std::endl;
+                exit(1);
+            }
+        }
+
+        if (m_quantum_size * m_num_of_quanta >= std::numeric_limits<uint32_t>::max())
+        {
+            std::cerr << "cache_capacity must be below 2^32" << std::endl;
+            exit(1);
+        }
+        m_cost_model = parse_cost_model(config);
+        m_items = KeyIndex{m_quantum_size * m_num_of_quanta, memory_policy};
+        // An insertion may briefly hold one entry over the capacity, like the index.
+        m_values = std::vector<EntryValue, memory::PolicyAllocator<EntryValue>>(m_quantum_size * m_num_of_quanta + 1,
+                                                                                 EntryValue{},
+                                                                                 memory::PolicyAllocator<EntryValue>{memory_policy});
+        reset_values();
 
         const uint64_t seed = config["cache"]["seed"].get<uint64_t>();
         const uint64_t sample_size = config["cache"]["sample_size"].get<uint64_t>();
 
         const double sketch_error = config["count_min_sketch"]["error"].get<double>();
         const double sketch_error_probability = config["count_min_sketch"]["probability"].get<double>();
-        m_sketch = CountMinSketch{sketch_error, sketch_error_probability, seed};
+        m_sketch = sketch != nullptr
+                       ? std::move(sketch)
+                       : std::make_shared<CountMinSketch>(sketch_error, sketch_error_probability, seed, memory_policy);
 
         for (size_t i = 0; i < num_blocks; ++i)
         {
@@ -227,9 +406,30 @@ PipelineCache::PipelineCache(bool is_sampled, const std::string& config_path)
                 exit(1);
             }
 
+            const std::string admission_name = block_config.value("admission", "none");
+            const std::optional<AdmissionPolicy> admission_policy = admission::parse_policy(admission_name);
+            if (!admission_policy.has_value())
+            {
+                std::cerr << "ERROR: Unknown admission policy: " << admission_name << "\n";
+                exit(1);
+            }
+            if (i == 0 && *admission_policy != AdmissionPolicy::NONE)
+            {
+                std::cerr << "The admission gate is placed between blocks, the first block cannot have one" << std::endl;
+                exit(1);
+            }
+            m_admission[i] = *admission_policy;
+
+            const uint64_t eviction_pool_size = block_config.value("eviction_pool", 0ULL);
+            if (eviction_pool_size > 0 && block_type != "alru" && block_type != "cost_aware_lfu")
+            {
+                std::cerr << "Only the sampling blocks, alru and cost_aware_lfu, keep an eviction pool" << std::endl;
+                exit(1);
+            }
+
             if (block_type == "fifo")
             {
-                m_blocks[i] = std::make_unique<FIFOBlock>(m_cache_capacity, m_quantum_size, initial_quanta);
+                m_blocks[i] = std::make_unique<FIFOBlock>(m_cache_capacity, m_quantum_size, initial_quanta, memory_policy);
             }
             else if (block_type == "alru")
             {
@@ -237,16 +437,32 @@ PipelineCache::PipelineCache(bool is_sampled, const std::string& config_path)
                                                           m_quantum_size,
                                                           initial_quanta,
                                                           seed,
-                                                          sample_size);
+                                                          sample_size,
+                                                          memory_policy,
+                                                          eviction_pool_size);
+            }
+            else if (block_type == "clock")
+            {
+                m_blocks[i] = std::make_unique<ClockBlock>(m_cache_capacity, m_quantum_size, initial_quanta, memory_policy);
             }
             else if (block_type == "cost_aware_lfu")
             {
                 m_blocks[i] = std::make_unique<CostAwareLFUBlock>(m_cache_capacity,
                                                                   m_quantum_size,
                                                                   initial_quanta,
-                                                                  m_sketch,
+                                                                  *m_sketch,
                                                                   seed,
-                                                                  sample_size);
+                                                                  sample_size,
+                                                                  memory_policy,
+                                                                  eviction_pool_size);
+            }
+            else if (block_type == "gdsf")
+            {
+                m_blocks[i] = std::make_unique<GDSFBlock>(m_cache_capacity,
+                                                          m_quantum_size,
+                                                          initial_quanta,
+                                                          *m_sketch,
+                                                          memory_policy);
             }
             else
             {
@@ -259,17 +475,34 @@ PipelineCache::PipelineCache(bool is_sampled, const std::string& config_path)
         std::cerr << "ERROR: Failed to read cache config: " << e.what() << "\n";
         exit(1);
     }
+}
 
+EntryData PipelineCache::detach(const CompactEntry& entry)
+{
+    m_free_values.push_back(entry.value_idx);
+    return EntryData{entry, m_values[entry.value_idx]};
+}
 
-    config_file.close();
+void PipelineCache::reset_values()
+{
+    m_free_values.resize(m_values.size());
+    // Taken from the back, so the values are handed out in order.
+    for (size_t idx = 0; idx < m_values.size(); ++idx)
+    {
+        m_free_values[idx] = static_cast<uint32_t>(m_values.size() - 1 - idx);
+    }
 }
 
 void PipelineCache::age_sketch_if_needed()
 {
-    if (m_ops_since_last_aging >= m_aging_window_size)
+    if (m_updates_sketch && m_ops_since_last_aging >= m_aging_window_size)
     {
         m_ops_since_last_aging = 0;
-        m_sketch.reduce();
+        m_sketch->reduce();
+        if (m_event_log != nullptr)
+        {
+            m_event_log->log_sketch_aging();
+        }
     }
 }
 
@@ -290,7 +523,50 @@ void PipelineCache::validate_sizes() const
     assert(m_items.size() == num_of_items);
 }
 
-bool PipelineCache::contains(uint64_t key) const 
+EntryValue* PipelineCache::peek_item(const HashedKey& key)
+{
+    const EntryPosition* pos = m_items.find(key);
+    return pos != nullptr ? &m_values[m_blocks[pos->block_num]->get_entry(pos->idx)->value_idx] : nullptr;
+}
+
+void PipelineCache::lookup_batch(std::span<const HashedKey> keys, std::span<EntryValue*> values)
+{
+    assert(keys.size() == values.size());
+    CompactEntry* entries[BATCH_GROUP_SIZE];
+
+    for (size_t group_start = 0; group_start < keys.size(); group_start += BATCH_GROUP_SIZE)
+    {
+        const size_t group_end = std::min(group_start + BATCH_GROUP_SIZE, keys.size());
+        for (size_t idx = group_start; idx < group_end; ++idx)
+        {
+            m_items.prefetch(keys[idx]);
+        }
+
+        for (size_t idx = group_start; idx < group_end; ++idx)
+        {
+            const EntryPosition* pos = m_items.find(keys[idx]);
+            CompactEntry*& entry = entries[idx - group_start];
+            entry = pos != nullptr ? m_blocks[pos->block_num]->get_entry(pos->idx) : nullptr;
+            if (entry != nullptr)
+            {
+                utils::prefetch(entry);
+            }
+            m_sketch->prefetch(keys[idx]);
+        }
+
+        for (size_t idx = group_start; idx < group_end; ++idx)
+        {
+            const CompactEntry* entry = entries[idx - group_start];
+            values[idx] = entry != nullptr ? &m_values[entry->value_idx] : nullptr;
+            if (values[idx] != nullptr)
+            {
+                utils::prefetch(values[idx]);
+            }
+        }
+    }
+}
+
+bool PipelineCache::contains(const HashedKey& key) const 
 {
     return m_items.contains(key);
 }
@@ -303,6 +579,39 @@ EntryData PipelineCache::evict_item()
     return item;
 }
 
+EntryData PipelineCache::erase_item(const HashedKey& key)
+{
+    assert(contains(key));
+    const EntryPosition pos = *m_items.find(key);
+    PipelineBlock& block = *m_blocks[pos.block_num];
+    const EntryData removed_entry = detach(*block.get_entry(pos.idx));
+
+    m_items.erase(key);
+    if (block.remove_item(pos.idx).has_value())
+    {
+        m_items.insert_or_assign(key_of(*block.get_entry(pos.idx)), pos.block_num, pos.idx);
+    }
+
+    validate_sizes();
+
+    return removed_entry;
+}
+
+void PipelineCache::expire_item(const HashedKey& key)
+{
+    m_eviction_queue.push_back(erase_item(key));
+}
+
+size_t PipelineCache::eviction_queue_size() const
+{
+    return m_eviction_queue.size();
+}
+
+EntryData& PipelineCache::evicted_entry(size_t idx)
+{
+    return m_eviction_queue[idx];
+}
+
 bool PipelineCache::should_evict() const
 {
     return !m_eviction_queue.empty();
@@ -310,52 +619,133 @@ bool PipelineCache::should_evict() const
 
 void PipelineCache::move_quantum(uint64_t src_block, uint64_t dest_block)
 {
-    for (const auto & m_block : m_blocks)
-    {
-        m_block->prepare_for_copy();
-    }
+    prepare_for_copy();
     assert(can_adapt(src_block, false) && can_adapt(dest_block, true));
     QuantumMoveResult result = m_blocks[src_block]->move_quanta_to(*m_blocks.at(dest_block));
 
     // Update positions for items that moved to destination block
-    for (const auto& [id, idx] : result.items_moved)
+    for (const auto& [value_idx, idx] : result.items_moved)
     {
-        m_items.insert_or_assign(id, EntryPosition{id, dest_block, idx});
+        m_items.insert_or_assign(key_of(*m_blocks[dest_block]->get_entry(idx)), dest_block, idx);
     }
 
     // Update positions for items that remained in source block (indices may have changed due to rearrangement)
-    for (const auto& [id, idx] : result.items_remaining)
+    for (const auto& [value_idx, idx] : result.items_remaining)
     {
-        m_items.insert_or_assign(id, EntryPosition{id, src_block, idx});
+        m_items.insert_or_assign(key_of(*m_blocks[src_block]->get_entry(idx)), src_block, idx);
     }
 
     --m_quanta_alloc[src_block];
     ++m_quanta_alloc[dest_block];
 }
 
-std::vector<uint64_t> PipelineCache::keys() const 
+void PipelineCache::resize(bool is_sampled, const Json& config)
 {
-    std::vector<uint64_t> res{size()};
-    for (const auto& val : m_items | std::views::values)
+    Json resized_config = config;
+    for (size_t block_num = 0; block_num < m_blocks.size(); ++block_num)
     {
-        res.emplace_back(val.id);
+        resized_config["blocks"][block_num]["initial_quanta"] = m_quanta_alloc[block_num];
     }
 
+    // The sketch is kept, its dimensions only depend on the error and the probability, and a copy keeps sharing it
+    // with the cache it was copied from. Only the aging window follows the new capacity.
+    PipelineCache resized{is_sampled, resized_config, m_sketch};
+    assert(resized.m_blocks.size() == m_blocks.size());
+    resized.m_updates_sketch = m_updates_sketch;
+    resized.m_ops_since_last_aging = m_ops_since_last_aging;
+    resized.m_stats = m_stats;
+    resized.m_eviction_queue = std::move(m_eviction_queue);
+    resized.m_event_log = m_event_log;
+
+    // The entries the blocks would give up first are reinserted first: the FIFO keeps its order, oldest first,
+    // the other blocks replay their entries by last access.
+    prepare_for_copy();
+    for (size_t block_num = 0; block_num < m_blocks.size(); ++block_num)
+    {
+        PipelineBlock& block = *m_blocks[block_num];
+        std::vector<CompactEntry> entries;
+        entries.reserve(block.size());
+        for (uint64_t idx = 0; idx < block.size(); ++idx)
+        {
+            entries.push_back(*block.get_entry(idx));
+        }
+        if (block.get_type() != "FIFO")
+        {
+            std::stable_sort(entries.begin(), entries.end(), [](const CompactEntry& a, const CompactEntry& b) {
+                return a.last_access_time < b.last_access_time;
+            });
+        }
+
+        PipelineBlock& resized_block = *resized.m_blocks[block_num];
+        for (CompactEntry entry : entries)
+        {
+            const EntryValue& value = m_values[entry.value_idx];
+            assert(!resized.m_free_values.empty());
+            entry.value_idx = resized.m_free_values.back();
+            resized.m_free_values.pop_back();
+            resized.m_values[entry.value_idx] = value;
+
+            InsertionResult result = resized_block.insert_item(entry);
+            if (!result.was_item_inserted)
+            {
+                resized.m_eviction_queue.push_back(resized.detach(entry));
+                continue;
+            }
+
+            resized.m_items.insert_or_assign(resized.key_of(entry), block_num, result.replaced_idx);
+            if (result.removed_entry.has_value())
+            {
+                resized.m_items.erase(resized.key_of(*result.removed_entry));
+                resized.m_eviction_queue.push_back(resized.detach(*result.removed_entry));
+            }
+        }
+    }
+
+    *this = std::move(resized);
+    validate_sizes();
+}
+
+std::vector<uint64_t> PipelineCache::keys() const 
+{
+    std::vector<uint64_t> res;
+    res.reserve(size());
+    m_items.for_each([&res](const EntryPosition& pos) {
+        res.emplace_back(pos.id);
+    });
+
     return res;
 }
 
 std::vector<std::tuple<double, uint64_t>> PipelineCache::values() const
 {
-    std::vector<std::tuple<double, uint64_t>> res{size()};
-    for (const auto& val : m_items | std::views::values)
-    {
-        const EntryData* data = m_blocks[val.block_num]->get_entry(val.idx);
-        res.emplace_back(data->latency, data->tokens);
-    }
+    std::vector<std::tuple<double, uint64_t>> res;
+    res.reserve(size());
+    m_items.for_each([this, &res](const EntryPosition& pos) {
+        const EntryValue& value = m_values[m_blocks[pos.block_num]->get_entry(pos.idx)->value_idx];
+        res.emplace_back(value.latency, value.tokens);
+    });
 
     return res;
 }
 
+void PipelineCache::collect_payloads(std::vector<void*>& payloads) const
+{
+    m_items.for_each([this, &payloads](const EntryPosition& pos) {
+        if (void* payload = m_values[m_blocks[pos.block_num]->get_entry(pos.idx)->value_idx].payload; payload != nullptr)
+        {
+            payloads.push_back(payload);
+        }
+    });
+
+    for (const EntryData& entry : m_eviction_queue)
+    {
+        if (entry.payload != nullptr)
+        {
+            payloads.push_back(entry.payload);
+        }
+    }
+}
+
 size_t PipelineCache::capacity() const 
 {
     return m_cache_capacity;
@@ -384,6 +774,8 @@ void PipelineCache::clear()
     {
         m_block->clear();
     }
+    m_items.clear();
+    reset_values();
 }
 
 bool PipelineCache::can_adapt(uint64_t block_num, bool increase) const 
@@ -409,6 +801,7 @@ std::string PipelineCache::get_current_config() const
 }
 
 double PipelineCache::get_timeframe_aggregated_cost() const { return m_stats.get_average_cost(); }
+double PipelineCache::get_timeframe_total_cost() const { return m_stats.aggregated_cost; }
 void PipelineCache::reset_timeframe_stats() { m_stats.reset(); }
 
 void PipelineCache::prepare_for_copy()
@@ -417,6 +810,16 @@ void PipelineCache::prepare_for_copy()
     {
         block->prepare_for_copy();
     }
+
+    // Blocks may reorder their entries while preparing, so the positions have to be refreshed.
+    for (uint64_t block_num = 0; block_num < m_blocks.size(); ++block_num)
+    {
+        const uint64_t block_size = m_blocks[block_num]->size();
+        for (uint64_t idx = 0; idx < block_size; ++idx)
+        {
+            m_items.insert_or_assign(key_of(*m_blocks[block_num]->get_entry(idx)), block_num, idx);
+        }
+    }
 }
 
 
@@ -427,6 +830,11 @@ PipelineCacheProxy::PipelineCacheProxy(const std::string& config_path)
                   m_cache{true, config_path},
                   is_in_dummy_mode{false} {}
 
+PipelineCacheProxy::PipelineCacheProxy(Json config)
+                : IPipelineCache(),
+                  m_cache{true, std::move(config)},
+                  is_in_dummy_mode{false} {}
+
 PipelineCacheProxy::PipelineCacheProxy(const PipelineCacheProxy& other)
                 : m_cache{other.m_cache},
                   is_in_dummy_mode{false} {}
@@ -438,13 +846,13 @@ PipelineCacheProxy& PipelineCacheProxy::operator=(const PipelineCacheProxy& othe
     return *this;
 }
 
-const EntryData& PipelineCacheProxy::get_item(uint64_t key) 
+const EntryValue& PipelineCacheProxy::get_item(const HashedKey& key) 
 {
-    static EntryData dummy;
+    static EntryValue dummy{};
     return is_in_dummy_mode ? dummy : m_cache.get_item(key);
 }
 
-void PipelineCacheProxy::insert_item(uint64_t key, double latency, uint64_t tokens) 
+void PipelineCacheProxy::insert_item(const HashedKey& key, double latency, uint64_t tokens) 
 {
     if (!is_in_dummy_mode)
     {
@@ -452,7 +860,7 @@ void PipelineCacheProxy::insert_item(uint64_t key, double latency, uint64_t toke
     }
 }
 
-bool PipelineCacheProxy::contains(uint64_t key) const 
+bool PipelineCacheProxy::contains(const HashedKey& key) const 
 {
     return is_in_dummy_mode ? false : m_cache.contains(key);
 }
@@ -462,6 +870,11 @@ EntryData PipelineCacheProxy::evict_item()
     return is_in_dummy_mode ? EntryData() : m_cache.evict_item();
 }
 
+EntryData PipelineCacheProxy::erase_item(const HashedKey& key)
+{
+    return is_in_dummy_mode ? EntryData() : m_cache.erase_item(key);
+}
+
 bool PipelineCacheProxy::should_evict() const
 {
     return !is_in_dummy_mode && m_cache.should_evict();
@@ -475,6 +888,11 @@ void PipelineCacheProxy::move_quantum(uint64_t src_block, uint64_t dest_block)
     }
 }
 
+void PipelineCacheProxy::resize(const Json& config)
+{
+    m_cache.resize(true, config);
+}
+
 std::vector<uint64_t> PipelineCacheProxy::keys() const 
 {
     return is_in_dummy_mode ? std::vector<uint64_t>{} : m_cache.keys();
@@ -518,6 +936,11 @@ double PipelineCacheProxy::get_timeframe_aggregated_cost() const
     return is_in_dummy_mode ? std::numeric_limits<double>::max() : m_cache.get_timeframe_aggregated_cost();
 }
 
+double PipelineCacheProxy::get_timeframe_total_cost() const
+{
+    return is_in_dummy_mode ? std::numeric_limits<double>::max() : m_cache.get_timeframe_total_cost();
+}
+
 void PipelineCacheProxy::reset_timeframe_stats() 
 {
     if (!is_in_dummy_mode)
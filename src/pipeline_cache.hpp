@@ -1,28 +1,29 @@
 #pragma once
 #include <cassert>
 #include <cstdint>
-#include <unordered_map>
 #include <string>
 #include <memory>
 #include <vector>
+#include <span>
+
+#include <nlohmann/json_fwd.hpp>
 
 #include "count_min_sketch.hpp"
 #include "pipeline_block.hpp"
+#include "admission_gate.hpp"
+#include "key_index.hpp"
+#include "cost_model.hpp"
 
-
-struct EntryPosition {
-    uint64_t id;
-    uint64_t block_num;
-    uint64_t idx;
-};
+class EventLog;
 
 class IPipelineCache {
 public:
     virtual ~IPipelineCache();
-    virtual const EntryData& get_item(uint64_t key) = 0;
-    virtual void insert_item(uint64_t key, double latency, uint64_t tokens) = 0;
-    [[nodiscard]] virtual bool contains(uint64_t key) const = 0;
+    virtual const EntryValue& get_item(const HashedKey& key) = 0;
+    virtual void insert_item(const HashedKey& key, double latency, uint64_t tokens) = 0;
+    [[nodiscard]] virtual bool contains(const HashedKey& key) const = 0;
     virtual EntryData evict_item() = 0;
+    virtual EntryData erase_item(const HashedKey& key) = 0;
     [[nodiscard]] virtual bool should_evict() const = 0;
     virtual void move_quantum(uint64_t src_block, uint64_t dest_block) = 0;
 
@@ -58,48 +59,97 @@ private:
     };
 
     void age_sketch_if_needed();
+    [[nodiscard]] HashedKey key_of(const CompactEntry& entry) const { return m_values[entry.value_idx].key(); }
+    // Builds the whole entry of a compact one that leaves the cache, and frees its value.
+    EntryData detach(const CompactEntry& entry);
+    void reset_values();
 
     uint64_t m_cache_capacity;
     uint64_t m_quantum_size;
-    std::unordered_map<uint64_t, EntryPosition> m_items;
+    KeyIndex m_items;
+    std::vector<EntryValue, memory::PolicyAllocator<EntryValue>> m_values;  // indexed by CompactEntry::value_idx
+    std::vector<uint32_t> m_free_values;
     std::vector<std::unique_ptr<PipelineBlock>> m_blocks;
     std::vector<uint64_t> m_quanta_alloc;
+    std::vector<AdmissionPolicy> m_admission;  // gate in front of each block, for entries evicted by the previous one
+    CostModel m_cost_model;
     std::vector<EntryData> m_eviction_queue;
     uint64_t m_num_of_quanta;
-    CountMinSketch m_sketch;
+    // A copy shares the sketch of the cache it was copied from, as the ghost caches share the one of the sampled
+    // cache: they all see the same sampled stream, so only the cache that created the sketch adds to and ages it,
+    // before the ghosts simulate the same operation.
+    std::shared_ptr<CountMinSketch> m_sketch;
+    bool m_updates_sketch;
     uint64_t m_aging_window_size = 0;
     uint64_t m_ops_since_last_aging = 0;
     TimeframeStats m_stats;
+    EventLog* m_event_log = nullptr;  // not owned, only set on the main cache, never on its copies
 
 public:
     PipelineCache();
     explicit PipelineCache(const std::string& config_path);
     explicit PipelineCache(bool is_sampled, const std::string& config_path);
+    // Builds the cache from an already parsed config, e.g. one of the configs of a sweep.
+    PipelineCache(bool is_sampled, nlohmann::json config);
     PipelineCache(const PipelineCache& other);
     PipelineCache& operator=(const PipelineCache& other);
-
-    const EntryData& get_item(uint64_t key) override;
-    void insert_item(uint64_t key, double latency, uint64_t tokens) override;
-    bool contains(uint64_t key) const override;
+    PipelineCache& operator=(PipelineCache&& other) noexcept = default;
+
+    const EntryValue& get_item(const HashedKey& key) override;
+    // Unlike get_item, does not count as an access. Returns nullptr if the key isn't cached.
+    EntryValue* peek_item(const HashedKey& key);
+    static constexpr size_t BATCH_GROUP_SIZE = 16;
+    // peek_item for a batch of keys, resolved in groups: the index slots of a group are prefetched first,
+    // then the entries and the sketch counters of its keys, then their values, so the misses of a group overlap
+    // instead of being taken one after the other. The following get_item / insert_item calls then find them in cache.
+    // Callers that handle each key right after it is resolved pass one group of BATCH_GROUP_SIZE keys at a time.
+    void lookup_batch(std::span<const HashedKey> keys, std::span<EntryValue*> values);
+    void insert_item(const HashedKey& key, double latency, uint64_t tokens) override;
+    bool contains(const HashedKey& key) const override;
     EntryData evict_item() override;
+    EntryData erase_item(const HashedKey& key) override;
+    // Erases the entry and queues it for eviction, as if the policies had evicted it.
+    void expire_item(const HashedKey& key);
     bool should_evict() const override;
+    // The entries waiting to be popped by evict_item, the last one is popped first.
+    size_t eviction_queue_size() const;
+    EntryData& evicted_entry(size_t idx);
     void move_quantum(uint64_t src_block, uint64_t dest_block) override;
+    // Rebuilds the cache for the capacity of the config, keeping the quanta of every block, the sketch counters and
+    // the cached entries. Each block reinserts its own entries, so a shrunk block evicts through its policy,
+    // and the evicted entries join the eviction queue.
+    void resize(bool is_sampled, const nlohmann::json& config);
 
     std::vector<uint64_t> keys() const override;
     std::vector<std::tuple<double, uint64_t>> values() const override;
+    // Appends the payloads of the cached entries and of the entries waiting to be popped.
+    void collect_payloads(std::vector<void*>& payloads) const;
     size_t capacity() const override;
     size_t size() const override;
     bool empty() const override;
     void clear() override;
     bool can_adapt(uint64_t block_num, bool increase) const override;
     double get_timeframe_aggregated_cost() const override;
+    // The cost of the misses since the timeframe started, get_timeframe_aggregated_cost averages it per operation.
+    double get_timeframe_total_cost() const;
     void reset_timeframe_stats() override;
 
     void prepare_for_copy() override;
 
     std::string get_current_config() const;
+    [[nodiscard]] const std::vector<uint64_t>& quanta_alloc() const { return m_quanta_alloc; }
+    // Logs every aging of the sketch to the event log, nullptr stops logging.
+    void set_event_log(EventLog* event_log) { m_event_log = event_log; }
+
+    // Parses the config file, exits on a missing or malformed file like the other config errors.
+    static nlohmann::json load_config(const std::string& config_path);
+    // The model of the config's "cost" section, latency * tokens without one. Exits on an invalid model.
+    static CostModel parse_cost_model(const nlohmann::json& config);
+    [[nodiscard]] const CostModel& cost_model() const { return m_cost_model; }
 
 private:
+    // Builds the blocks over the given sketch instead of a new one, e.g. the one of the cache being resized.
+    PipelineCache(bool is_sampled, nlohmann::json config, std::shared_ptr<CountMinSketch> sketch);
     void validate_sizes() const;
 };
 
@@ -110,15 +160,18 @@ private:
 public:
     PipelineCacheProxy();
     explicit PipelineCacheProxy(const std::string& config_path);
+    explicit PipelineCacheProxy(nlohmann::json config);
     PipelineCacheProxy(const PipelineCacheProxy& other);
     PipelineCacheProxy& operator=(const PipelineCacheProxy& other);
 
-    const EntryData& get_item(uint64_t key) override;
-    void insert_item(uint64_t key, double latency, uint64_t tokens) override;
-    bool contains(uint64_t key) const override;
+    const EntryValue& get_item(const HashedKey& key) override;
+    void insert_item(const HashedKey& key, double latency, uint64_t tokens) override;
+    bool contains(const HashedKey& key) const override;
     EntryData evict_item() override;
+    EntryData erase_item(const HashedKey& key) override;
     bool should_evict() const override;
     void move_quantum(uint64_t src_block, uint64_t dest_block) override;
+    void resize(const nlohmann::json& config);
     std::vector<uint64_t> keys() const override;
     std::vector<std::tuple<double, uint64_t>> values() const override;
     size_t capacity() const override;
@@ -127,8 +180,10 @@ public:
     void clear() override;
     bool can_adapt(uint64_t block_num, bool increase) const override;
     double get_timeframe_aggregated_cost() const override;
+    double get_timeframe_total_cost() const;
     void reset_timeframe_stats() override;
     void prepare_for_copy() override;
     void make_dummy();
     void make_non_dummy();
+    [[nodiscard]] const std::vector<uint64_t>& quanta_alloc() const { return m_cache.quanta_alloc(); }
 };
@@ -0,0 +1,324 @@
+#include <cstdint>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <limits>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "shared_tier.hpp"
+
+namespace {
+    constexpr uint64_t SHARED_TIER_MAGIC = 0x5049504543414348ULL;  // "PIPECACH"
+    constexpr uint32_t MAX_HITS = 255;
+    constexpr int ATTACH_ATTEMPTS = 1000;
+}
+
+struct SharedTier::SharedRecord
+{
+    uint64_t id;
+    uint64_t digest;
+    double latency;
+    uint64_t tokens;
+    uint64_t deadline_ms;
+    uint32_t hits;
+    uint32_t occupied;
+};
+
+#ifndef _WIN32
+struct SharedTier::Header
+{
+    uint64_t magic;
+    uint64_t num_of_sets;
+    uint64_t size;
+    std::atomic<uint64_t> ready;
+    pthread_mutex_t lock;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shared tier needs lock-free atomics");
+
+SharedTier::SharedTier(const std::string& name, uint64_t capacity) : m_name{name},
+                                                                     m_capacity{0},
+                                                                     m_num_of_sets{0},
+                                                                     m_segment_size{0},
+                                                                     m_header{nullptr},
+                                                                     m_records{nullptr}
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("The shared tier capacity must be positive");
+    }
+
+    m_num_of_sets = (capacity + WAYS - 1) / WAYS;
+    m_capacity = m_num_of_sets * WAYS;
+    m_segment_size = sizeof(Header) + m_capacity * sizeof(SharedRecord);
+
+    bool is_creator = true;
+    int fd = shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0 && errno == EEXIST)
+    {
+        is_creator = false;
+        fd = shm_open(m_name.c_str(), O_RDWR, 0600);
+    }
+    if (fd < 0)
+    {
+        throw std::runtime_error("Could not open the shared memory segment " + m_name);
+    }
+
+    if (is_creator)
+    {
+        if (ftruncate(fd, static_cast<off_t>(m_segment_size)) != 0)
+        {
+            close(fd);
+            shm_unlink(m_name.c_str());
+            throw std::runtime_error("Could not resize the shared memory segment " + m_name);
+        }
+    }
+    else
+    {
+        // The creator sizes the segment right after creating it.
+        struct stat st{};
+        int attempt = 0;
+        while (fstat(fd, &st) == 0 && st.st_size == 0 && ++attempt < ATTACH_ATTEMPTS)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (static_cast<uint64_t>(st.st_size) != m_segment_size)
+        {
+            close(fd);
+            throw std::runtime_error("The shared memory segment " + m_name + " was created with a different capacity");
+        }
+    }
+
+    void* addr = mmap(nullptr, m_segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        throw std::runtime_error("Could not map the shared memory segment " + m_name);
+    }
+
+    m_header = static_cast<Header*>(addr);
+    m_records = reinterpret_cast<SharedRecord*>(static_cast<char*>(addr) + sizeof(Header));
+
+    if (is_creator)
+    {
+        // A fresh segment is zero-filled, so every record starts unoccupied.
+        m_header->magic = SHARED_TIER_MAGIC;
+        m_header->num_of_sets = m_num_of_sets;
+        m_header->size = 0;
+
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&m_header->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+
+        m_header->ready.store(1, std::memory_order_release);
+    }
+    else
+    {
+        int attempt = 0;
+        while (m_header->ready.load(std::memory_order_acquire) == 0 && ++attempt < ATTACH_ATTEMPTS)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (m_header->ready.load(std::memory_order_acquire) == 0
+            || m_header->magic != SHARED_TIER_MAGIC
+            || m_header->num_of_sets != m_num_of_sets)
+        {
+            munmap(addr, m_segment_size);
+            throw std::runtime_error("The shared memory segment " + m_name + " is not a compatible shared tier");
+        }
+    }
+}
+
+SharedTier::~SharedTier()
+{
+    munmap(m_header, m_segment_size);
+}
+
+void SharedTier::remove(const std::string& name)
+{
+    shm_unlink(name.c_str());
+}
+
+void SharedTier::lock()
+{
+    const int rc = pthread_mutex_lock(&m_header->lock);
+    if (rc == EOWNERDEAD)
+    {
+        // The owner died mid-update, at worst a single record is stale.
+        pthread_mutex_consistent(&m_header->lock);
+    }
+    else if (rc != 0)
+    {
+        throw std::runtime_error("Could not lock the shared memory segment " + m_name);
+    }
+}
+
+void SharedTier::unlock()
+{
+    pthread_mutex_unlock(&m_header->lock);
+}
+#else
+struct SharedTier::Header
+{
+};
+
+SharedTier::SharedTier(const std::string& name, uint64_t capacity) : m_name{name},
+                                                                     m_capacity{capacity},
+                                                                     m_num_of_sets{0},
+                                                                     m_segment_size{0},
+                                                                     m_header{nullptr},
+                                                                     m_records{nullptr}
+{
+    throw std::runtime_error("The shared tier requires POSIX shared memory");
+}
+
+SharedTier::~SharedTier() = default;
+
+void SharedTier::remove(const std::string&) {}
+void SharedTier::lock() {}
+void SharedTier::unlock() {}
+#endif
+
+SharedTier::SharedRecord* SharedTier::find_record(const HashedKey& key)
+{
+    SharedRecord* const ways = m_records + (key.hash % m_num_of_sets) * WAYS;
+    for (uint64_t way = 0; way < WAYS; ++way)
+    {
+        if (ways[way].occupied && ways[way].id == key.id)
+        {
+            return &ways[way];
+        }
+    }
+
+    return nullptr;
+}
+
+SharedTier::SharedRecord& SharedTier::select_victim(uint64_t set, uint64_t now_ms)
+{
+    SharedRecord* const ways = m_records + set * WAYS;
+    SharedRecord* victim = &ways[0];
+    double lowest_score = std::numeric_limits<double>::max();
+    for (uint64_t way = 0; way < WAYS; ++way)
+    {
+        SharedRecord& record = ways[way];
+        if (!record.occupied || (record.deadline_ms != 0 && record.deadline_ms <= now_ms))
+        {
+            return record;
+        }
+
+        const double score = record.hits * record.latency * static_cast<double>(record.tokens);
+        if (score < lowest_score)
+        {
+            lowest_score = score;
+            victim = &record;
+        }
+    }
+
+    return *victim;
+}
+
+void SharedTier::put(const EntryData& entry, uint64_t deadline_ms)
+{
+    lock();
+    SharedRecord* record = find_record(entry.key());
+    uint32_t hits = 1;
+    if (record != nullptr)
+    {
+        hits = record->hits;
+    }
+    else
+    {
+        record = &select_victim(entry.hash % m_num_of_sets, utils::get_current_time_in_ms());
+        if (!record->occupied)
+        {
+            ++m_header->size;
+        }
+    }
+
+    *record = SharedRecord{entry.id, entry.digest, entry.latency, entry.tokens, deadline_ms, hits, 1};
+    unlock();
+}
+
+std::optional<SharedTier::Record> SharedTier::get(const HashedKey& key, uint64_t now_ms)
+{
+    lock();
+    SharedRecord* record = find_record(key);
+    if (record == nullptr)
+    {
+        unlock();
+        return std::nullopt;
+    }
+
+    if (record->deadline_ms != 0 && record->deadline_ms <= now_ms)
+    {
+        record->occupied = 0;
+        --m_header->size;
+        unlock();
+        return std::nullopt;
+    }
+
+    if (++record->hits == MAX_HITS)
+    {
+        SharedRecord* const ways = m_records + (record - m_records) / WAYS * WAYS;
+        for (uint64_t way = 0; way < WAYS; ++way)
+        {
+            ways[way].hits /= 2;
+        }
+    }
+
+    EntryData entry{key, record->latency, record->tokens};
+    entry.digest = record->digest;
+    const Record res{entry, record->deadline_ms};
+    unlock();
+
+    return res;
+}
+
+void SharedTier::erase(const HashedKey& key)
+{
+    lock();
+    if (SharedRecord* record = find_record(key); record != nullptr)
+    {
+        record->occupied = 0;
+        --m_header->size;
+    }
+    unlock();
+}
+
+uint64_t SharedTier::size()
+{
+    lock();
+    const uint64_t size = m_header->size;
+    unlock();
+
+    return size;
+}
+
+uint64_t SharedTier::capacity() const
+{
+    return m_capacity;
+}
+
+void SharedTier::clear()
+{
+    lock();
+    for (uint64_t idx = 0; idx < m_capacity; ++idx)
+    {
+        m_records[idx].occupied = 0;
+    }
+    m_header->size = 0;
+    unlock();
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <optional>
+
+#include "pipeline_block.hpp"
+
+// Host-wide tier shared by every process that opens the same POSIX shared-memory segment, e.g. the
+// pre-forked workers of a service, so an entry set by one worker is a hit for all of them.
+// The segment holds a set-associative table of fixed-size records, guarded by a process-shared robust mutex:
+// a worker dying while holding it does not block the others. Within a full set, the entry with the lowest
+// hits * latency * tokens is replaced, hits being halved for the whole set whenever one of them saturates.
+// Records carry an absolute deadline in wall-clock milliseconds, which every process reads the same way.
+// The set of a key is picked from its hash, the one carried by the entry or the HashedKey.
+// The segment outlives the processes, it is created by the first one and removed with SharedTier::remove.
+class SharedTier {
+public:
+    struct Record
+    {
+        EntryData entry;
+        uint64_t deadline_ms;  // 0 when the entry doesn't expire
+    };
+
+private:
+    struct SharedRecord;
+    struct Header;
+
+    constexpr static uint64_t WAYS = 8;
+
+    std::string m_name;
+    uint64_t m_capacity;
+    uint64_t m_num_of_sets;
+    uint64_t m_segment_size;
+    Header* m_header;
+    SharedRecord* m_records;
+
+    void lock();
+    void unlock();
+    SharedRecord* find_record(const HashedKey& key);
+    SharedRecord& select_victim(uint64_t set, uint64_t now_ms);
+
+public:
+    SharedTier(const std::string& name, uint64_t capacity);
+    ~SharedTier();
+
+    SharedTier(const SharedTier&) = delete;
+    SharedTier& operator=(const SharedTier&) = delete;
+
+    // Unlinks the segment, processes that already mapped it keep using it.
+    static void remove(const std::string& name);
+
+    void put(const EntryData& entry, uint64_t deadline_ms);
+    // An expired record is dropped and reported as missing.
+    [[nodiscard]] std::optional<Record> get(const HashedKey& key, uint64_t now_ms);
+    void erase(const HashedKey& key);
+
+    [[nodiscard]] uint64_t size();
+    [[nodiscard]] uint64_t capacity() const;
+    void clear();
+};
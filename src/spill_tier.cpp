@@ -0,0 +1,177 @@
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "spill_tier.hpp"
+
+SpillTier::SpillTier(const std::string& path, uint64_t capacity) : m_path{path},
+                                                                   m_capacity{capacity},
+                                                                   m_head{0},
+                                                                   m_records{nullptr},
+                                                                   m_index{}
+{
+    if (capacity == 0)
+    {
+        throw std::invalid_argument("The spill capacity must be positive");
+    }
+
+    m_index.reserve(capacity);
+    map_file();
+}
+
+SpillTier::~SpillTier()
+{
+    unmap_file();
+}
+
+#ifdef _WIN32
+void SpillTier::map_file()
+{
+    const uint64_t file_size = m_capacity * sizeof(SpillRecord);
+
+    m_file_handle = CreateFileA(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr,
+                                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file_handle == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Could not create the spill file " + m_path);
+    }
+
+    m_mapping_handle = CreateFileMappingA(m_file_handle, nullptr, PAGE_READWRITE,
+                                          static_cast<DWORD>(file_size >> 32),
+                                          static_cast<DWORD>(file_size & 0xFFFFFFFFULL), nullptr);
+    if (m_mapping_handle == nullptr)
+    {
+        CloseHandle(m_file_handle);
+        throw std::runtime_error("Could not map the spill file " + m_path);
+    }
+
+    m_records = static_cast<SpillRecord*>(MapViewOfFile(m_mapping_handle, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (m_records == nullptr)
+    {
+        CloseHandle(m_mapping_handle);
+        CloseHandle(m_file_handle);
+        throw std::runtime_error("Could not map the spill file " + m_path);
+    }
+}
+
+void SpillTier::unmap_file()
+{
+    UnmapViewOfFile(m_records);
+    CloseHandle(m_mapping_handle);
+    CloseHandle(m_file_handle);
+}
+#else
+void SpillTier::map_file()
+{
+    const uint64_t file_size = m_capacity * sizeof(SpillRecord);
+
+    m_fd = open(m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (m_fd < 0)
+    {
+        throw std::runtime_error("Could not create the spill file " + m_path);
+    }
+
+    if (ftruncate(m_fd, static_cast<off_t>(file_size)) != 0)
+    {
+        close(m_fd);
+        throw std::runtime_error("Could not resize the spill file " + m_path);
+    }
+
+    void* addr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (addr == MAP_FAILED)
+    {
+        close(m_fd);
+        throw std::runtime_error("Could not map the spill file " + m_path);
+    }
+
+    m_records = static_cast<SpillRecord*>(addr);
+}
+
+void SpillTier::unmap_file()
+{
+    munmap(m_records, m_capacity * sizeof(SpillRecord));
+    close(m_fd);
+}
+#endif
+
+void SpillTier::put(const EntryData& entry)
+{
+    // An older record of the same key is left dead in the log.
+    m_index.erase(entry.id);
+
+    // The slot under the head holds the oldest record, drop it from the index if it is still live.
+    const SpillRecord& oldest = m_records[m_head];
+    if (const auto itr = m_index.find(oldest.id); itr != m_index.end() && itr->second == m_head)
+    {
+        m_index.erase(itr);
+    }
+
+    m_records[m_head] = SpillRecord{entry.id, entry.latency, entry.tokens, entry.digest};
+    m_index[entry.id] = m_head;
+    m_head = m_head + 1 < m_capacity ? m_head + 1 : 0;
+}
+
+std::optional<EntryData> SpillTier::take(uint64_t id)
+{
+    std::optional<EntryData> entry = peek(id);
+    if (entry.has_value())
+    {
+        m_index.erase(id);
+    }
+
+    return entry;
+}
+
+std::optional<EntryData> SpillTier::peek(uint64_t id) const
+{
+    const auto itr = m_index.find(id);
+    if (itr == m_index.end())
+    {
+        return std::nullopt;
+    }
+
+    const SpillRecord& record = m_records[itr->second];
+    EntryData entry{record.id, record.latency, record.tokens};
+    entry.digest = record.digest;
+    return entry;
+}
+
+void SpillTier::erase(uint64_t id)
+{
+    m_index.erase(id);
+}
+
+bool SpillTier::contains(uint64_t id) const
+{
+    return m_index.contains(id);
+}
+
+uint64_t SpillTier::size() const
+{
+    return m_index.size();
+}
+
+uint64_t SpillTier::capacity() const
+{
+    return m_capacity;
+}
+
+void SpillTier::clear()
+{
+    m_index.clear();
+    m_head = 0;
+}
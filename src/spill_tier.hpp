@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <optional>
+#include <unordered_map>
+
+#include "pipeline_block.hpp"
+
+// Second-tier store for entries evicted from the pipeline, backed by a memory-mapped file.
+// The file is a log of fixed-size records written as a ring, so the tier evicts in FIFO order:
+// every new record overwrites the oldest slot. Taking or erasing an entry only drops it from the
+// in-memory index, its slot stays in the log until the write head reaches it again.
+// The file is recreated on construction, its content does not outlive the cache.
+class SpillTier {
+private:
+    struct SpillRecord
+    {
+        uint64_t id;
+        double latency;
+        uint64_t tokens;
+        uint64_t digest;
+    };
+
+    std::string m_path;
+    uint64_t m_capacity;
+    uint64_t m_head;
+    SpillRecord* m_records;
+    std::unordered_map<uint64_t, uint64_t> m_index;  // id -> slot of its live record
+
+#ifdef _WIN32
+    void* m_file_handle;
+    void* m_mapping_handle;
+#else
+    int m_fd;
+#endif
+
+    void map_file();
+    void unmap_file();
+
+public:
+    SpillTier(const std::string& path, uint64_t capacity);
+    ~SpillTier();
+
+    SpillTier(const SpillTier&) = delete;
+    SpillTier& operator=(const SpillTier&) = delete;
+
+    void put(const EntryData& entry);
+    // Removes the entry from the tier and returns it, used when promoting it back into the pipeline.
+    [[nodiscard]] std::optional<EntryData> take(uint64_t id);
+    // Returns the entry without removing it, e.g. to verify its digest before erasing it.
+    [[nodiscard]] std::optional<EntryData> peek(uint64_t id) const;
+    void erase(uint64_t id);
+    [[nodiscard]] bool contains(uint64_t id) const;
+
+    [[nodiscard]] uint64_t size() const;
+    [[nodiscard]] uint64_t capacity() const;
+    void clear();
+};
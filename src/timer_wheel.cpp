@@ -0,0 +1,180 @@
+#include <cstdint>
+#include <cassert>
+#include <bit>
+#include <limits>
+#include <algorithm>
+
+#include "timer_wheel.hpp"
+
+TimerWheel::TimerWheel(uint64_t start_time_ms) : m_start_time_ms{start_time_ms},
+                                                 m_current_tick{0},
+                                                 m_slots{},
+                                                 m_occupied_slots{},
+                                                 m_deadlines{},
+                                                 m_due{} {}
+
+uint64_t TimerWheel::to_tick(uint64_t time_ms) const
+{
+    return time_ms > m_start_time_ms ? time_ms - m_start_time_ms : 0;
+}
+
+void TimerWheel::place(const TimerEntry& entry)
+{
+    if (entry.deadline_tick <= m_current_tick)
+    {
+        m_due.push_back(entry);
+        return;
+    }
+
+    // The lowest level whose slots, counted from the current one, still reach the deadline.
+    uint64_t level = 0;
+    while (level < LEVELS - 1
+           && (entry.deadline_tick >> (SLOT_BITS * level)) - (m_current_tick >> (SLOT_BITS * level)) >= SLOTS_PER_LEVEL)
+    {
+        ++level;
+    }
+
+    const uint64_t shift = SLOT_BITS * level;
+    uint64_t slot = (entry.deadline_tick >> shift) & (SLOTS_PER_LEVEL - 1);
+    if ((entry.deadline_tick >> shift) - (m_current_tick >> shift) >= SLOTS_PER_LEVEL)
+    {
+        // Beyond the range of the wheel, park it in the furthest slot and re-place it from there.
+        slot = ((m_current_tick >> shift) + SLOTS_PER_LEVEL - 1) & (SLOTS_PER_LEVEL - 1);
+    }
+
+    m_slots[level][slot].push_back(entry);
+    m_occupied_slots[level] |= 1ULL << slot;
+}
+
+uint64_t TimerWheel::next_event_tick() const
+{
+    uint64_t next_tick = std::numeric_limits<uint64_t>::max();
+    for (uint64_t level = 0; level < LEVELS; ++level)
+    {
+        if (m_occupied_slots[level] == 0)
+        {
+            continue;
+        }
+
+        const uint64_t shift = SLOT_BITS * level;
+        const uint64_t current_digit = (m_current_tick >> shift) & (SLOTS_PER_LEVEL - 1);
+        const uint64_t rotated = std::rotr(m_occupied_slots[level], static_cast<int>((current_digit + 1) % SLOTS_PER_LEVEL));
+        const uint64_t delta = static_cast<uint64_t>(std::countr_zero(rotated)) + 1;
+        next_tick = std::min(next_tick, ((m_current_tick >> shift) + delta) << shift);
+    }
+
+    return next_tick;
+}
+
+void TimerWheel::process_tick()
+{
+    // Cascade the slots starting at this tick down, from the top level, then fire the level 0 slot.
+    for (uint64_t level = LEVELS - 1; level > 0; --level)
+    {
+        const uint64_t shift = SLOT_BITS * level;
+        if ((m_current_tick & ((1ULL << shift) - 1)) != 0)
+        {
+            continue;
+        }
+
+        const uint64_t slot = (m_current_tick >> shift) & (SLOTS_PER_LEVEL - 1);
+        if ((m_occupied_slots[level] >> slot) & 1ULL)
+        {
+            std::vector<TimerEntry> entries;
+            entries.swap(m_slots[level][slot]);
+            m_occupied_slots[level] &= ~(1ULL << slot);
+            for (const TimerEntry& entry : entries)
+            {
+                place(entry);
+            }
+        }
+    }
+
+    const uint64_t slot = m_current_tick & (SLOTS_PER_LEVEL - 1);
+    if ((m_occupied_slots[0] >> slot) & 1ULL)
+    {
+        std::vector<TimerEntry>& entries = m_slots[0][slot];
+        m_due.insert(m_due.end(), entries.begin(), entries.end());
+        entries.clear();
+        m_occupied_slots[0] &= ~(1ULL << slot);
+    }
+}
+
+void TimerWheel::advance(uint64_t target_tick)
+{
+    while (true)
+    {
+        const uint64_t next_tick = next_event_tick();
+        if (next_tick > target_tick)
+        {
+            m_current_tick = std::max(m_current_tick, target_tick);
+            return;
+        }
+
+        m_current_tick = next_tick;
+        process_tick();
+    }
+}
+
+void TimerWheel::schedule(uint64_t key, uint64_t deadline_ms)
+{
+    const uint64_t deadline_tick = to_tick(deadline_ms);
+    m_deadlines.insert_or_assign(key, deadline_tick);
+    place(TimerEntry{key, deadline_tick});
+}
+
+void TimerWheel::cancel(uint64_t key)
+{
+    m_deadlines.erase(key);
+}
+
+bool TimerWheel::has_deadline(uint64_t key) const
+{
+    return m_deadlines.contains(key);
+}
+
+bool TimerWheel::is_expired(uint64_t key, uint64_t now_ms) const
+{
+    const auto itr = m_deadlines.find(key);
+    return itr != m_deadlines.end() && itr->second <= to_tick(now_ms);
+}
+
+bool TimerWheel::empty() const
+{
+    return m_deadlines.empty();
+}
+
+void TimerWheel::collect_expired(uint64_t now_ms, uint64_t max_count, std::vector<uint64_t>& expired_keys)
+{
+    advance(to_tick(now_ms));
+
+    uint64_t collected = 0;
+    while (!m_due.empty() && collected < max_count)
+    {
+        const TimerEntry entry = m_due.back();
+        m_due.pop_back();
+
+        // Entries of cancelled or re-scheduled keys are stale, the map holds the live deadline.
+        if (const auto itr = m_deadlines.find(entry.key);
+            itr != m_deadlines.end() && itr->second == entry.deadline_tick)
+        {
+            m_deadlines.erase(itr);
+            expired_keys.push_back(entry.key);
+            ++collected;
+        }
+    }
+}
+
+void TimerWheel::clear()
+{
+    for (auto& level_slots : m_slots)
+    {
+        for (auto& slot : level_slots)
+        {
+            slot.clear();
+        }
+    }
+    m_occupied_slots.fill(0);
+    m_deadlines.clear();
+    m_due.clear();
+}
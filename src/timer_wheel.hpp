@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <unordered_map>
+
+// Hierarchical timing wheel with 1ms ticks, tracking the deadline of every key that has one.
+// Each level has 64 slots, a slot of level L spans 64^L ticks, so 6 levels cover about 2 years
+// (later deadlines park in the last slot of the top level and are re-placed once it is reached).
+// Scheduling and cancelling are O(1); cancelled or re-scheduled keys are dropped lazily when their
+// stale slot entry comes due. Advancing jumps straight to the next occupied slot, so an idle
+// period costs nothing regardless of its length.
+class TimerWheel {
+private:
+    constexpr static uint64_t LEVELS = 6;
+    constexpr static uint64_t SLOT_BITS = 6;
+    constexpr static uint64_t SLOTS_PER_LEVEL = 1ULL << SLOT_BITS;
+
+    struct TimerEntry
+    {
+        uint64_t key;
+        uint64_t deadline_tick;
+    };
+
+    uint64_t m_start_time_ms;
+    uint64_t m_current_tick;
+    std::array<std::array<std::vector<TimerEntry>, SLOTS_PER_LEVEL>, LEVELS> m_slots;
+    std::array<uint64_t, LEVELS> m_occupied_slots;  // a bitmap per level
+    std::unordered_map<uint64_t, uint64_t> m_deadlines;  // key -> deadline tick, the source of truth
+    std::vector<TimerEntry> m_due;
+
+    [[nodiscard]] uint64_t to_tick(uint64_t time_ms) const;
+    void place(const TimerEntry& entry);
+    [[nodiscard]] uint64_t next_event_tick() const;
+    void process_tick();
+    void advance(uint64_t target_tick);
+
+public:
+    explicit TimerWheel(uint64_t start_time_ms);
+
+    void schedule(uint64_t key, uint64_t deadline_ms);
+    void cancel(uint64_t key);
+    [[nodiscard]] bool has_deadline(uint64_t key) const;
+    [[nodiscard]] bool is_expired(uint64_t key, uint64_t now_ms) const;
+    [[nodiscard]] bool empty() const;
+
+    // Appends up to max_count keys whose deadline has passed by now_ms, and stops tracking them.
+    void collect_expired(uint64_t now_ms, uint64_t max_count, std::vector<uint64_t>& expired_keys);
+    void clear();
+};
@@ -0,0 +1,391 @@
+#include <cstdint>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <unordered_map>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "utils.cpp"
+#include "trace_capture.hpp"
+
+namespace {
+    std::atomic<uint64_t> next_capture_id{1};
+
+    std::mutex live_captures_lock;
+    std::vector<TraceCapture*> live_captures;
+    std::once_flag fork_handlers_registered;
+}
+
+TraceCapture::TraceCapture(const std::string& path,
+                           uint64_t max_file_bytes,
+                           uint64_t max_files,
+                           uint64_t flush_interval_ms)
+    : m_id{next_capture_id.fetch_add(1, std::memory_order_relaxed)},
+      m_path{path},
+      m_max_file_bytes{max_file_bytes},
+      m_max_files{max_files},
+      m_flush_interval_ms{flush_interval_ms},
+      m_buffers{},
+      m_pending{},
+      m_stopping{false},
+      m_dropped{0},
+      m_file{nullptr},
+      m_file_bytes{0},
+      m_writer{}
+{
+    // A single file would be truncated by its first rotation, and so would a previous capture.
+    if (max_file_bytes < sizeof(FileHeader) + sizeof(Record) || max_files < 2 || flush_interval_ms == 0)
+    {
+        throw std::invalid_argument("The capture needs room for a record in each file, at least two files "
+                                    "and a positive flush interval");
+    }
+
+    open_first_file();
+    m_writer = std::thread(&TraceCapture::run_writer, this);
+
+    std::call_once(fork_handlers_registered, []() {
+        pthread_atfork(&TraceCapture::prepare_fork, &TraceCapture::resume_parent_after_fork,
+                       &TraceCapture::resume_child_after_fork);
+    });
+    std::lock_guard<std::mutex> guard(live_captures_lock);
+    live_captures.push_back(this);
+}
+
+TraceCapture::~TraceCapture()
+{
+    {
+        std::lock_guard<std::mutex> guard(live_captures_lock);
+        std::erase(live_captures, this);
+    }
+    {
+        std::lock_guard<std::mutex> guard(m_pending_lock);
+        m_stopping = true;
+    }
+    m_pending_cv.notify_one();
+    m_writer.join();
+
+    flush();
+    if (m_file != nullptr)
+    {
+        std::fclose(m_file);
+    }
+}
+
+TraceCapture::Buffer& TraceCapture::local_buffer()
+{
+    // The last buffer used by the thread is checked first, a thread serving a single cache never takes the lock again.
+    thread_local uint64_t last_id = 0;
+    thread_local Buffer* last_buffer = nullptr;
+    thread_local std::unordered_map<uint64_t, Buffer*> buffers;
+
+    if (last_id == m_id)
+    {
+        return *last_buffer;
+    }
+
+    Buffer*& buffer = buffers[m_id];
+    if (buffer == nullptr)
+    {
+        std::lock_guard<std::mutex> guard(m_buffers_lock);
+        buffer = m_buffers.emplace_back(std::make_unique<Buffer>()).get();
+        buffer->records.reserve(BUFFER_RECORDS);
+    }
+    last_id = m_id;
+    last_buffer = buffer;
+
+    return *buffer;
+}
+
+void TraceCapture::record(Op op, uint64_t key, double latency, uint64_t tokens, bool hit)
+{
+    Buffer& buffer = local_buffer();
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    buffer.records.push_back(Record{utils::get_current_time_in_ms(),
+                                    key,
+                                    latency,
+                                    static_cast<uint32_t>(std::min<uint64_t>(tokens, UINT32_MAX)),
+                                    op,
+                                    static_cast<uint8_t>(hit),
+                                    0});
+    if (buffer.records.size() >= BUFFER_RECORDS)
+    {
+        queue(buffer, true);
+        m_pending_cv.notify_one();
+    }
+}
+
+void TraceCapture::queue(Buffer& buffer, bool drop_when_behind)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_pending_lock);
+        if (drop_when_behind && m_pending.size() >= MAX_PENDING_BUFFERS)
+        {
+            m_dropped.fetch_add(buffer.records.size(), std::memory_order_relaxed);
+            buffer.records.clear();
+            return;
+        }
+        m_pending.push_back(std::move(buffer.records));
+    }
+    buffer.records = std::vector<Record>();
+    buffer.records.reserve(BUFFER_RECORDS);
+}
+
+void TraceCapture::open_first_file()
+{
+    if (std::FILE* existing = std::fopen(m_path.c_str(), "rb"); existing != nullptr)
+    {
+        std::fclose(existing);
+        rotate();
+    }
+    else
+    {
+        open_file();
+    }
+}
+
+void TraceCapture::open_file()
+{
+    m_file = std::fopen(m_path.c_str(), "wb");
+    if (m_file == nullptr)
+    {
+        throw std::runtime_error("Failed to open the capture file " + m_path);
+    }
+
+    const FileHeader header{MAGIC, VERSION, static_cast<uint32_t>(sizeof(Record)), {}};
+    std::fwrite(&header, sizeof(header), 1, m_file);
+    m_file_bytes = sizeof(header);
+}
+
+void TraceCapture::rotate()
+{
+    if (m_file != nullptr)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+
+    // path.{max_files - 1} is the oldest file kept, it is overwritten by the one before it.
+    for (uint64_t idx = m_max_files - 1; idx > 0; --idx)
+    {
+        const std::string older = m_path + "." + std::to_string(idx);
+        const std::string newer = idx == 1 ? m_path : m_path + "." + std::to_string(idx - 1);
+        std::remove(older.c_str());
+        std::rename(newer.c_str(), older.c_str());
+    }
+
+    open_file();
+}
+
+void TraceCapture::write_pending(bool include_partial_buffers)
+{
+    // A thread's partial buffer is queued under its lock, after any full buffer it queued before, so its records
+    // keep their order in the file.
+    if (include_partial_buffers)
+    {
+        std::lock_guard<std::mutex> buffers_guard(m_buffers_lock);
+        for (const std::unique_ptr<Buffer>& buffer : m_buffers)
+        {
+            std::lock_guard<std::mutex> guard(buffer->lock);
+            if (!buffer->records.empty())
+            {
+                queue(*buffer, false);
+            }
+        }
+    }
+
+    std::deque<std::vector<Record>> pending;
+    {
+        std::lock_guard<std::mutex> guard(m_pending_lock);
+        pending.swap(m_pending);
+    }
+
+    // Only a forked child that failed to open its own file has none.
+    if (m_file == nullptr)
+    {
+        for (const std::vector<Record>& records : pending)
+        {
+            m_dropped.fetch_add(records.size(), std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    for (const std::vector<Record>& records : pending)
+    {
+        size_t offset = 0;
+        while (offset < records.size())
+        {
+            if (m_file_bytes + sizeof(Record) > m_max_file_bytes)
+            {
+                rotate();
+            }
+            const size_t room = (m_max_file_bytes - m_file_bytes) / sizeof(Record);
+            const size_t count = std::min(records.size() - offset, room);
+            std::fwrite(records.data() + offset, sizeof(Record), count, m_file);
+            m_file_bytes += count * sizeof(Record);
+            offset += count;
+        }
+    }
+
+    std::fflush(m_file);
+}
+
+void TraceCapture::run_writer()
+{
+    std::unique_lock<std::mutex> lock(m_pending_lock);
+    while (!m_stopping)
+    {
+        // Full buffers are written as they are queued, the partly filled ones every flush interval.
+        const bool has_full_buffers = m_pending_cv.wait_for(lock, std::chrono::milliseconds(m_flush_interval_ms),
+                                                            [this]() { return m_stopping || !m_pending.empty(); });
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> write_guard(m_write_lock);
+            write_pending(!has_full_buffers);
+        }
+        lock.lock();
+    }
+}
+
+void TraceCapture::flush()
+{
+    std::lock_guard<std::mutex> guard(m_write_lock);
+    write_pending(true);
+}
+
+void TraceCapture::lock_for_fork()
+{
+    // In the order write_pending() takes them.
+    m_write_lock.lock();
+    m_buffers_lock.lock();
+    for (const std::unique_ptr<Buffer>& buffer : m_buffers)
+    {
+        buffer->lock.lock();
+    }
+    m_pending_lock.lock();
+}
+
+void TraceCapture::unlock_after_fork()
+{
+    m_pending_lock.unlock();
+    for (const std::unique_ptr<Buffer>& buffer : m_buffers)
+    {
+        buffer->lock.unlock();
+    }
+    m_buffers_lock.unlock();
+    m_write_lock.unlock();
+}
+
+void TraceCapture::prepare_fork()
+{
+    live_captures_lock.lock();
+    for (TraceCapture* capture : live_captures)
+    {
+        capture->lock_for_fork();
+    }
+}
+
+void TraceCapture::resume_parent_after_fork()
+{
+    for (TraceCapture* capture : live_captures)
+    {
+        capture->unlock_after_fork();
+    }
+    live_captures_lock.unlock();
+}
+
+void TraceCapture::resume_child_after_fork()
+{
+    for (TraceCapture* capture : live_captures)
+    {
+        capture->restart_in_child();
+        capture->unlock_after_fork();
+    }
+    live_captures_lock.unlock();
+}
+
+void TraceCapture::restart_in_child()
+{
+    // The parent writes what was buffered before the fork. The buffers themselves are kept, the threads of
+    // the child find theirs by address.
+    for (const std::unique_ptr<Buffer>& buffer : m_buffers)
+    {
+        buffer->records.clear();
+    }
+    m_pending.clear();
+    m_dropped.store(0, std::memory_order_relaxed);
+
+    // Every write ends with a flush, so nothing of the parent is left in the file's buffer.
+    if (m_file != nullptr)
+    {
+        std::fclose(m_file);
+        m_file = nullptr;
+    }
+    m_path += "." + std::to_string(getpid());
+    try
+    {
+        open_first_file();
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << ", the forked process doesn't capture its requests" << std::endl;
+    }
+
+    // The parent's writer has no thread in the child, so its handle and the waiters of the condition variable
+    // are dropped rather than joined or destroyed.
+    new (&m_pending_cv) std::condition_variable();
+    new (&m_writer) std::thread(&TraceCapture::run_writer, this);
+}
+
+bool TraceCapture::is_capture_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::array<char, 8> magic{};
+    return file.read(magic.data(), magic.size()) && magic == MAGIC;
+}
+
+std::vector<TraceCapture::Record> TraceCapture::read_file(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open the capture file " + path);
+    }
+
+    std::vector<Record> records;
+    bool has_header = false;
+    std::array<char, sizeof(Record)> chunk{};
+    while (file.read(chunk.data(), chunk.size()))
+    {
+        if (std::equal(MAGIC.begin(), MAGIC.end(), chunk.begin()))
+        {
+            FileHeader header{};
+            std::memcpy(&header, chunk.data(), sizeof(header));
+            if (header.version != VERSION || header.record_size != sizeof(Record))
+            {
+                throw std::runtime_error(path + " holds a capture of another version");
+            }
+            has_header = true;
+            continue;
+        }
+        if (!has_header)
+        {
+            throw std::runtime_error(path + " is not a capture file");
+        }
+
+        Record& record = records.emplace_back();
+        std::memcpy(&record, chunk.data(), sizeof(record));
+    }
+
+    if (file.gcount() != 0)
+    {
+        throw std::runtime_error(path + " ends with a partial record");
+    }
+
+    return records;
+}
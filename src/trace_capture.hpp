@@ -0,0 +1,126 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Capture of the request stream in production, to replay it offline, e.g. with pipeline_sweep.
+// Every thread appends binary records to a buffer of its own, a full buffer is queued to a background thread which
+// writes it and rotates the file: once it reaches max_file_bytes, path is renamed to path.1, path.1 to path.2 and so on,
+// keeping max_files files in total, at least 2. When the writer falls behind, full buffers are dropped rather than
+// queued without bound, and counted.
+class TraceCapture {
+public:
+    enum class Op : uint8_t
+    {
+        LOOKUP,
+        SETITEM
+    };
+
+    // As stored in the file, in the byte order of the host. A lookup miss has no latency and tokens.
+    struct Record
+    {
+        uint64_t time_ms;
+        uint64_t key;
+        double latency;
+        uint32_t tokens;  // saturates at UINT32_MAX
+        Op op;
+        uint8_t hit;
+        uint16_t reserved;
+    };
+
+    static_assert(sizeof(Record) == 32, "two records per cache line");
+
+    // Starts every file, and has the size of a record, so files concatenated in order still read as one trace.
+    struct FileHeader
+    {
+        std::array<char, 8> magic;
+        uint32_t version;
+        uint32_t record_size;
+        std::array<uint64_t, 2> reserved;
+    };
+
+    static_assert(sizeof(FileHeader) == sizeof(Record), "a header takes the place of a record");
+
+    constexpr static std::array<char, 8> MAGIC = {'P', 'C', 'T', 'R', 'A', 'C', 'E', '\0'};
+    constexpr static uint32_t VERSION = 1;
+    constexpr static size_t BUFFER_RECORDS = 1024;
+    constexpr static size_t MAX_PENDING_BUFFERS = 64;
+
+private:
+    struct Buffer
+    {
+        std::mutex lock;  // only contended while the writer collects a partly filled buffer
+        std::vector<Record> records;
+    };
+
+    // Threads find their buffer by this id rather than by the address, which a later instance may reuse.
+    const uint64_t m_id;
+    std::string m_path;
+    const uint64_t m_max_file_bytes;
+    const uint64_t m_max_files;
+    const uint64_t m_flush_interval_ms;
+
+    std::mutex m_buffers_lock;
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+
+    std::mutex m_pending_lock;
+    std::condition_variable m_pending_cv;
+    std::deque<std::vector<Record>> m_pending;
+    bool m_stopping;
+    std::atomic<uint64_t> m_dropped;
+
+    // Guards the file, taken by the writer thread and by flush().
+    std::mutex m_write_lock;
+    std::FILE* m_file;
+    uint64_t m_file_bytes;
+
+    std::thread m_writer;
+
+    Buffer& local_buffer();
+    // Expects the buffer's lock to be held.
+    void queue(Buffer& buffer, bool drop_when_behind);
+    // Writes everything queued, after queueing the partly filled buffers as well if asked to.
+    // Expects the write lock to be held.
+    void write_pending(bool include_partial_buffers);
+    // Rotates an existing capture at m_path out of the way before opening it.
+    void open_first_file();
+    void open_file();
+    void rotate();
+    void run_writer();
+
+    // fork() only copies the thread that called it, so every capture is locked across it, between two writes, and
+    // the child restarts its writer on files of its own, path.<pid>. The records buffered so far are the parent's.
+    static void prepare_fork();
+    static void resume_parent_after_fork();
+    static void resume_child_after_fork();
+    void lock_for_fork();
+    void unlock_after_fork();
+    void restart_in_child();
+
+public:
+    // An existing capture at path is rotated out of the way rather than overwritten.
+    TraceCapture(const std::string& path, uint64_t max_file_bytes, uint64_t max_files, uint64_t flush_interval_ms);
+    ~TraceCapture();
+
+    TraceCapture(const TraceCapture&) = delete;
+    TraceCapture& operator=(const TraceCapture&) = delete;
+
+    void record(Op op, uint64_t key, double latency, uint64_t tokens, bool hit);
+
+    // Writes every record taken so far, including the ones in partly filled buffers.
+    void flush();
+
+    [[nodiscard]] uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Reads a capture file, or several concatenated in order. Throws if it isn't one.
+    [[nodiscard]] static std::vector<Record> read_file(const std::string& path);
+    [[nodiscard]] static bool is_capture_file(const std::string& path);
+};
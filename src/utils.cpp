@@ -3,7 +3,7 @@
 #include <cstdint>
 
 namespace utils {
-    static uint64_t get_current_time_in_ms() {
+    inline uint64_t get_current_time_in_ms() {
         return static_cast<uint64_t>(
             std::chrono::duration_cast<std::chrono::milliseconds>(
                 std::chrono::system_clock::now().time_since_epoch()
@@ -15,4 +15,14 @@ namespace utils {
     {
         return (n > 0) && ((n & (n - 1)) == 0);
     }
+
+    // A read hint for memory that is about to be used, a no-op on compilers without the builtin.
+    inline void prefetch(const void* addr)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(addr, 0, 3);
+#else
+        (void)addr;
+#endif
+    }
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include <cstdint>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "pipeline_cache.hpp"
+#include "test_utils.hpp"
+
+using Json = nlohmann::json;
+
+namespace {
+    constexpr uint64_t CACHE_CAPACITY = 16;
+
+    Json gated_config(uint64_t first_block_quanta) {
+        Json config = cache_config(CACHE_CAPACITY, "fifo", "cost_aware_lfu", first_block_quanta);
+        config["blocks"][1]["admission"] = "frequency";
+        return config;
+    }
+
+    // Fills the cache with keys accessed often enough to beat any new key at the gate.
+    void fill_with_frequent_keys(PipelineCache& cache) {
+        for (uint64_t key = 0; key < CACHE_CAPACITY; ++key) {
+            cache.insert_item(HashedKey{key}, 1.0, 1);
+            for (int access = 0; access < 4; ++access) {
+                cache.get_item(HashedKey{key});
+            }
+        }
+    }
+}
+
+TEST(AdmissionGateTest, RejectsInfrequentEntriesEvictedFromThePreviousBlock) {
+    PipelineCache cache{false, gated_config(2)};
+    fill_with_frequent_keys(cache);
+
+    // The new keys go through the FIFO, and the first ones it evicts lose at the gate.
+    for (uint64_t key = 100; key < 100 + CACHE_CAPACITY; ++key) {
+        cache.insert_item(HashedKey{key}, 1.0, 1);
+    }
+    uint64_t frequent_keys = 0;
+    for (uint64_t key = 0; key < CACHE_CAPACITY; ++key) {
+        frequent_keys += cache.contains(HashedKey{key}) ? 1 : 0;
+    }
+    EXPECT_EQ(frequent_keys, CACHE_CAPACITY / 2);
+}
+
+TEST(AdmissionGateTest, NewItemsSkipTheGateOfTheFirstBlockWithQuanta) {
+    PipelineCache cache{false, gated_config(0)};
+    fill_with_frequent_keys(cache);
+    while (cache.should_evict()) {
+        cache.evict_item();
+    }
+
+    cache.insert_item(HashedKey{1000}, 1.0, 1);
+    EXPECT_TRUE(cache.contains(HashedKey{1000}));
+    EXPECT_EQ(cache.size(), CACHE_CAPACITY);
+    ASSERT_TRUE(cache.should_evict());
+    EXPECT_NE(cache.evict_item().id, 1000);
+}
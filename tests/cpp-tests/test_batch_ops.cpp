@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "adaptive_pipeline_cache.hpp"
+#include "test_utils.hpp"
+
+namespace {
+    std::vector<std::tuple<double, uint64_t>> values_of(const std::vector<uint64_t>& keys) {
+        std::vector<std::tuple<double, uint64_t>> values;
+        for (uint64_t key : keys) {
+            values.emplace_back(1.0, key + 1);
+        }
+        return values;
+    }
+}
+
+// More keys than a prefetch group, half of them cached.
+TEST(BatchOpsTest, FindsTheHitsAndTheMisses) {
+    AdaptivePipelineCache cache{cache_config(64)};
+    std::vector<uint64_t> cached;
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 0; key < 40; ++key) {
+        keys.push_back(key);
+        if (key % 2 == 0) {
+            cached.push_back(key);
+        }
+    }
+    cache.setitem_batch(cached, values_of(cached));
+
+    const auto found = cache.find_batch(keys);
+    ASSERT_EQ(found.size(), keys.size());
+    for (uint64_t key : keys) {
+        if (key % 2 == 0) {
+            ASSERT_TRUE(found[key].has_value());
+            EXPECT_EQ(std::get<1>(*found[key]), key + 1);
+        } else {
+            EXPECT_FALSE(found[key].has_value());
+        }
+    }
+}
+
+TEST(BatchOpsTest, TheLastValueOfADuplicateKeyWins) {
+    AdaptivePipelineCache cache{cache_config(64)};
+    const std::vector<uint64_t> keys = {7, 8, 7, 9, 7};
+    const std::vector<std::tuple<double, uint64_t>> values = {{1.0, 1}, {1.0, 2}, {1.0, 3}, {1.0, 4}, {1.0, 5}};
+    cache.setitem_batch(keys, values);
+    EXPECT_EQ(cache.currsize(), 3);
+
+    const auto found = cache.find_batch({7, 7, 10, 8});
+    ASSERT_TRUE(found[0].has_value() && found[1].has_value());
+    EXPECT_EQ(std::get<1>(*found[0]), 5);
+    EXPECT_EQ(std::get<1>(*found[1]), 5);
+    EXPECT_FALSE(found[2].has_value());
+    EXPECT_EQ(std::get<1>(*found[3]), 2);
+}
+
+// Inserting new keys reshuffles the cache while the rest of the group is stored, and evicts the oldest keys.
+// The FIFO alone evicts deterministically, unlike the sampling blocks ordered by access time.
+TEST(BatchOpsTest, MatchesSingleOperationsPastTheCapacity) {
+    Json config = cache_config(64);
+    config["blocks"][0]["initial_quanta"] = 4;
+    config["blocks"][1]["initial_quanta"] = 0;
+    AdaptivePipelineCache batched{config};
+    AdaptivePipelineCache single{config};
+    std::vector<uint64_t> keys;
+    for (uint64_t key = 0; key < 200; ++key) {
+        keys.push_back((key * 7) % 97);
+    }
+
+    batched.setitem_batch(keys, values_of(keys));
+    for (uint64_t key : keys) {
+        single.setitem(key, std::make_tuple(1.0, key + 1));
+    }
+    std::vector<uint64_t> batched_keys = batched.keys();
+    std::vector<uint64_t> single_keys = single.keys();
+    std::sort(batched_keys.begin(), batched_keys.end());
+    std::sort(single_keys.begin(), single_keys.end());
+    EXPECT_EQ(batched_keys, single_keys);
+
+    const auto found = batched.find_batch(keys);
+    for (size_t idx = 0; idx < keys.size(); ++idx) {
+        const bool is_cached = std::binary_search(single_keys.begin(), single_keys.end(), keys[idx]);
+        ASSERT_EQ(found[idx].has_value(), is_cached);
+        if (is_cached) {
+            EXPECT_EQ(std::get<1>(*found[idx]), keys[idx] + 1);
+        }
+    }
+}
+
+TEST(BatchOpsTest, KeepsAndPinsThePayloads) {
+    AdaptivePipelineCache cache{cache_config(64)};
+    cache.set_payload_hooks(&retain, &release);
+
+    int first = 1;
+    int second = 1;
+    cache.setitem_batch({1, 2, 1}, values_of({1, 2, 1}), {}, {&first, nullptr, &second});
+    cache.release_pending_payloads();
+    // The second setitem of key 1 replaced the first payload.
+    EXPECT_EQ(first, 0);
+    EXPECT_EQ(second, 1);
+
+    const auto found = cache.find_value_batch({1, 2, 3});
+    ASSERT_TRUE(found[0].has_value());
+    EXPECT_EQ(found[0]->payload, &second);
+    ASSERT_TRUE(found[1].has_value());
+    EXPECT_EQ(found[1]->payload, nullptr);
+    EXPECT_FALSE(found[2].has_value());
+
+    cache.retain_found_payload(*found[0]);
+    EXPECT_EQ(second, 2);
+}
@@ -0,0 +1,108 @@
+#include <cstdint>
+#include <set>
+
+#include <gtest/gtest.h>
+#include "clock_block.cpp"
+
+namespace {
+    constexpr uint64_t CACHE_CAPACITY = 128;
+    constexpr uint64_t QUANTUM_SIZE = 8;
+
+    // The blocks tell entries apart by their value_idx, so every entry gets its id as one.
+    CompactEntry make_entry(uint64_t id) {
+        return CompactEntry{id, 1.0, 1, static_cast<uint32_t>(id)};
+    }
+
+    void fill_block(ClockBlock& block, uint64_t first_id) {
+        for (uint64_t i = 0; i < block.capacity(); ++i) {
+            InsertionResult result = block.insert_item(make_entry(first_id + i));
+            EXPECT_TRUE(result.was_item_inserted);
+            EXPECT_FALSE(result.removed_entry.has_value());
+            EXPECT_EQ(result.replaced_idx, i);
+        }
+    }
+}
+
+TEST(ClockBlockTest, EvictsInInsertionOrderWithoutHits) {
+    ClockBlock block{CACHE_CAPACITY, QUANTUM_SIZE, 2};
+    fill_block(block, 0);
+    EXPECT_TRUE(block.is_full());
+
+    for (uint64_t i = 0; i < block.capacity(); ++i) {
+        InsertionResult result = block.insert_item(make_entry(100 + i));
+        ASSERT_TRUE(result.removed_entry.has_value());
+        EXPECT_EQ(result.removed_entry->value_idx, i);
+        EXPECT_EQ(result.replaced_idx, i);
+    }
+}
+
+TEST(ClockBlockTest, ReferencedEntriesGetSecondChance) {
+    ClockBlock block{CACHE_CAPACITY, QUANTUM_SIZE, 2};
+    fill_block(block, 0);
+
+    block.record_access(0);
+    block.record_access(1);
+    block.record_access(3);
+
+    InsertionResult result = block.insert_item(make_entry(100));
+    ASSERT_TRUE(result.removed_entry.has_value());
+    EXPECT_EQ(result.removed_entry->value_idx, 2);
+
+    result = block.insert_item(make_entry(101));
+    ASSERT_TRUE(result.removed_entry.has_value());
+    EXPECT_EQ(result.removed_entry->value_idx, 4);
+}
+
+TEST(ClockBlockTest, FullSweepWhenEverythingIsReferenced) {
+    ClockBlock block{CACHE_CAPACITY, QUANTUM_SIZE, 16};
+    fill_block(block, 0);
+
+    for (uint64_t i = 0; i < block.size(); ++i) {
+        block.record_access(i);
+    }
+
+    // All the bits are cleared by the sweep, so the hand ends up on its starting slot.
+    InsertionResult result = block.insert_item(make_entry(1000));
+    ASSERT_TRUE(result.removed_entry.has_value());
+    EXPECT_EQ(result.removed_entry->value_idx, 0);
+
+    result = block.insert_item(make_entry(1001));
+    ASSERT_TRUE(result.removed_entry.has_value());
+    EXPECT_EQ(result.removed_entry->value_idx, 1);
+}
+
+TEST(ClockBlockTest, QuantumMoveHandsOverUnreferencedEntries) {
+    ClockBlock src{CACHE_CAPACITY, QUANTUM_SIZE, 2};
+    ClockBlock dest{CACHE_CAPACITY, QUANTUM_SIZE, 1};
+    fill_block(src, 0);
+
+    std::set<uint64_t> referenced_ids;
+    for (uint64_t i = 0; i < src.size(); i += 2) {
+        src.record_access(i);
+        referenced_ids.insert(src.get_entry(i)->value_idx);
+    }
+
+    src.prepare_for_copy();
+    dest.prepare_for_copy();
+    QuantumMoveResult result = src.move_quanta_to(dest);
+
+    EXPECT_EQ(src.capacity(), QUANTUM_SIZE);
+    EXPECT_EQ(dest.capacity(), 2 * QUANTUM_SIZE);
+    EXPECT_EQ(result.items_moved.size(), QUANTUM_SIZE);
+    EXPECT_EQ(result.items_remaining.size(), QUANTUM_SIZE);
+
+    for (const auto& [value_idx, idx] : result.items_moved) {
+        EXPECT_FALSE(referenced_ids.contains(value_idx));
+        EXPECT_EQ(dest.get_entry(idx)->value_idx, value_idx);
+    }
+
+    for (const auto& [value_idx, idx] : result.items_remaining) {
+        EXPECT_TRUE(referenced_ids.contains(value_idx));
+        EXPECT_EQ(src.get_entry(idx)->value_idx, value_idx);
+    }
+
+    // The referenced bits followed the entries that stayed, so the next victim gets a full sweep first.
+    InsertionResult insertion = src.insert_item(make_entry(1000));
+    ASSERT_TRUE(insertion.removed_entry.has_value());
+    EXPECT_EQ(insertion.removed_entry->value_idx, result.items_remaining[0].first);
+}
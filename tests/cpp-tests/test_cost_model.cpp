@@ -0,0 +1,62 @@
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <variant>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "pipeline_cache.hpp"
+#include "test_utils.hpp"
+
+using Json = nlohmann::json;
+
+namespace {
+    Json cost_config(const Json& cost) {
+        Json config = cache_config(64, "fifo", "cost_aware_lfu");
+        if (!cost.is_null()) {
+            config["cost"] = cost;
+        }
+        return config;
+    }
+}
+
+TEST(CostModelTest, EvaluatesEveryModel) {
+    EXPECT_DOUBLE_EQ(cost::evaluate(cost::LatencyTokens{}, 2.0, 10), 20.0);
+    EXPECT_DOUBLE_EQ(cost::evaluate(cost::Latency{}, 2.0, 10), 2.0);
+    EXPECT_DOUBLE_EQ(cost::evaluate(cost::Tokens{}, 2.0, 10), 10.0);
+    EXPECT_DOUBLE_EQ(cost::evaluate(cost::Affine{1.0, 0.5, 0.25}, 2.0, 10), 1.0 + 1.0 + 2.5);
+    EXPECT_DOUBLE_EQ(cost::evaluate(cost::Weighted{{1.0, 2.0, 3.0, 4.0}}, 2.0, 10), 1.0 + 4.0 + 30.0 + 80.0);
+}
+
+TEST(CostModelTest, ParsesTheConfig) {
+    EXPECT_TRUE(std::holds_alternative<cost::LatencyTokens>(PipelineCache::parse_cost_model(cost_config(nullptr))));
+    EXPECT_TRUE(std::holds_alternative<cost::Tokens>(PipelineCache::parse_cost_model(cost_config({{"model", "tokens"}}))));
+
+    const CostModel affine = PipelineCache::parse_cost_model(cost_config({{"model", "affine"}, {"per_request", 3.0}}));
+    ASSERT_TRUE(std::holds_alternative<cost::Affine>(affine));
+    EXPECT_DOUBLE_EQ(cost::evaluate(affine, 100.0, 100), 3.0);
+
+    const CostModel weighted = PipelineCache::parse_cost_model(cost_config({{"model", "weighted"},
+                                                                            {"weights", {0.0, 1.0, 0.0, 1.0}}}));
+    EXPECT_STREQ(cost::name(weighted), "weighted");
+    EXPECT_DOUBLE_EQ(cost::evaluate(weighted, 2.0, 3), 8.0);
+}
+
+TEST(CostModelTest, CacheAggregatesTheModelCost) {
+    PipelineCache cache{false, cost_config({{"model", "tokens"}})};
+    cache.insert_item(HashedKey{1}, 100.0, 2);
+    cache.insert_item(HashedKey{2}, 100.0, 4);
+
+    // The misses cost their tokens only.
+    EXPECT_DOUBLE_EQ(cache.get_timeframe_aggregated_cost(), 3.0);
+    const CompactEntry entry = CompactEntry::with_cost(HashedKey{1}, 4.0, 0);
+    EXPECT_NEAR(entry.cost(), 4.0, 4.0 * 0.003);
+}
+
+TEST(CostModelTest, CostTablesMatchTheLogScale) {
+    for (uint32_t step = 1; step <= std::numeric_limits<uint16_t>::max(); ++step) {
+        const double expected = std::exp2(static_cast<double>(step) / 256.0 - 64.0);
+        ASSERT_DOUBLE_EQ(CompactEntry::dequantize_cost(static_cast<uint16_t>(step)), expected);
+    }
+    EXPECT_EQ(CompactEntry::dequantize_cost(0), 0.0);
+}
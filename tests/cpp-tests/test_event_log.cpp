@@ -0,0 +1,171 @@
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include "event_log.hpp"
+
+using EventType = EventLog::EventType;
+
+namespace {
+    // A flush interval no test waits for, records only reach the file on flush() or destruction.
+    constexpr uint64_t NO_PERIODIC_FLUSH_MS = 3600 * 1000;
+
+    std::string event_log_path(const std::string& name) {
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / ("pipeline-cache-" + name + ".eventlog");
+        std::filesystem::remove(path);
+        return path.string();
+    }
+
+    std::vector<EventLog::Record> read_records(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        EventLog::FileHeader header{};
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        EXPECT_EQ(header.magic, EventLog::MAGIC);
+
+        std::vector<EventLog::Record> records;
+        EventLog::Record record{};
+        while (file.read(reinterpret_cast<char*>(&record), sizeof(record))) {
+            records.push_back(record);
+        }
+        return records;
+    }
+}
+
+TEST(EventLogTest, RecordsEveryEventInOrder) {
+    const std::string path = event_log_path("order");
+    {
+        EventLog log{path, 16, NO_PERIODIC_FLUSH_MS};
+        log.log_ghost_cost(0, 0, 1, 2.5);
+        log.log_decision(0, 3.0, 2.5, 0, 1);
+        const std::vector<uint64_t> quanta{3, 5};
+        log.log_quantum_move(0, 1, quanta);
+        log.log_sketch_aging();
+        log.flush();
+
+        const std::vector<EventLog::Record> records = read_records(path);
+        ASSERT_EQ(records.size(), 4);
+        for (uint64_t idx = 0; idx < records.size(); ++idx) {
+            EXPECT_EQ(records[idx].sequence, idx);
+        }
+        EXPECT_EQ(records[0].type, EventType::GHOST_COST);
+        EXPECT_DOUBLE_EQ(records[0].costs[0], 2.5);
+        EXPECT_EQ(records[1].type, EventType::DECISION);
+        EXPECT_DOUBLE_EQ(records[1].costs[0], 3.0);
+        EXPECT_EQ(records[1].dest_block, 1);
+        EXPECT_EQ(records[2].type, EventType::QUANTUM_MOVE);
+        ASSERT_EQ(records[2].num_of_blocks, 2);
+        EXPECT_EQ(records[2].quanta[0], 3);
+        EXPECT_EQ(records[2].quanta[1], 5);
+        EXPECT_EQ(records[3].type, EventType::SKETCH_AGING);
+    }
+
+    // Reopening appends after the existing records.
+    {
+        EventLog log{path, 16, NO_PERIODIC_FLUSH_MS};
+        log.log_sketch_aging();
+    }
+    const std::vector<EventLog::Record> records = read_records(path);
+    ASSERT_EQ(records.size(), 5);
+    EXPECT_EQ(records[4].sequence, 4);
+}
+
+TEST(EventLogTest, FullRingDropsAndCountsRecords) {
+    const std::string path = event_log_path("dropped");
+    {
+        EventLog log{path, 4, NO_PERIODIC_FLUSH_MS};
+        for (int i = 0; i < 7; ++i) {
+            log.log_sketch_aging();
+        }
+        EXPECT_EQ(log.dropped(), 3);
+    }
+
+    const std::vector<EventLog::Record> records = read_records(path);
+    ASSERT_EQ(records.size(), 5);
+    EXPECT_EQ(records[4].type, EventType::DROPPED);
+    EXPECT_EQ(records[4].ghost, 3);
+}
+
+TEST(EventLogTest, ConcurrentWritersLoseNoRecord) {
+    const std::string path = event_log_path("concurrent");
+    constexpr int NUM_OF_THREADS = 4;
+    constexpr int RECORDS_PER_THREAD = 1000;
+    {
+        EventLog log{path, 1 << 14, 1};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < NUM_OF_THREADS; ++t) {
+            threads.emplace_back([&log, t]() {
+                for (int i = 0; i < RECORDS_PER_THREAD; ++i) {
+                    log.log_ghost_cost(t, 0, 1, static_cast<double>(i));
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    std::vector<int> last_cost(NUM_OF_THREADS, -1);
+    const std::vector<EventLog::Record> records = read_records(path);
+    ASSERT_EQ(records.size(), NUM_OF_THREADS * RECORDS_PER_THREAD);
+    for (const EventLog::Record& record : records) {
+        ASSERT_EQ(record.type, EventType::GHOST_COST);
+        // Each writer's records keep their order.
+        EXPECT_EQ(static_cast<int>(record.costs[0]), last_cost[record.ghost] + 1);
+        last_cost[record.ghost] = static_cast<int>(record.costs[0]);
+    }
+}
+
+TEST(EventLogTest, RejectsAFileOfAnotherFormat) {
+    const std::string path = event_log_path("foreign");
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << "timestamp key latency tokens\n";
+    }
+
+    EXPECT_THROW((EventLog{path, 16, NO_PERIODIC_FLUSH_MS}), std::runtime_error);
+    EXPECT_THROW((EventLog{event_log_path("capacity"), 12, NO_PERIODIC_FLUSH_MS}), std::invalid_argument);
+}
+
+TEST(EventLogTest, ForkedChildLogsToAFileOfItsOwn) {
+    const std::string path = event_log_path("fork");
+    auto log = std::make_unique<EventLog>(path, 16, NO_PERIODIC_FLUSH_MS);
+    // Still in the ring at the fork, it is the parent's to write.
+    log->log_sketch_aging();
+
+    const pid_t pid = fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0) {
+        log->log_ghost_cost(0, 0, 1, 2.5);
+        // Joins the child's own flusher.
+        log.reset();
+        std::_Exit(0);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    log->log_decision(0, 3.0, 2.5, 0, 1);
+    log.reset();
+
+    const std::vector<EventLog::Record> records = read_records(path);
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].type, EventType::SKETCH_AGING);
+    EXPECT_EQ(records[1].type, EventType::DECISION);
+
+    const std::string child_path = path + "." + std::to_string(pid);
+    const std::vector<EventLog::Record> child_records = read_records(child_path);
+    ASSERT_EQ(child_records.size(), 1);
+    EXPECT_EQ(child_records[0].type, EventType::GHOST_COST);
+    EXPECT_EQ(child_records[0].sequence, 0);
+    std::filesystem::remove(child_path);
+}
@@ -0,0 +1,76 @@
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "approximate_lru_block.cpp"
+
+namespace {
+    constexpr uint64_t CACHE_CAPACITY = 64;
+    constexpr uint64_t QUANTUM_SIZE = 8;
+    constexpr uint64_t SEED = 42;
+
+    CompactEntry entry_accessed_at(uint64_t id, uint64_t last_access_time) {
+        CompactEntry entry{HashedKey{id}, 1.0, 1, static_cast<uint32_t>(id)};
+        entry.last_access_time = last_access_time;
+        return entry;
+    }
+}
+
+TEST(EvictionPoolTest, KeepsTheLowestScores) {
+    EvictionPool pool{2};
+    pool.offer(0, 10, 3.0);
+    pool.offer(1, 11, 1.0);
+    pool.offer(2, 12, 2.0);
+    pool.offer(3, 13, 5.0);
+
+    const std::vector<double> scores = {3.0, 1.0, 2.0, 5.0};
+    const auto score_of = [&scores](uint64_t idx, uint64_t) -> std::optional<double> { return scores[idx]; };
+    EXPECT_EQ(pool.best(score_of), 1);
+}
+
+TEST(EvictionPoolTest, RevalidatesStaleCandidates) {
+    EvictionPool pool{4};
+    pool.offer(0, 10, 1.0);
+    pool.offer(1, 11, 2.0);
+    pool.offer(2, 12, 3.0);
+
+    // Slot 0 holds another entry by now, and the entry of slot 1 was accessed since it was offered.
+    std::vector<uint64_t> ids = {20, 11, 12};
+    std::vector<double> scores = {0.0, 9.0, 3.0};
+    const auto score_of = [&](uint64_t idx, uint64_t id) -> std::optional<double> {
+        return ids[idx] == id ? std::make_optional(scores[idx]) : std::nullopt;
+    };
+    EXPECT_EQ(pool.best(score_of), 2);
+
+    ids[2] = 30;
+    EXPECT_EQ(pool.best(score_of), 1);
+    ids[1] = 40;
+    EXPECT_EQ(pool.best(score_of), std::nullopt);
+}
+
+TEST(EvictionPoolTest, ALRUConvergesToTheOldestEntry) {
+    // Small samples of 4 entries, every peek merges one into the pool.
+    ALRUBlock block{CACHE_CAPACITY, QUANTUM_SIZE, 2, SEED, 4, {}, 16};
+    for (uint64_t i = 0; i < block.capacity(); ++i) {
+        // The oldest entry sits in the middle of the block.
+        block.insert_item(entry_accessed_at(i, i == 9 ? 1 : 100 + i));
+    }
+
+    for (int peek = 0; peek < 64; ++peek) {
+        block.peek_victim();
+    }
+    EXPECT_EQ(block.peek_victim()->value_idx, 9);
+
+    // Once it is accessed, its pooled timestamp is stale and the next oldest pooled entry is picked.
+    block.record_access(9);
+    const CompactEntry* victim = block.peek_victim();
+    ASSERT_NE(victim, nullptr);
+    EXPECT_NE(victim->value_idx, 9);
+    EXPECT_LT(victim->last_access_time, 100 + block.capacity());
+    const uint64_t victim_id = victim->value_idx;
+
+    const InsertionResult result = block.insert_item(entry_accessed_at(1000, utils::get_current_time_in_ms()));
+    ASSERT_TRUE(result.removed_entry.has_value());
+    EXPECT_EQ(result.removed_entry->value_idx, victim_id);
+}
@@ -210,6 +210,28 @@ TEST(FixedSizeArrayTest, SimpleRotateTest) {
     }
 }
 
+TEST(FixedSizeArrayTest, WrappedRotateStaysInPlaceTest) {
+    FixedSizeArray<uint64_t> arr{10};
+    for (uint64_t i = 0; i < arr.capacity(); ++i) {
+        arr.push_tail(i);
+    }
+    for (uint64_t i = 0; i < 7; ++i) {
+        arr.pop_head();
+    }
+    for (uint64_t i = 10; i < 13; ++i) {
+        arr.push_tail(i);
+    }
+
+    const uint64_t* data_before_rotate = arr.data();
+    arr.rotate();
+    EXPECT_EQ(arr.data(), data_before_rotate);
+    EXPECT_FALSE(arr.is_rotated());
+    ASSERT_EQ(arr.size(), 6);
+    for (uint64_t i = 0; i < arr.size(); ++i) {
+        EXPECT_EQ(arr.data()[i], i + 7);
+    }
+}
+
 TEST(FixedSizeArrayTest, ComplexRotateTest) {
     FixedSizeArray<uint64_t> arr{10};
     for (uint64_t i = 0; i < arr.capacity(); ++i) {
@@ -0,0 +1,116 @@
+#include <cstdint>
+#include <set>
+
+#include <gtest/gtest.h>
+#include "gdsf_block.cpp"
+
+namespace {
+    constexpr uint64_t CACHE_CAPACITY = 64;
+    constexpr uint64_t QUANTUM_SIZE = 4;
+
+    // Every entry costs its id, so the lowest id in the block is always the victim. The id doubles as the
+    // value_idx the blocks tell entries apart by.
+    CompactEntry make_entry(uint64_t id) {
+        return CompactEntry{id, static_cast<double>(id), 1, static_cast<uint32_t>(id)};
+    }
+}
+
+TEST(GDSFBlockTest, EvictsLowestPriority) {
+    CountMinSketch sketch{0.01, 0.99, 42};
+    GDSFBlock block{CACHE_CAPACITY, QUANTUM_SIZE, 2, sketch};
+
+    const uint64_t ids[] = {50, 20, 80, 10, 70, 30, 60, 40};
+    for (uint64_t id : ids) {
+        sketch.add(id);
+        InsertionResult result = block.insert_item(make_entry(id));
+        EXPECT_TRUE(result.was_item_inserted);
+        EXPECT_FALSE(result.removed_entry.has_value());
+    }
+    EXPECT_TRUE(block.is_full());
+
+    sketch.add(100);
+    InsertionResult result = block.insert_item(make_entry(100));
+    ASSERT_TRUE(result.was_item_inserted);
+    ASSERT_TRUE(result.removed_entry.has_value());
+    EXPECT_EQ(result.removed_entry->value_idx, 10);
+    EXPECT_EQ(block.get_entry(result.replaced_idx)->value_idx, 100);
+
+    // The inflation is now 10, so an entry costing 15 gets 25 and beats the 20 entry.
+    sketch.add(15);
+    result = block.insert_item(make_entry(15));
+    ASSERT_TRUE(result.removed_entry.has_value());
+    EXPECT_EQ(result.removed_entry->value_idx, 20);
+}
+
+TEST(GDSFBlockTest, RejectsCheaperThanVictim) {
+    CountMinSketch sketch{0.01, 0.99, 42};
+    GDSFBlock block{CACHE_CAPACITY, QUANTUM_SIZE, 1, sketch};
+
+    for (uint64_t id = 10; id < 14; ++id) {
+        sketch.add(id);
+        block.insert_item(make_entry(id));
+    }
+
+    sketch.add(5);
+    InsertionResult result = block.insert_item(make_entry(5));
+    EXPECT_FALSE(result.was_item_inserted);
+    EXPECT_FALSE(result.removed_entry.has_value());
+    EXPECT_EQ(block.size(), 4);
+}
+
+TEST(GDSFBlockTest, HitsRaisePriority) {
+    CountMinSketch sketch{0.01, 0.99, 42};
+    GDSFBlock block{CACHE_CAPACITY, QUANTUM_SIZE, 1, sketch};
+
+    for (uint64_t id = 10; id < 14; ++id) {
+        sketch.add(id);
+        block.insert_item(make_entry(id));
+    }
+
+    // Entry 10 is in slot 0, after two more accesses its priority is 30.
+    for (int i = 0; i < 2; ++i) {
+        sketch.add(10);
+        block.record_access(0);
+    }
+
+    sketch.add(20);
+    InsertionResult result = block.insert_item(make_entry(20));
+    ASSERT_TRUE(result.removed_entry.has_value());
+    EXPECT_EQ(result.removed_entry->value_idx, 11);
+}
+
+TEST(GDSFBlockTest, QuantumMoveHandsOverLowestPriorities) {
+    CountMinSketch sketch{0.01, 0.99, 42};
+    GDSFBlock src{CACHE_CAPACITY, QUANTUM_SIZE, 2, sketch};
+    GDSFBlock dest{CACHE_CAPACITY, QUANTUM_SIZE, 1, sketch};
+
+    const uint64_t ids[] = {50, 20, 80, 10, 70, 30, 60, 40};
+    for (uint64_t id : ids) {
+        sketch.add(id);
+        src.insert_item(make_entry(id));
+    }
+
+    src.prepare_for_copy();
+    dest.prepare_for_copy();
+    QuantumMoveResult result = src.move_quanta_to(dest);
+
+    EXPECT_EQ(src.capacity(), QUANTUM_SIZE);
+    EXPECT_EQ(dest.capacity(), 2 * QUANTUM_SIZE);
+
+    std::set<uint64_t> moved_ids;
+    for (const auto& [id, idx] : result.items_moved) {
+        moved_ids.insert(id);
+        EXPECT_EQ(dest.get_entry(idx)->value_idx, id);
+    }
+    EXPECT_EQ(moved_ids, (std::set<uint64_t>{10, 20, 30, 40}));
+
+    for (const auto& [id, idx] : result.items_remaining) {
+        EXPECT_EQ(src.get_entry(idx)->value_idx, id);
+    }
+
+    // The heap was rebuilt over the remaining entries, so the next victim is the cheapest of them.
+    sketch.add(90);
+    InsertionResult insertion = src.insert_item(make_entry(90));
+    ASSERT_TRUE(insertion.removed_entry.has_value());
+    EXPECT_EQ(insertion.removed_entry->value_idx, 50);
+}
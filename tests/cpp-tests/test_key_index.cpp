@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+#include "key_index.hpp"
+
+TEST(KeyIndexTest, InsertFindAndErase) {
+    KeyIndex index{16};
+    for (uint64_t id = 0; id < 16; ++id) {
+        index.insert_or_assign(HashedKey{id}, id % 3, id);
+    }
+    EXPECT_EQ(index.size(), 16);
+
+    const EntryPosition* pos = index.find(HashedKey{7});
+    ASSERT_NE(pos, nullptr);
+    EXPECT_EQ(pos->id, 7);
+    EXPECT_EQ(pos->block_num, 1);
+    EXPECT_EQ(pos->idx, 7);
+
+    index.insert_or_assign(HashedKey{7}, 2, 0);
+    EXPECT_EQ(index.size(), 16);
+    EXPECT_EQ(index.find(HashedKey{7})->block_num, 2);
+
+    index.erase(HashedKey{7});
+    EXPECT_FALSE(index.contains(HashedKey{7}));
+    EXPECT_EQ(index.size(), 15);
+    for (uint64_t id = 0; id < 16; ++id) {
+        EXPECT_EQ(index.contains(HashedKey{id}), id != 7);
+    }
+}
+
+TEST(KeyIndexTest, EraseKeepsCollidingRunsReachable) {
+    KeyIndex index{8};
+    // All keys share a home slot, and the run wraps around the end of the table.
+    const uint64_t hash = UINT64_MAX;
+    for (uint64_t id = 0; id < 6; ++id) {
+        index.insert_or_assign(HashedKey{id, hash}, 0, id);
+    }
+
+    index.erase(HashedKey{1, hash});
+    index.erase(HashedKey{4, hash});
+    for (uint64_t id = 0; id < 6; ++id) {
+        const bool should_be_found = id != 1 && id != 4;
+        EXPECT_EQ(index.contains(HashedKey{id, hash}), should_be_found);
+    }
+
+    std::vector<uint64_t> ids;
+    index.for_each([&ids](const EntryPosition& pos) { ids.push_back(pos.id); });
+    std::sort(ids.begin(), ids.end());
+    EXPECT_EQ(ids, (std::vector<uint64_t>{0, 2, 3, 5}));
+
+    index.clear();
+    EXPECT_EQ(index.size(), 0);
+    EXPECT_FALSE(index.contains(HashedKey{0, hash}));
+}
@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "latency_histograms.hpp"
+
+using Op = LatencyHistograms::Op;
+
+TEST(LatencyHistogramsTest, BucketsBoundTheirDurations) {
+    for (uint64_t ns : {0ULL, 1ULL, 7ULL, 8ULL, 9ULL, 100ULL, 1000ULL, 123456789ULL}) {
+        const size_t idx = LatencyHistograms::bucket_index(ns);
+        EXPECT_LT(ns, LatencyHistograms::bucket_upper_bound(idx));
+        if (idx > 0) {
+            EXPECT_GE(ns, LatencyHistograms::bucket_upper_bound(idx - 1));
+        }
+        // Within 12.5% above the 8 linear buckets.
+        EXPECT_LE(LatencyHistograms::bucket_upper_bound(idx), ns + ns / 8 + 1);
+    }
+    EXPECT_EQ(LatencyHistograms::bucket_index(UINT64_MAX), LatencyHistograms::NUM_OF_BUCKETS - 1);
+}
+
+TEST(LatencyHistogramsTest, QuantilesMergeEveryThread) {
+    LatencyHistograms histograms;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&histograms]() {
+            for (uint64_t i = 0; i < 99; ++i) {
+                histograms.record(Op::SETITEM, 1000);
+            }
+            histograms.record(Op::SETITEM, 1000000);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(histograms.count(Op::SETITEM), 400);
+    EXPECT_EQ(histograms.count(Op::LOOKUP_HIT), 0);
+    EXPECT_NEAR(histograms.quantile(Op::SETITEM, 0.5), 1e-6, 0.125e-6);
+    EXPECT_NEAR(histograms.quantile(Op::SETITEM, 1.0), 1e-3, 0.125e-3);
+    EXPECT_EQ(histograms.quantile(Op::ADAPT, 0.99), 0.0);
+}
+
+TEST(LatencyHistogramsTest, PrometheusBucketsAreCumulative) {
+    LatencyHistograms histograms;
+    histograms.record(Op::LOOKUP_HIT, 300);
+    histograms.record(Op::LOOKUP_HIT, 5000);
+
+    const std::string metrics = histograms.to_prometheus("cache");
+    EXPECT_NE(metrics.find("# TYPE cache_operation_duration_seconds histogram"), std::string::npos);
+    EXPECT_NE(metrics.find("cache_operation_duration_seconds_bucket{op=\"lookup_hit\",le=\"2.56e-07\"} 0"), std::string::npos);
+    EXPECT_NE(metrics.find("cache_operation_duration_seconds_bucket{op=\"lookup_hit\",le=\"5.12e-07\"} 1"), std::string::npos);
+    EXPECT_NE(metrics.find("cache_operation_duration_seconds_bucket{op=\"lookup_hit\",le=\"+Inf\"} 2"), std::string::npos);
+    EXPECT_NE(metrics.find("cache_operation_duration_seconds_count{op=\"lookup_hit\"} 2"), std::string::npos);
+    EXPECT_EQ(LatencyHistograms::parse_op("ghost_simulation"), Op::GHOST_SIMULATION);
+    EXPECT_FALSE(LatencyHistograms::parse_op("getitem").has_value());
+}
@@ -0,0 +1,52 @@
+#include <cstdint>
+
+#include <gtest/gtest.h>
+#include "memory_policy.hpp"
+#include "fixed_size_array.hpp"
+#include "key_index.hpp"
+
+namespace {
+    // Large enough to be mapped with huge pages.
+    constexpr uint64_t LARGE_CAPACITY = memory::HUGE_PAGE_SIZE / sizeof(uint64_t) + 1;
+}
+
+TEST(MemoryPolicyTest, HugePageArraysStartZeroedAndSurviveCopies) {
+    const MemoryPolicy policy{true, -1};
+    FixedSizeArray<uint64_t> arr{LARGE_CAPACITY, policy};
+    for (uint64_t idx = 0; idx < LARGE_CAPACITY; ++idx) {
+        EXPECT_EQ(*arr.get_item(idx), 0);
+    }
+    for (uint64_t idx = 0; idx < LARGE_CAPACITY - 1; ++idx) {
+        arr.push_tail(idx);
+    }
+
+    const FixedSizeArray<uint64_t> copy{arr};
+    EXPECT_EQ(copy.size(), LARGE_CAPACITY - 1);
+    EXPECT_EQ(copy[LARGE_CAPACITY - 2], LARGE_CAPACITY - 2);
+
+    // Wraps the tail around, rotating moves the items within the same mapping.
+    arr.pop_head();
+    arr.push_tail(LARGE_CAPACITY - 1);
+    const uint64_t* data = arr.data();
+    arr.rotate();
+    EXPECT_EQ(arr.data(), data);
+    EXPECT_EQ(arr[0], 1);
+    EXPECT_EQ(arr[LARGE_CAPACITY - 2], LARGE_CAPACITY - 1);
+}
+
+TEST(MemoryPolicyTest, KeyIndexKeepsItsPolicyWhenAssigned) {
+    KeyIndex index;
+    index = KeyIndex{LARGE_CAPACITY, MemoryPolicy{true, -1}};
+    for (uint64_t id = 0; id < 1000; ++id) {
+        index.insert_or_assign(HashedKey{id}, 0, id);
+    }
+
+    const KeyIndex copy{index};
+    EXPECT_EQ(copy.size(), 1000);
+    EXPECT_EQ(copy.find(HashedKey{999})->idx, 999);
+}
+
+TEST(MemoryPolicyTest, MissingNumaNodeIsReported) {
+    EXPECT_FALSE(memory::is_numa_node_available(-1));
+    EXPECT_FALSE(memory::is_numa_node_available(1 << 20));
+}
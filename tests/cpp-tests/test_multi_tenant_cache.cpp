@@ -0,0 +1,95 @@
+#include <cstdint>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "multi_tenant_cache.hpp"
+#include "test_utils.hpp"
+
+namespace {
+    // Budget quanta of 32 entries, rebalanced only by the tests.
+    Json tenants_config() {
+        Json config = cache_config(256);
+        config["tenants"] = {{"names", {"busy", "idle"}}, {"num_of_quanta", 8}, {"rebalance_interval_ms", 0}};
+        return config;
+    }
+
+    // Cycles over more keys than the tenant holds, so every extra quantum saves misses.
+    void cycle(AdaptivePipelineCache& tenant, uint64_t num_of_keys, uint64_t rounds) {
+        for (uint64_t round = 0; round < rounds; ++round) {
+            for (uint64_t key = 0; key < num_of_keys; ++key) {
+                if (!tenant.find(key).has_value()) {
+                    tenant.setitem(key, std::make_tuple(1.0, uint64_t{10}));
+                }
+            }
+        }
+        while (tenant.popitem().has_value()) {}
+    }
+}
+
+TEST(MultiTenantCacheTest, SplitsTheCapacityEvenly) {
+    MultiTenantCache cache{tenants_config()};
+    EXPECT_EQ(cache.quantum_size(), 32);
+    EXPECT_EQ(cache.quanta_alloc(), (std::vector<uint64_t>{4, 4}));
+    EXPECT_EQ(cache.find_tenant("busy")->maxsize(), 128);
+    EXPECT_EQ(cache.find_tenant("idle")->maxsize(), 128);
+    EXPECT_EQ(cache.find_tenant("other"), nullptr);
+}
+
+TEST(MultiTenantCacheTest, MovesTheBudgetToTheBusyTenant) {
+    MultiTenantCache cache{tenants_config()};
+    AdaptivePipelineCache& busy = *cache.find_tenant("busy");
+    AdaptivePipelineCache& idle = *cache.find_tenant("idle");
+
+    for (int window = 0; window < 6; ++window) {
+        cycle(busy, 200, 4);
+        cache.rebalance();
+
+        const std::vector<uint64_t> quanta = cache.quanta_alloc();
+        EXPECT_EQ(std::accumulate(quanta.begin(), quanta.end(), uint64_t{0}), 8);
+        EXPECT_EQ(busy.maxsize() + idle.maxsize(), cache.capacity());
+        EXPECT_LE(busy.currsize(), busy.maxsize());
+    }
+
+    // The idle tenant keeps its minimum of one quantum.
+    EXPECT_EQ(cache.quanta_alloc(), (std::vector<uint64_t>{7, 1}));
+    EXPECT_EQ(busy.maxsize(), 224);
+
+    // With every key fitting, a window saves nothing and the budget stays.
+    cycle(busy, 200, 4);
+    cache.rebalance();
+    cycle(busy, 200, 4);
+    EXPECT_FALSE(cache.rebalance());
+}
+
+TEST(MultiTenantCacheTest, KeepsTheBudgetWithoutTraffic) {
+    MultiTenantCache cache{tenants_config()};
+    EXPECT_FALSE(cache.rebalance());
+    EXPECT_EQ(cache.quanta_alloc(), (std::vector<uint64_t>{4, 4}));
+}
+
+TEST(MultiTenantCacheTest, BudgetGhostsFollowTheBlockQuanta) {
+    MultiTenantCache cache{tenants_config()};
+    AdaptivePipelineCache& busy = *cache.find_tenant("busy");
+    const std::vector<uint64_t> initial_quanta = busy.quanta_alloc();
+
+    // A hot set hit between one-off keys, which the ALRU block keeps and the FIFO doesn't, until a quantum moves.
+    uint64_t next_cold_key = 1000;
+    for (int round = 0; round < 1000 && busy.quanta_alloc() == initial_quanta; ++round) {
+        for (uint64_t key = 0; key < 64; ++key) {
+            for (const uint64_t requested : {key, next_cold_key++}) {
+                if (!busy.find(requested).has_value()) {
+                    busy.setitem(requested, std::make_tuple(1.0, uint64_t{10}));
+                }
+            }
+        }
+        while (busy.popitem().has_value()) {}
+    }
+
+    ASSERT_NE(busy.quanta_alloc(), initial_quanta);
+    for (const std::vector<uint64_t>& ghost_quanta : busy.budget_ghosts_quanta_alloc()) {
+        EXPECT_EQ(ghost_quanta, busy.quanta_alloc());
+    }
+}
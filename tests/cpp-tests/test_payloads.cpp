@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <optional>
+#include <tuple>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "adaptive_pipeline_cache.hpp"
+#include "test_utils.hpp"
+
+TEST(PayloadTest, AFoundPayloadIsPinnedUntilRetained) {
+    AdaptivePipelineCache cache{cache_config(16)};
+    cache.set_payload_hooks(&retain, &release);
+
+    int refs = 1;  // the reference handed over to the cache
+    cache.setitem(1, std::make_tuple(1.0, uint64_t{1}), std::nullopt, 0, &refs);
+    const std::optional<AdaptivePipelineCache::CachedValue> value = cache.find_value(1);
+    ASSERT_TRUE(value.has_value());
+    EXPECT_EQ(value->payload, &refs);
+
+    // Deleting the entry queues its payload, which stays alive while the found value is pinned.
+    EXPECT_TRUE(cache.delitem(1));
+    cache.release_pending_payloads();
+    EXPECT_EQ(refs, 1);
+
+    cache.retain_found_payload(*value);
+    EXPECT_EQ(refs, 2);
+    cache.release_pending_payloads();
+    EXPECT_EQ(refs, 1);
+}
+
+TEST(PayloadTest, EvictedPayloadsAreReleased) {
+    AdaptivePipelineCache cache{cache_config(16)};
+    cache.set_payload_hooks(&retain, &release);
+
+    int refs = 1;
+    cache.setitem(1, std::make_tuple(1.0, uint64_t{1}), std::nullopt, 0, &refs);
+    for (uint64_t key = 100; key < 200; ++key) {
+        cache.setitem(key, std::make_tuple(1.0, uint64_t{1}));
+    }
+    cache.release_pending_payloads();
+    EXPECT_FALSE(cache.contains(1));
+    EXPECT_EQ(refs, 0);
+}
+
+TEST(PayloadTest, ATakenPayloadIsHandedOverWithoutALookup) {
+    Json config = cache_config(16);
+    config["metrics"] = {{"latency_histograms", true}};
+    AdaptivePipelineCache cache{config};
+    cache.set_payload_hooks(&retain, &release);
+
+    int refs = 1;
+    cache.setitem(1, std::make_tuple(2.0, uint64_t{3}), std::nullopt, 0, &refs);
+    const std::optional<AdaptivePipelineCache::CachedValue> value = cache.take_value(1);
+    ASSERT_TRUE(value.has_value());
+    EXPECT_DOUBLE_EQ(value->latency, 2.0);
+    EXPECT_EQ(value->tokens, 3);
+    EXPECT_EQ(value->payload, &refs);
+    EXPECT_EQ(cache.latency_histograms()->count(LatencyHistograms::Op::LOOKUP_HIT), 0);
+    EXPECT_EQ(cache.latency_histograms()->count(LatencyHistograms::Op::LOOKUP_MISS), 0);
+
+    // The cache's reference is released once the taken payload was retained for the caller.
+    cache.release_pending_payloads();
+    EXPECT_EQ(refs, 1);
+    cache.retain_found_payload(*value);
+    cache.release_pending_payloads();
+    EXPECT_EQ(refs, 1);
+
+    EXPECT_FALSE(cache.take_value(1).has_value());
+    EXPECT_FALSE(cache.delitem(1));
+}
@@ -0,0 +1,106 @@
+#include <cstdint>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "pipeline_cache.hpp"
+#include "test_utils.hpp"
+
+using Json = nlohmann::json;
+
+namespace {
+    std::set<uint64_t> evicted_ids(PipelineCache& cache) {
+        std::set<uint64_t> ids;
+        while (cache.should_evict()) {
+            ids.insert(cache.evict_item().id);
+        }
+        return ids;
+    }
+}
+
+TEST(ResizeTest, ShrinkingEvictsThroughTheQueue) {
+    PipelineCache cache{false, cache_config(64)};
+    for (uint64_t key = 0; key < 64; ++key) {
+        cache.insert_item(HashedKey{key}, 1.0, key + 1);
+    }
+    ASSERT_EQ(cache.size(), 64);
+    evicted_ids(cache);
+    cache.move_quantum(1, 0);
+
+    cache.resize(false, cache_config(16));
+    EXPECT_EQ(cache.capacity(), 16);
+    EXPECT_EQ(cache.size(), 16);
+    // The blocks keep their quanta.
+    EXPECT_EQ(cache.quanta_alloc(), (std::vector<uint64_t>{3, 1}));
+
+    const std::set<uint64_t> evicted = evicted_ids(cache);
+    EXPECT_EQ(evicted.size(), 48);
+    for (uint64_t key : cache.keys()) {
+        EXPECT_EQ(evicted.count(key), 0);
+        const EntryValue* value = cache.peek_item(HashedKey{key});
+        ASSERT_NE(value, nullptr);
+        EXPECT_EQ(value->tokens, key + 1);
+    }
+
+    // The cache keeps working at its new capacity.
+    for (uint64_t key = 100; key < 200; ++key) {
+        cache.insert_item(HashedKey{key}, 1.0, 1);
+    }
+    EXPECT_EQ(cache.size(), 16);
+}
+
+TEST(ResizeTest, TheFifoKeepsItsNewestEntries) {
+    Json config = cache_config(64);
+    config["blocks"][0]["initial_quanta"] = 4;
+    config["blocks"][1]["initial_quanta"] = 0;
+    PipelineCache cache{false, config};
+    for (uint64_t key = 0; key < 64; ++key) {
+        cache.insert_item(HashedKey{key}, 1.0, 1);
+    }
+
+    config["cache"]["capacity"] = 8;
+    cache.resize(false, config);
+    std::vector<uint64_t> keys = cache.keys();
+    std::sort(keys.begin(), keys.end());
+    EXPECT_EQ(keys, (std::vector<uint64_t>{56, 57, 58, 59, 60, 61, 62, 63}));
+}
+
+TEST(ResizeTest, GrowingKeepsEveryEntry) {
+    PipelineCache cache{false, cache_config(16)};
+    for (uint64_t key = 0; key < 16; ++key) {
+        cache.insert_item(HashedKey{key}, 2.0, 3);
+    }
+    evicted_ids(cache);
+
+    cache.resize(false, cache_config(64));
+    EXPECT_EQ(cache.capacity(), 64);
+    EXPECT_EQ(cache.size(), 16);
+    EXPECT_FALSE(cache.should_evict());
+    for (uint64_t key = 0; key < 16; ++key) {
+        ASSERT_TRUE(cache.contains(HashedKey{key}));
+        EXPECT_DOUBLE_EQ(cache.get_item(HashedKey{key}).latency, 2.0);
+    }
+
+    for (uint64_t key = 16; key < 64; ++key) {
+        cache.insert_item(HashedKey{key}, 2.0, 3);
+    }
+    EXPECT_EQ(cache.size(), 64);
+    EXPECT_FALSE(cache.should_evict());
+}
+
+TEST(ResizeTest, TheCapacityNeedsOnlyWholeQuanta) {
+    PipelineCache cache{false, cache_config(16)};
+    for (uint64_t key = 0; key < 16; ++key) {
+        cache.insert_item(HashedKey{key}, 1.0, 1);
+    }
+
+    cache.resize(false, cache_config(48));
+    EXPECT_EQ(cache.capacity(), 48);
+    EXPECT_EQ(cache.quanta_alloc(), (std::vector<uint64_t>{2, 2}));
+    for (uint64_t key = 16; key < 100; ++key) {
+        cache.insert_item(HashedKey{key}, 1.0, 1);
+    }
+    EXPECT_EQ(cache.size(), 48);
+}
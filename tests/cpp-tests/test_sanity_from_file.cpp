@@ -5,7 +5,7 @@
 #include <fstream>
 #include <sstream>
 
-#include "adaptive_pipeline_cache.cpp"
+#include "adaptive_pipeline_cache.hpp"
 
 int main() {
     const std::string input_file = "input.trace";
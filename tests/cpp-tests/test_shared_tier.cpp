@@ -0,0 +1,132 @@
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include "shared_tier.hpp"
+#include "adaptive_pipeline_cache.hpp"
+#include "test_utils.hpp"
+
+namespace {
+    constexpr uint64_t SHARED_CAPACITY = 64;
+
+    std::string segment_name(const std::string& name) {
+        const std::string segment = "/pipeline-cache-test-" + name + "-" + std::to_string(getpid());
+        SharedTier::remove(segment);
+        return segment;
+    }
+
+    Json shared_cache_config(const std::string& name) {
+        Json config = cache_config(16);
+        config["shared"] = {{"name", name}, {"capacity", SHARED_CAPACITY}};
+        return config;
+    }
+}
+
+TEST(SharedTierTest, EntriesAreVisibleToEveryAttachedTier) {
+    const std::string name = segment_name("attach");
+    SharedTier writer{name, SHARED_CAPACITY};
+    SharedTier reader{name, SHARED_CAPACITY};
+
+    EntryData entry{7, 2.5, 100};
+    entry.digest = 11;
+    writer.put(entry, 0);
+
+    std::optional<SharedTier::Record> record = reader.get(7, 0);
+    ASSERT_TRUE(record.has_value());
+    EXPECT_DOUBLE_EQ(record->entry.latency, 2.5);
+    EXPECT_EQ(record->entry.tokens, 100);
+    EXPECT_EQ(record->entry.digest, 11);
+    EXPECT_EQ(reader.size(), 1);
+
+    reader.erase(7);
+    EXPECT_FALSE(writer.get(7, 0).has_value());
+    EXPECT_EQ(writer.size(), 0);
+
+    SharedTier::remove(name);
+}
+
+TEST(SharedTierTest, EntriesAreVisibleAcrossProcesses) {
+    const std::string name = segment_name("fork");
+    SharedTier parent{name, SHARED_CAPACITY};
+
+    const pid_t child = fork();
+    ASSERT_GE(child, 0);
+    if (child == 0) {
+        SharedTier tier{name, SHARED_CAPACITY};
+        tier.put(EntryData{42, 1.5, 30}, 0);
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+
+    std::optional<SharedTier::Record> record = parent.get(42, 0);
+    ASSERT_TRUE(record.has_value());
+    EXPECT_EQ(record->entry.tokens, 30);
+
+    SharedTier::remove(name);
+}
+
+TEST(SharedTierTest, ExpiredEntriesAreDropped) {
+    const std::string name = segment_name("expire");
+    SharedTier tier{name, SHARED_CAPACITY};
+    tier.put(EntryData{1, 1.0, 10}, 1000);
+
+    EXPECT_TRUE(tier.get(1, 999).has_value());
+    EXPECT_FALSE(tier.get(1, 1000).has_value());
+    EXPECT_EQ(tier.size(), 0);
+
+    SharedTier::remove(name);
+}
+
+TEST(SharedTierTest, FullTierKeepsItsCapacity) {
+    const std::string name = segment_name("full");
+    SharedTier tier{name, SHARED_CAPACITY};
+    for (uint64_t id = 0; id < 4 * SHARED_CAPACITY; ++id) {
+        tier.put(EntryData{id, 1.0, 1}, 0);
+    }
+
+    EXPECT_LE(tier.size(), tier.capacity());
+    // The last entry always replaces another one of its set.
+    EXPECT_TRUE(tier.get(4 * SHARED_CAPACITY - 1, 0).has_value());
+
+    tier.clear();
+    EXPECT_EQ(tier.size(), 0);
+
+    SharedTier::remove(name);
+}
+
+TEST(SharedTierTest, CapacityMismatchIsRejected) {
+    const std::string name = segment_name("mismatch");
+    SharedTier tier{name, SHARED_CAPACITY};
+    EXPECT_THROW(SharedTier(name, 2 * SHARED_CAPACITY), std::runtime_error);
+
+    SharedTier::remove(name);
+}
+
+TEST(SharedTierTest, PayloadItemsAreNotPromotedWithoutTheirPayload) {
+    const std::string name = segment_name("payload");
+    AdaptivePipelineCache cache{shared_cache_config(name)};
+    cache.set_payload_hooks(&retain, &release);
+
+    // The plain value set first must not come back either, once the payload item replaced it.
+    int refs = 1;
+    cache.setitem(1, std::make_tuple(1.0, uint64_t{10}));
+    cache.setitem(1, std::make_tuple(1.0, uint64_t{20}), std::nullopt, 0, &refs);
+    for (uint64_t key = 100; key < 164; ++key) {
+        cache.setitem(key, std::make_tuple(1.0, uint64_t{1}));
+    }
+    while (cache.popitem().has_value()) {}
+    cache.release_pending_payloads();
+    ASSERT_EQ(refs, 0);
+
+    EXPECT_FALSE(cache.find_value(1).has_value());
+    EXPECT_TRUE(cache.find_value(163).has_value());
+
+    SharedTier::remove(name);
+}
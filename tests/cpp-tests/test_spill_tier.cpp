@@ -0,0 +1,161 @@
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <filesystem>
+
+#include <gtest/gtest.h>
+#include <nlohmann/json.hpp>
+#include "spill_tier.hpp"
+#include "adaptive_pipeline_cache.hpp"
+#include "test_utils.hpp"
+
+namespace {
+    constexpr uint64_t SPILL_CAPACITY = 4;
+
+    std::string spill_path(const std::string& name) {
+        return (std::filesystem::temp_directory_path() / ("pipeline-cache-" + name + ".spill")).string();
+    }
+
+    Json spilling_cache_config(const std::string& name) {
+        Json config = cache_config(16, "fifo", "fifo");
+        config["spill"] = {{"path", spill_path(name)}, {"capacity", 64}};
+        return config;
+    }
+
+    // Evicts every resident key into the eviction queue, without popping them.
+    void flood(AdaptivePipelineCache& cache) {
+        for (uint64_t key = 100; key < 132; ++key) {
+            cache.setitem(key, std::make_tuple(1.0, uint64_t{1}));
+        }
+    }
+
+    void pop_all(AdaptivePipelineCache& cache) {
+        while (cache.popitem().has_value()) {}
+    }
+
+    constexpr uint64_t KEY = 7;
+}
+
+TEST(SpillTierTest, TakePromotesAndRemoves) {
+    SpillTier spill{spill_path("take"), SPILL_CAPACITY};
+    spill.put(EntryData{7, 2.5, 100});
+
+    ASSERT_TRUE(spill.contains(7));
+    std::optional<EntryData> entry = spill.take(7);
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_EQ(entry->id, 7);
+    EXPECT_DOUBLE_EQ(entry->latency, 2.5);
+    EXPECT_EQ(entry->tokens, 100);
+
+    EXPECT_FALSE(spill.contains(7));
+    EXPECT_FALSE(spill.take(7).has_value());
+    EXPECT_EQ(spill.size(), 0);
+}
+
+TEST(SpillTierTest, EvictsOldestWhenTheLogWraps) {
+    SpillTier spill{spill_path("wrap"), SPILL_CAPACITY};
+    for (uint64_t id = 1; id <= SPILL_CAPACITY + 2; ++id) {
+        spill.put(EntryData{id, static_cast<double>(id), id});
+    }
+
+    EXPECT_EQ(spill.size(), SPILL_CAPACITY);
+    EXPECT_FALSE(spill.contains(1));
+    EXPECT_FALSE(spill.contains(2));
+    for (uint64_t id = 3; id <= SPILL_CAPACITY + 2; ++id) {
+        EXPECT_TRUE(spill.contains(id));
+    }
+}
+
+TEST(SpillTierTest, RespilledKeyKeepsLatestRecord) {
+    SpillTier spill{spill_path("respill"), SPILL_CAPACITY};
+    spill.put(EntryData{1, 1.0, 10});
+    spill.put(EntryData{2, 2.0, 20});
+    spill.put(EntryData{1, 3.0, 30});
+    EXPECT_EQ(spill.size(), 2);
+
+    // Wrapping over the dead record of key 1 must not drop its live one.
+    spill.put(EntryData{3, 4.0, 40});
+    spill.put(EntryData{4, 5.0, 50});
+    EXPECT_TRUE(spill.contains(1));
+    EXPECT_TRUE(spill.contains(2));
+
+    spill.put(EntryData{5, 6.0, 60});
+    EXPECT_TRUE(spill.contains(1));
+    EXPECT_FALSE(spill.contains(2));
+
+    std::optional<EntryData> entry = spill.take(1);
+    ASSERT_TRUE(entry.has_value());
+    EXPECT_DOUBLE_EQ(entry->latency, 3.0);
+    EXPECT_EQ(entry->tokens, 30);
+}
+
+TEST(SpillTierTest, EraseAndClear) {
+    SpillTier spill{spill_path("clear"), SPILL_CAPACITY};
+    spill.put(EntryData{1, 1.0, 10});
+    spill.put(EntryData{2, 2.0, 20});
+
+    spill.erase(1);
+    EXPECT_FALSE(spill.contains(1));
+    EXPECT_EQ(spill.size(), 1);
+
+    spill.clear();
+    EXPECT_EQ(spill.size(), 0);
+    spill.put(EntryData{3, 3.0, 30});
+    EXPECT_TRUE(spill.contains(3));
+}
+
+TEST(SpillTierTest, PoppedEntryIsPromotedBackOnAHit) {
+    AdaptivePipelineCache cache{spilling_cache_config("promote")};
+    cache.setitem(KEY, std::make_tuple(1.0, uint64_t{10}));
+    flood(cache);
+    pop_all(cache);
+
+    const std::optional<std::tuple<double, uint64_t>> value = cache.find(KEY);
+    ASSERT_TRUE(value.has_value());
+    EXPECT_EQ(std::get<1>(*value), 10);
+
+    EXPECT_TRUE(cache.delitem(KEY));
+    EXPECT_FALSE(cache.find(KEY).has_value());
+}
+
+TEST(SpillTierTest, QueuedEntryOfAResetKeyIsNotSpilled) {
+    AdaptivePipelineCache cache{spilling_cache_config("reset")};
+    cache.setitem(KEY, std::make_tuple(1.0, uint64_t{10}));
+    flood(cache);
+    cache.setitem(KEY, std::make_tuple(2.0, uint64_t{20}));
+    pop_all(cache);
+
+    std::optional<std::tuple<double, uint64_t>> value = cache.find(KEY);
+    ASSERT_TRUE(value.has_value());
+    EXPECT_EQ(std::get<1>(*value), 20);
+
+    // The older value was dropped rather than spilled, deleting the key leaves nothing behind.
+    EXPECT_TRUE(cache.delitem(KEY));
+    EXPECT_FALSE(cache.find(KEY).has_value());
+
+    // Evicted again, the newer value is popped first and spilled, the older one popped after it is dropped.
+    cache.setitem(KEY, std::make_tuple(1.0, uint64_t{10}));
+    flood(cache);
+    cache.setitem(KEY, std::make_tuple(2.0, uint64_t{20}));
+    flood(cache);
+    pop_all(cache);
+
+    value = cache.find(KEY);
+    ASSERT_TRUE(value.has_value());
+    EXPECT_EQ(std::get<1>(*value), 20);
+}
+
+TEST(SpillTierTest, SpilledKeyIsDeletedWithoutPromotingIt) {
+    AdaptivePipelineCache cache{spilling_cache_config("delete")};
+    cache.setitem(KEY, std::make_tuple(1.0, uint64_t{10}));
+    flood(cache);
+    pop_all(cache);
+
+    const std::vector<uint64_t> resident = cache.keys();
+    EXPECT_TRUE(cache.delitem(KEY));
+    EXPECT_EQ(cache.keys(), resident);
+    EXPECT_FALSE(cache.popitem().has_value());
+    EXPECT_FALSE(cache.find(KEY).has_value());
+    EXPECT_FALSE(cache.delitem(KEY));
+}
@@ -0,0 +1,85 @@
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include <gtest/gtest.h>
+#include "timer_wheel.hpp"
+
+namespace {
+    constexpr uint64_t START_MS = 1'000'000;
+
+    std::vector<uint64_t> collect(TimerWheel& wheel, uint64_t now_ms, uint64_t max_count = 1000) {
+        std::vector<uint64_t> expired;
+        wheel.collect_expired(now_ms, max_count, expired);
+        std::sort(expired.begin(), expired.end());
+        return expired;
+    }
+}
+
+TEST(TimerWheelTest, ExpiresOnlyPastDeadlines) {
+    TimerWheel wheel{START_MS};
+    wheel.schedule(1, START_MS + 10);
+    wheel.schedule(2, START_MS + 100);
+    wheel.schedule(3, START_MS + 5'000);
+
+    EXPECT_FALSE(wheel.is_expired(1, START_MS + 9));
+    EXPECT_TRUE(wheel.is_expired(1, START_MS + 10));
+    EXPECT_TRUE(collect(wheel, START_MS + 9).empty());
+
+    EXPECT_EQ(collect(wheel, START_MS + 10), std::vector<uint64_t>{1});
+    EXPECT_FALSE(wheel.has_deadline(1));
+    EXPECT_EQ(collect(wheel, START_MS + 4'999), std::vector<uint64_t>{2});
+    EXPECT_EQ(collect(wheel, START_MS + 5'000), std::vector<uint64_t>{3});
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, CascadesAcrossAllLevels) {
+    TimerWheel wheel{START_MS};
+    const std::vector<uint64_t> offsets = {1, 63, 64, 65, 4'095, 4'096, 262'143, 262'145,
+                                           16'777'217, 1'073'741'825, 68'719'476'737};
+    for (uint64_t i = 0; i < offsets.size(); ++i) {
+        wheel.schedule(i, START_MS + offsets[i]);
+    }
+
+    for (uint64_t i = 0; i < offsets.size(); ++i) {
+        EXPECT_TRUE(collect(wheel, START_MS + offsets[i] - 1).empty()) << "offset " << offsets[i];
+        EXPECT_EQ(collect(wheel, START_MS + offsets[i]), std::vector<uint64_t>{i}) << "offset " << offsets[i];
+    }
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, CancelledAndRescheduledKeys) {
+    TimerWheel wheel{START_MS};
+    wheel.schedule(1, START_MS + 50);
+    wheel.schedule(2, START_MS + 50);
+    wheel.schedule(3, START_MS + 50);
+
+    wheel.cancel(1);
+    wheel.schedule(2, START_MS + 500);
+
+    EXPECT_EQ(collect(wheel, START_MS + 100), std::vector<uint64_t>{3});
+    EXPECT_FALSE(wheel.is_expired(2, START_MS + 100));
+    EXPECT_EQ(collect(wheel, START_MS + 500), std::vector<uint64_t>{2});
+    EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, CollectsInBatches) {
+    TimerWheel wheel{START_MS};
+    for (uint64_t key = 0; key < 20; ++key) {
+        wheel.schedule(key, START_MS + 10 + key);
+    }
+
+    std::vector<uint64_t> expired;
+    wheel.collect_expired(START_MS + 1'000, 8, expired);
+    EXPECT_EQ(expired.size(), 8);
+    wheel.collect_expired(START_MS + 1'000, 8, expired);
+    EXPECT_EQ(expired.size(), 16);
+    wheel.collect_expired(START_MS + 1'000, 8, expired);
+    EXPECT_EQ(expired.size(), 20);
+
+    std::sort(expired.begin(), expired.end());
+    for (uint64_t key = 0; key < 20; ++key) {
+        EXPECT_EQ(expired[key], key);
+    }
+    EXPECT_TRUE(wheel.empty());
+}
@@ -0,0 +1,155 @@
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include "trace_capture.hpp"
+
+using CaptureOp = TraceCapture::Op;
+
+namespace {
+    // A flush interval no test waits for, partly filled buffers only reach the file on flush() or destruction.
+    constexpr uint64_t NO_PERIODIC_FLUSH_MS = 3600 * 1000;
+    constexpr uint64_t LARGE_FILE_BYTES = 64ULL << 20;
+
+    std::string capture_path(const std::string& name) {
+        const std::filesystem::path path = std::filesystem::temp_directory_path() / ("pipeline-cache-" + name + ".capture");
+        for (int idx = 0; idx < 4; ++idx) {
+            std::filesystem::remove(idx == 0 ? path.string() : path.string() + "." + std::to_string(idx));
+        }
+        return path.string();
+    }
+}
+
+TEST(TraceCaptureTest, KeepsTheOrderOfEveryThread) {
+    const std::string path = capture_path("threads");
+    constexpr uint64_t NUM_OF_THREADS = 4;
+    constexpr uint64_t RECORDS_PER_THREAD = 3 * TraceCapture::BUFFER_RECORDS + 10;
+    {
+        TraceCapture capture{path, LARGE_FILE_BYTES, 2, NO_PERIODIC_FLUSH_MS};
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < NUM_OF_THREADS; ++t) {
+            threads.emplace_back([&capture, t]() {
+                for (uint64_t i = 0; i < RECORDS_PER_THREAD; ++i) {
+                    capture.record(i % 2 == 0 ? CaptureOp::LOOKUP : CaptureOp::SETITEM, t, static_cast<double>(i), 1, false);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        capture.flush();
+        EXPECT_EQ(capture.dropped(), 0);
+    }
+
+    const std::vector<TraceCapture::Record> records = TraceCapture::read_file(path);
+    ASSERT_EQ(records.size(), NUM_OF_THREADS * RECORDS_PER_THREAD);
+    std::vector<double> last_latency(NUM_OF_THREADS, -1.0);
+    for (const TraceCapture::Record& record : records) {
+        ASSERT_LT(record.key, NUM_OF_THREADS);
+        EXPECT_DOUBLE_EQ(record.latency, last_latency[record.key] + 1);
+        last_latency[record.key] = record.latency;
+    }
+}
+
+TEST(TraceCaptureTest, RotatesWithinTheSizeCap) {
+    const std::string path = capture_path("rotation");
+    constexpr uint64_t RECORDS_PER_FILE = 99;
+    constexpr uint64_t FILE_BYTES = (RECORDS_PER_FILE + 1) * sizeof(TraceCapture::Record);
+    constexpr uint64_t NUM_OF_RECORDS = 1000;
+    {
+        TraceCapture capture{path, FILE_BYTES, 3, NO_PERIODIC_FLUSH_MS};
+        for (uint64_t key = 0; key < NUM_OF_RECORDS; ++key) {
+            capture.record(CaptureOp::LOOKUP, key, 0.0, 0, false);
+        }
+    }
+
+    EXPECT_FALSE(std::filesystem::exists(path + ".3"));
+    for (const std::string& file : {path, path + ".1", path + ".2"}) {
+        EXPECT_LE(std::filesystem::file_size(file), FILE_BYTES);
+    }
+
+    // The rotated files concatenated oldest first read as the last records, in order.
+    const std::string joined = capture_path("rotation-joined");
+    {
+        std::ofstream out(joined, std::ios::binary);
+        for (const std::string& file : {path + ".2", path + ".1", path}) {
+            std::ifstream in(file, std::ios::binary);
+            out << in.rdbuf();
+        }
+    }
+    const std::vector<TraceCapture::Record> records = TraceCapture::read_file(joined);
+    ASSERT_FALSE(records.empty());
+    EXPECT_EQ(records.back().key, NUM_OF_RECORDS - 1);
+    for (size_t idx = 1; idx < records.size(); ++idx) {
+        EXPECT_EQ(records[idx].key, records[idx - 1].key + 1);
+    }
+}
+
+TEST(TraceCaptureTest, KeepsAPreviousCapture) {
+    const std::string path = capture_path("previous");
+    {
+        TraceCapture capture{path, LARGE_FILE_BYTES, 2, NO_PERIODIC_FLUSH_MS};
+        capture.record(CaptureOp::SETITEM, 7, 1.5, 10, false);
+    }
+    {
+        TraceCapture capture{path, LARGE_FILE_BYTES, 2, NO_PERIODIC_FLUSH_MS};
+        capture.record(CaptureOp::LOOKUP, 7, 1.5, 10, true);
+    }
+
+    const std::vector<TraceCapture::Record> previous = TraceCapture::read_file(path + ".1");
+    ASSERT_EQ(previous.size(), 1);
+    EXPECT_EQ(previous[0].op, CaptureOp::SETITEM);
+    EXPECT_EQ(previous[0].tokens, 10);
+
+    const std::vector<TraceCapture::Record> current = TraceCapture::read_file(path);
+    ASSERT_EQ(current.size(), 1);
+    EXPECT_EQ(current[0].op, CaptureOp::LOOKUP);
+    EXPECT_EQ(current[0].hit, 1);
+
+    // With a single file, the previous capture would be truncated.
+    EXPECT_THROW((TraceCapture{path, LARGE_FILE_BYTES, 1, NO_PERIODIC_FLUSH_MS}), std::invalid_argument);
+    EXPECT_EQ(TraceCapture::read_file(path + ".1").size(), 1);
+}
+
+TEST(TraceCaptureTest, ForkedChildCapturesToAFileOfItsOwn) {
+    const std::string path = capture_path("fork");
+    auto capture = std::make_unique<TraceCapture>(path, LARGE_FILE_BYTES, 2, NO_PERIODIC_FLUSH_MS);
+    // Still buffered at the fork, it is the parent's to write.
+    capture->record(CaptureOp::SETITEM, 1, 1.5, 10, false);
+
+    const pid_t pid = fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0) {
+        capture->record(CaptureOp::LOOKUP, 2, 0.0, 0, false);
+        // Joins the child's own writer.
+        capture.reset();
+        std::_Exit(0);
+    }
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    ASSERT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+
+    capture->record(CaptureOp::LOOKUP, 1, 1.5, 10, true);
+    capture.reset();
+
+    const std::vector<TraceCapture::Record> records = TraceCapture::read_file(path);
+    ASSERT_EQ(records.size(), 2);
+    EXPECT_EQ(records[0].op, CaptureOp::SETITEM);
+    EXPECT_EQ(records[1].hit, 1);
+
+    const std::string child_path = path + "." + std::to_string(pid);
+    const std::vector<TraceCapture::Record> child_records = TraceCapture::read_file(child_path);
+    ASSERT_EQ(child_records.size(), 1);
+    EXPECT_EQ(child_records[0].key, 2);
+    std::filesystem::remove(child_path);
+}
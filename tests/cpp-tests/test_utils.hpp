@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+// Payloads are counters of the references held on them.
+inline void retain(void* payload) { ++*static_cast<int*>(payload); }
+inline void release(void* payload) { --*static_cast<int*>(payload); }
+
+// A two-block config of the given capacity, over 4 quanta and without sampling. The tests add the sections
+// they exercise, e.g. "spill" or "cost", to the config returned.
+inline nlohmann::json cache_config(uint64_t capacity,
+                                   const std::string& first_block = "fifo",
+                                   const std::string& second_block = "alru",
+                                   uint64_t first_block_quanta = 2)
+{
+    return {
+        {"cache", {{"capacity", capacity}, {"num_of_quanta", 4}, {"num_of_blocks", 2}, {"sample_rate", 1},
+                   {"decision_window_multiplier", 10}, {"aging_window_multiplier", 10}, {"seed", 42},
+                   {"sample_size", 8}}},
+        {"count_min_sketch", {{"error", 0.01}, {"probability", 0.99}}},
+        {"blocks", nlohmann::json::array({{{"type", first_block}, {"initial_quanta", first_block_quanta}},
+                                          {{"type", second_block}, {"initial_quanta", 4 - first_block_quanta}}})}
+    };
+}
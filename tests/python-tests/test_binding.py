@@ -0,0 +1,171 @@
+import collections.abc
+import json
+import sys
+import threading
+
+import pytest
+
+# These tests need the built extension, unlike those of loading.py. The package raises a plain ImportError without it.
+try:
+    from adaptive_pipeline import AdaptivePipelineCache, get_default_config_path
+except ImportError as error:
+    pytest.skip(f"the C++ extension isn't built: {error}", allow_module_level=True)
+
+NUM_OF_THREADS = 8
+OPS_PER_THREAD = 2000
+
+
+def write_config(tmp_path, **cache_settings):
+    with open(get_default_config_path()) as file:
+        config = json.load(file)
+    config["cache"].update(cache_settings)
+    path = tmp_path / "config.json"
+    path.write_text(json.dumps(config))
+    return str(path)
+
+
+@pytest.fixture
+def cache():
+    return AdaptivePipelineCache(get_default_config_path())
+
+
+@pytest.fixture(params=[False, True], ids=["fingerprints", "verified"])
+def keyed_cache(request, tmp_path):
+    return AdaptivePipelineCache(write_config(tmp_path, verify_keys=request.param)), request.param
+
+
+def test_is_a_mutable_mapping(cache):
+    assert isinstance(cache, collections.abc.MutableMapping)
+    assert isinstance(cache, collections.abc.Mapping)
+
+
+def test_item_access(cache):
+    cache[1] = (2.5, 10)
+    assert cache[1] == (2.5, 10)
+    assert 1 in cache
+    assert list(cache) == [1]
+    assert len(cache) == 1
+
+    del cache[1]
+    assert 1 not in cache
+    with pytest.raises(KeyError):
+        cache[1]
+    with pytest.raises(KeyError):
+        del cache[1]
+
+
+def test_invalid_keys_and_values(cache):
+    with pytest.raises(ValueError):
+        cache[-1] = (1.0, 1)
+    with pytest.raises(ValueError):
+        cache[1.5] = (1.0, 1)
+    with pytest.raises(ValueError):
+        cache[1] = (1.0,)
+    with pytest.raises(ValueError):
+        cache[1] = (1.0, -1)
+    assert -1 not in cache
+    assert cache.get(1.5) is None
+
+
+def test_get(cache):
+    assert cache.get(1) is None
+    assert cache.get(1, (0.0, 0)) == (0.0, 0)
+    cache[1] = (1.0, 2)
+    assert cache.get(1) == (1.0, 2)
+
+
+def test_pop(cache):
+    cache[1] = (1.0, 2)
+    assert cache.pop(1) == (1.0, 2)
+    assert 1 not in cache
+    assert cache.pop(1, None) is None
+    with pytest.raises(KeyError):
+        cache.pop(1)
+
+
+def test_setdefault(cache):
+    assert cache.setdefault(1, (1.0, 2)) == (1.0, 2)
+    assert cache.setdefault(1, (3.0, 4)) == (1.0, 2)
+    assert cache[1] == (1.0, 2)
+
+
+def test_update_and_get_many(cache):
+    cache.update({1: (1.0, 1), 2: (2.0, 2)})
+    cache.update([(3, (3.0, 3))])
+
+    assert cache.get_many([1, 2, 3, 4]) == [(1.0, 1), (2.0, 2), (3.0, 3), None]
+    assert cache.get_many([4, -1, "missing"], (0.0, 0)) == [(0.0, 0)] * 3
+
+    # A pair that can't be converted stores none of the batch.
+    with pytest.raises(ValueError):
+        cache.update({5: (5.0, 5), 6: "not a value"})
+    assert 5 not in cache
+
+
+def test_payload_is_stored_and_released(cache):
+    payload = object()
+    refs = sys.getrefcount(payload)
+    cache[1] = (1.0, 2, payload)
+    assert cache[1][2] is payload
+    assert cache.pop(1)[2] is payload
+    assert sys.getrefcount(payload) == refs
+
+    cache[1] = (1.0, 2, payload)
+    cache.clear()
+    assert sys.getrefcount(payload) == refs
+
+
+def test_str_and_bytes_keys(keyed_cache):
+    cache, verifies_keys = keyed_cache
+    cache["prompt"] = (1.0, 2)
+    assert cache["prompt"] == (1.0, 2)
+    # str keys are hashed as their UTF-8 bytes.
+    assert cache[b"prompt"] == (1.0, 2)
+    assert "other prompt" not in cache
+
+    # Iterating yields the ids, the fingerprints of the keys. Looked up as an integer, the id of a str key only hits
+    # when the full keys aren't verified.
+    (fingerprint,) = list(cache)
+    assert (fingerprint in cache) != verifies_keys
+
+    assert cache.pop("prompt") == (1.0, 2)
+    assert "prompt" not in cache
+
+
+def test_concurrent_callers(cache):
+    errors = []
+    payloads = [object() for _ in range(NUM_OF_THREADS)]
+    refs = [sys.getrefcount(payload) for payload in payloads]
+    barrier = threading.Barrier(NUM_OF_THREADS)
+
+    def work(thread_idx):
+        try:
+            barrier.wait()
+            for op in range(OPS_PER_THREAD):
+                key = (op * 7 + thread_idx) % 256
+                cache[key] = (float(key), key, payloads[thread_idx])
+                value = cache.get(key)
+                # Another thread may have set the key since, with its own payload, but never other costs.
+                assert value is None or value[:2] == (float(key), key)
+                if op % 3 == 0:
+                    cache.pop(key, None)
+                if op % 5 == 0:
+                    cache.get_many([key, key + 1, "str key"])
+                if op % 7 == 0:
+                    try:
+                        cache.popitem()
+                    except KeyError:
+                        pass
+        except BaseException as error:
+            errors.append(error)
+
+    threads = [threading.Thread(target=work, args=(idx,)) for idx in range(NUM_OF_THREADS)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    assert not errors
+    assert len(cache) <= cache.maxsize
+    cache.clear()
+    assert [sys.getrefcount(payload) for payload in payloads] == refs
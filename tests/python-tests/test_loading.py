@@ -0,0 +1,291 @@
+import asyncio
+import importlib.util
+import threading
+import time
+from pathlib import Path
+
+import pytest
+
+# Loaded by its path, the package imports the C++ extension, which these tests don't need.
+_spec = importlib.util.spec_from_file_location(
+    "adaptive_pipeline_loading", Path(__file__).resolve().parents[2] / "adaptive_pipeline" / "loading.py")
+loading = importlib.util.module_from_spec(_spec)
+_spec.loader.exec_module(loading)
+
+NUM_OF_WAITERS = 8
+
+
+class DictCache(dict):
+    """Looks the keys up like the cache, and counts the misses. Hashed by identity, like the cache."""
+
+    __hash__ = object.__hash__
+    __eq__ = object.__eq__
+
+    def __init__(self):
+        super().__init__()
+        self.misses = 0
+        self._misses_lock = threading.Lock()
+
+    def get(self, key, default=None):
+        value = super().get(key, default)
+        if value is None:
+            with self._misses_lock:
+                self.misses += 1
+        return value
+
+
+class BlockingLoader:
+    """Blocks every load until released, the load then returns its tokens or raises the error."""
+
+    def __init__(self, tokens=10, error=None):
+        self.tokens = tokens
+        self.error = error
+        self.calls = 0
+        self.started = threading.Event()
+        self.released = threading.Event()
+
+    def __call__(self, key):
+        self.calls += 1
+        self.started.set()
+        assert self.released.wait(timeout=10)
+        if self.error is not None:
+            raise self.error
+        return self.tokens
+
+
+def _run_in_threads(cache, key, loader):
+    """Starts a loading thread and NUM_OF_WAITERS threads that miss while it loads, then releases the load."""
+    results = [None] * (NUM_OF_WAITERS + 1)
+
+    def call(idx):
+        try:
+            results[idx] = loading.get_or_load(cache, key, loader)
+        except BaseException as error:
+            results[idx] = error
+
+    threads = [threading.Thread(target=call, args=(idx,)) for idx in range(NUM_OF_WAITERS + 1)]
+    threads[0].start()
+    assert loader.started.wait(timeout=10)
+    for thread in threads[1:]:
+        thread.start()
+    deadline = time.monotonic() + 10
+    while cache.misses < NUM_OF_WAITERS + 1 and time.monotonic() < deadline:
+        time.sleep(0.001)
+    # Past their miss, the waiters only take the lock of the flights before waiting for the load.
+    time.sleep(0.1)
+    loader.released.set()
+    for thread in threads:
+        thread.join(timeout=10)
+        assert not thread.is_alive()
+    return results
+
+
+def _in_flight(cache):
+    return loading._flights[cache][1]
+
+
+def _async_in_flight(cache):
+    return loading._async_flights[cache]
+
+
+def test_concurrent_misses_share_one_load():
+    cache = DictCache()
+    loader = BlockingLoader(tokens=10)
+
+    results = _run_in_threads(cache, "key", loader)
+
+    assert loader.calls == 1
+    assert all(result is results[0] for result in results)
+    latency, tokens = results[0]
+    assert latency >= 0.1
+    assert tokens == 10
+    assert cache["key"] is results[0]
+    assert not _in_flight(cache)
+
+
+def test_hit_does_not_load():
+    cache = DictCache()
+    cache["key"] = (1.0, 5)
+
+    assert loading.get_or_load(cache, "key", pytest.fail) == (1.0, 5)
+
+
+def test_payload_is_cached_next_to_the_costs():
+    cache = DictCache()
+    payload = object()
+
+    latency, tokens, cached = loading.get_or_load(cache, "key", lambda key: (7, payload))
+
+    assert tokens == 7
+    assert cached is payload
+    assert cache["key"][2] is payload
+
+
+def test_waiters_share_the_exception_of_the_load():
+    cache = DictCache()
+    error = ValueError("load failed")
+    loader = BlockingLoader(error=error)
+
+    results = _run_in_threads(cache, "key", loader)
+
+    assert loader.calls == 1
+    assert all(result is error for result in results)
+    assert "key" not in cache
+
+
+def test_failed_load_leaves_no_flight_behind():
+    cache = DictCache()
+
+    def failing_loader(key):
+        raise ValueError("load failed")
+
+    with pytest.raises(ValueError):
+        loading.get_or_load(cache, "key", failing_loader)
+    assert not _in_flight(cache)
+    assert "key" not in cache
+
+    # The exception isn't cached, the next miss loads again.
+    assert loading.get_or_load(cache, "key", lambda key: 3)[1] == 3
+
+
+def test_loader_looking_its_own_key_up_raises():
+    cache = DictCache()
+
+    def reentrant_loader(key):
+        return loading.get_or_load(cache, key, reentrant_loader)[1]
+
+    with pytest.raises(RuntimeError, match="its own key"):
+        loading.get_or_load(cache, "key", reentrant_loader)
+    assert not _in_flight(cache)
+    assert "key" not in cache
+
+
+def test_loader_may_load_other_keys():
+    cache = DictCache()
+
+    def nested_loader(key):
+        if key == "outer":
+            return loading.get_or_load(cache, "inner", nested_loader)[1] + 1
+        return 1
+
+    assert loading.get_or_load(cache, "outer", nested_loader)[1] == 2
+    assert cache["inner"][1] == 1
+    # The flight is no longer being loaded by this thread once its load is done.
+    assert loading._loading.get() == frozenset()
+
+
+def test_async_concurrent_misses_share_one_load():
+    cache = DictCache()
+    calls = 0
+
+    async def loader(key):
+        nonlocal calls
+        calls += 1
+        await asyncio.sleep(0.01)
+        return 10
+
+    async def main():
+        return await asyncio.gather(*(loading.get_or_load_async(cache, "key", loader)
+                                      for _ in range(NUM_OF_WAITERS + 1)))
+
+    results = asyncio.run(main())
+
+    assert calls == 1
+    assert all(result is results[0] for result in results)
+    assert results[0][1] == 10
+    assert cache["key"] is results[0]
+    assert not _async_in_flight(cache)
+
+
+def test_async_waiters_share_the_exception_of_the_load():
+    cache = DictCache()
+    error = ValueError("load failed")
+    calls = 0
+
+    async def loader(key):
+        nonlocal calls
+        calls += 1
+        await asyncio.sleep(0.01)
+        raise error
+
+    async def main():
+        return await asyncio.gather(*(loading.get_or_load_async(cache, "key", loader)
+                                      for _ in range(NUM_OF_WAITERS + 1)), return_exceptions=True)
+
+    results = asyncio.run(main())
+
+    assert calls == 1
+    assert all(result is error for result in results)
+    assert "key" not in cache
+    assert not _async_in_flight(cache)
+
+
+def test_async_failed_load_leaves_no_flight_behind():
+    cache = DictCache()
+
+    async def failing_loader(key):
+        raise ValueError("load failed")
+
+    async def loader(key):
+        return 3
+
+    async def main():
+        with pytest.raises(ValueError):
+            await loading.get_or_load_async(cache, "key", failing_loader)
+        assert not _async_in_flight(cache)
+        return await loading.get_or_load_async(cache, "key", loader)
+
+    assert asyncio.run(main())[1] == 3
+
+
+def test_async_cancelled_waiter_does_not_cancel_the_load():
+    cache = DictCache()
+    calls = 0
+    release = None
+
+    async def loader(key):
+        nonlocal calls
+        calls += 1
+        await release.wait()
+        return 10
+
+    async def main():
+        nonlocal release
+        release = asyncio.Event()
+        first = asyncio.ensure_future(loading.get_or_load_async(cache, "key", loader))
+        second = asyncio.ensure_future(loading.get_or_load_async(cache, "key", loader))
+        await asyncio.sleep(0)
+        # The task that started the load is cancelled too, the load goes on for the other waiter.
+        first.cancel()
+        await asyncio.sleep(0)
+        release.set()
+        with pytest.raises(asyncio.CancelledError):
+            await first
+        return await second
+
+    result = asyncio.run(main())
+
+    assert calls == 1
+    assert result[1] == 10
+    assert cache["key"] is result
+    assert not _async_in_flight(cache)
+
+
+def test_async_loader_looking_its_own_key_up_raises():
+    cache = DictCache()
+
+    async def reentrant_loader(key):
+        return (await loading.get_or_load_async(cache, key, reentrant_loader))[1]
+
+    async def subtask_loader(key):
+        lookup = asyncio.ensure_future(loading.get_or_load_async(cache, key, subtask_loader))
+        return (await lookup)[1]
+
+    async def main():
+        for loader in (reentrant_loader, subtask_loader):
+            with pytest.raises(RuntimeError, match="its own key"):
+                await asyncio.wait_for(loading.get_or_load_async(cache, "key", loader), timeout=10)
+            assert not _async_in_flight(cache)
+
+    asyncio.run(main())
+    assert "key" not in cache
@@ -0,0 +1,174 @@
+// Decodes an event log written by the cache, see EventLog, one event per line.
+//
+// event_log_decode <path> [--format text|csv]
+//
+// Blocks are printed by their index in the config, ghosts by their index in the ghost caches,
+// which go over every (src, dest) pair of blocks in order.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+
+#include "event_log.hpp"
+
+namespace {
+    std::string block_name(uint32_t block)
+    {
+        return block == EventLog::NO_BLOCK ? "-" : std::to_string(block);
+    }
+
+    std::string quanta_list(const EventLog::Record& record, const char* separator)
+    {
+        std::string res;
+        for (uint16_t idx = 0; idx < record.num_of_blocks; ++idx)
+        {
+            res += (idx == 0 ? "" : separator) + std::to_string(record.quanta[idx]);
+        }
+
+        return res;
+    }
+
+    void print_text(const EventLog::Record& record)
+    {
+        const auto type = static_cast<size_t>(record.type);
+        std::cout << record.sequence << ' ' << record.time_ms << ' '
+                  << (type < EventLog::EVENT_NAMES.size() ? EventLog::EVENT_NAMES[type] : "unknown");
+
+        switch (record.type)
+        {
+            case EventLog::EventType::GHOST_COST:
+                std::cout << " ghost=" << record.ghost << " move=" << block_name(record.src_block)
+                          << "->" << block_name(record.dest_block) << " cost=" << record.costs[0];
+                break;
+            case EventLog::EventType::DECISION:
+                std::cout << " current_cost=" << record.costs[0] << " best_ghost=" << record.ghost
+                          << " best_ghost_cost=" << record.costs[1];
+                if (record.src_block == EventLog::NO_BLOCK)
+                {
+                    std::cout << " kept";
+                }
+                else
+                {
+                    std::cout << " move=" << record.src_block << "->" << record.dest_block;
+                }
+                break;
+            case EventLog::EventType::QUANTUM_MOVE:
+                std::cout << " move=" << record.src_block << "->" << record.dest_block
+                          << " quanta=[" << quanta_list(record, ",") << ']';
+                break;
+            case EventLog::EventType::DROPPED:
+                std::cout << " count=" << record.ghost;
+                break;
+            case EventLog::EventType::SKETCH_AGING:
+            default:
+                break;
+        }
+        std::cout << '\n';
+    }
+
+    std::string csv_cost(double cost)
+    {
+        std::ostringstream res;
+        res << cost;
+        return res.str();
+    }
+
+    void print_csv(const EventLog::Record& record)
+    {
+        const auto type = static_cast<size_t>(record.type);
+        std::string current_cost;
+        std::string ghost_cost;
+        if (record.type == EventLog::EventType::GHOST_COST)
+        {
+            ghost_cost = csv_cost(record.costs[0]);
+        }
+        else if (record.type == EventLog::EventType::DECISION)
+        {
+            current_cost = csv_cost(record.costs[0]);
+            ghost_cost = csv_cost(record.costs[1]);
+        }
+
+        std::cout << record.sequence << ',' << record.time_ms << ','
+                  << (type < EventLog::EVENT_NAMES.size() ? EventLog::EVENT_NAMES[type] : "unknown") << ','
+                  << (record.ghost == EventLog::NO_BLOCK ? "" : std::to_string(record.ghost)) << ','
+                  << (record.src_block == EventLog::NO_BLOCK ? "" : std::to_string(record.src_block)) << ','
+                  << (record.dest_block == EventLog::NO_BLOCK ? "" : std::to_string(record.dest_block)) << ','
+                  << current_cost << ',' << ghost_cost << ','
+                  << quanta_list(record, " ") << '\n';
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string path;
+    std::string format = "text";
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc)
+        {
+            format = argv[++i];
+        }
+        else if (path.empty() && arg.rfind("--", 0) != 0)
+        {
+            path = arg;
+        }
+        else
+        {
+            path.clear();
+            break;
+        }
+    }
+
+    if (path.empty() || (format != "text" && format != "csv"))
+    {
+        std::cerr << "usage: event_log_decode <path> [--format text|csv]" << std::endl;
+        return 1;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        std::cerr << "failed to open " << path << std::endl;
+        return 1;
+    }
+
+    EventLog::FileHeader header{};
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || header.magic != EventLog::MAGIC
+        || header.version != EventLog::VERSION
+        || header.record_size != sizeof(EventLog::Record))
+    {
+        std::cerr << path << " is not an event log of version " << EventLog::VERSION << std::endl;
+        return 1;
+    }
+
+    if (format == "csv")
+    {
+        std::cout << "sequence,time_ms,event,ghost,src_block,dest_block,current_cost,ghost_cost,quanta\n";
+    }
+
+    EventLog::Record record{};
+    while (file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    {
+        if (format == "csv")
+        {
+            print_csv(record);
+        }
+        else
+        {
+            print_text(record);
+        }
+    }
+
+    if (file.gcount() != 0)
+    {
+        std::cerr << "the log ends with a partial record" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
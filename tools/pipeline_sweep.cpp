@@ -0,0 +1,398 @@
+// Offline config sweep: replays one trace against every config of a grid, in parallel, and reports
+// the hit ratio, average cost and throughput of each config.
+//
+// pipeline_sweep --trace input.trace --config config.json --grid grid.json [--threads N] [--format csv|json] [--output path]
+//
+// The trace has one request per line: "timestamp key latency tokens", as used by the sanity test,
+// or is a file written by the cache's capture mode, or several of its rotated files concatenated oldest first.
+// The grid is a JSON object mapping dotted paths of the config to the values to try, e.g.
+//   {"cache.num_of_quanta": [8, 16], "cache.sample_rate": [4, 8], "blocks": [[...], [...]]}
+// and the cartesian product of all of them is applied on top of the base config.
+// An invalid config in the grid stops the sweep, with the same message as when creating the cache.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+#include "adaptive_pipeline_cache.hpp"
+
+namespace {
+    struct Request
+    {
+        uint64_t key;
+        double latency;
+        uint64_t tokens;
+    };
+
+    struct SweepResult
+    {
+        Json overrides;
+        double hit_ratio = 0;
+        double avg_cost = 0;
+        double ops_per_sec = 0;
+    };
+
+    struct Options
+    {
+        std::string trace_path;
+        std::string config_path;
+        std::string grid_path;
+        std::string output_path;
+        std::string format = "csv";
+        unsigned threads = std::thread::hardware_concurrency();
+    };
+
+    void print_usage()
+    {
+        std::cerr << "usage: pipeline_sweep --trace <path> --config <path> --grid <path>"
+                     " [--threads N] [--format csv|json] [--output path]" << std::endl;
+    }
+
+    bool parse_options(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                return false;
+            }
+
+            const std::string value = argv[++i];
+            if (arg == "--trace") options.trace_path = value;
+            else if (arg == "--config") options.config_path = value;
+            else if (arg == "--grid") options.grid_path = value;
+            else if (arg == "--output") options.output_path = value;
+            else if (arg == "--format") options.format = value;
+            else if (arg == "--threads") options.threads = static_cast<unsigned>(std::stoul(value));
+            else return false;
+        }
+
+        return !options.trace_path.empty() && !options.config_path.empty() && !options.grid_path.empty()
+               && (options.format == "csv" || options.format == "json");
+    }
+
+    // A captured lookup becomes a request of the trace, a hit with the costs it found and a miss with the costs set for
+    // the key after it. Setitems only provide these costs, as the replay sets every miss itself, and a miss whose key
+    // is never set afterwards is left out.
+    bool load_capture(const std::string& path, std::vector<Request>& trace)
+    {
+        std::vector<TraceCapture::Record> records;
+        try {
+            records = TraceCapture::read_file(path);
+        }
+        catch (const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return false;
+        }
+
+        std::unordered_map<uint64_t, std::pair<double, uint64_t>> next_costs;
+        uint64_t unresolved_misses = 0;
+        for (auto it = records.rbegin(); it != records.rend(); ++it)
+        {
+            if (it->op == TraceCapture::Op::SETITEM || it->hit != 0)
+            {
+                next_costs[it->key] = std::make_pair(it->latency, static_cast<uint64_t>(it->tokens));
+            }
+            if (it->op != TraceCapture::Op::LOOKUP)
+            {
+                continue;
+            }
+
+            const auto costs = next_costs.find(it->key);
+            if (costs == next_costs.end())
+            {
+                ++unresolved_misses;
+                continue;
+            }
+            trace.push_back(Request{it->key, costs->second.first, costs->second.second});
+        }
+        std::reverse(trace.begin(), trace.end());
+
+        if (unresolved_misses > 0)
+        {
+            std::cerr << "Note: " << unresolved_misses << " captured misses were never set and are left out" << std::endl;
+        }
+
+        return true;
+    }
+
+    bool load_trace(const std::string& path, std::vector<Request>& trace)
+    {
+        if (TraceCapture::is_capture_file(path))
+        {
+            return load_capture(path, trace);
+        }
+
+        std::ifstream ifs(path);
+        if (!ifs.is_open())
+        {
+            std::cerr << "Error: Could not open trace file " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        uint64_t line_count = 0;
+        while (std::getline(ifs, line))
+        {
+            ++line_count;
+            std::stringstream ss(line);
+            uint64_t timestamp;
+            Request request{};
+            if (!(ss >> timestamp >> request.key >> request.latency >> request.tokens))
+            {
+                std::cerr << "Error parsing line " << line_count << ": '" << line << "'" << std::endl;
+                return false;
+            }
+            trace.push_back(request);
+        }
+
+        return true;
+    }
+
+    // "cache.sample_rate" -> "/cache/sample_rate"
+    Json::json_pointer to_pointer(const std::string& dotted_path)
+    {
+        std::string pointer = "/" + dotted_path;
+        for (char& c : pointer)
+        {
+            if (c == '.')
+            {
+                c = '/';
+            }
+        }
+        return Json::json_pointer(pointer);
+    }
+
+    // Every combination of the grid values, as a flat object of dotted path -> value.
+    std::vector<Json> expand_grid(const Json& grid)
+    {
+        std::vector<Json> combinations{Json::object()};
+        for (const auto& [path, values] : grid.items())
+        {
+            if (!values.is_array() || values.empty())
+            {
+                std::cerr << "Error: The grid entry " << path << " must be a non-empty array" << std::endl;
+                exit(1);
+            }
+
+            std::vector<Json> expanded;
+            expanded.reserve(combinations.size() * values.size());
+            for (const Json& combination : combinations)
+            {
+                for (const Json& value : values)
+                {
+                    Json next = combination;
+                    next[path] = value;
+                    expanded.push_back(std::move(next));
+                }
+            }
+            combinations = std::move(expanded);
+        }
+
+        return combinations;
+    }
+
+    // A grid over num_of_quanta alone would leave the initial quanta of the base blocks summing to the old value,
+    // so they are scaled to the new one, the rounding remainder going to the last block.
+    void fit_initial_quanta(Json& config)
+    {
+        const uint64_t num_of_quanta = config["cache"]["num_of_quanta"].get<uint64_t>();
+        uint64_t total_quanta = 0;
+        for (const Json& block : config["blocks"])
+        {
+            total_quanta += block["initial_quanta"].get<uint64_t>();
+        }
+        if (total_quanta == num_of_quanta || total_quanta == 0 || config["blocks"].empty())
+        {
+            return;
+        }
+
+        uint64_t assigned_quanta = 0;
+        for (Json& block : config["blocks"])
+        {
+            const uint64_t quanta = block["initial_quanta"].get<uint64_t>() * num_of_quanta / total_quanta;
+            block["initial_quanta"] = quanta;
+            assigned_quanta += quanta;
+        }
+        Json& last_block = config["blocks"].back();
+        last_block["initial_quanta"] = last_block["initial_quanta"].get<uint64_t>() + num_of_quanta - assigned_quanta;
+    }
+
+    // The same replay loop as the sanity test: a miss is set, and whatever the policies evicted is popped.
+    SweepResult replay(const Json& base_config, const Json& overrides, const std::vector<Request>& trace)
+    {
+        Json config = base_config;
+        for (const auto& [path, value] : overrides.items())
+        {
+            config[to_pointer(path)] = value;
+        }
+        if (!overrides.contains("blocks"))
+        {
+            fit_initial_quanta(config);
+        }
+
+        // The cost of the misses is the one the cache optimises, the config's cost model.
+        const CostModel cost_model = PipelineCache::parse_cost_model(config);
+        AdaptivePipelineCache cache(std::move(config));
+
+        uint64_t hits = 0;
+        double cost = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (const Request& request : trace)
+        {
+            if (cache.find(request.key).has_value())
+            {
+                ++hits;
+                continue;
+            }
+
+            cost += cost::evaluate(cost_model, request.latency, request.tokens);
+            cache.setitem(request.key, std::make_tuple(request.latency, request.tokens));
+            while (cache.popitem().has_value()) {}
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const auto num_of_requests = static_cast<double>(trace.size());
+        return SweepResult{overrides,
+                           static_cast<double>(hits) / num_of_requests,
+                           cost / num_of_requests,
+                           num_of_requests / elapsed.count()};
+    }
+
+    void write_csv(std::ostream& os, const Json& grid, const std::vector<SweepResult>& results)
+    {
+        for (const auto& [path, values] : grid.items())
+        {
+            os << path << ",";
+        }
+        os << "hit_ratio,avg_cost,ops_per_sec\n";
+
+        for (const SweepResult& result : results)
+        {
+            for (const auto& [path, values] : grid.items())
+            {
+                // Values that are not scalars (e.g. a block line-up) are quoted JSON.
+                const Json& value = result.overrides[path];
+                if (value.is_primitive())
+                {
+                    os << value.dump() << ",";
+                }
+                else
+                {
+                    std::string dumped = value.dump();
+                    std::string escaped;
+                    for (char c : dumped)
+                    {
+                        escaped += c == '"' ? std::string("\"\"") : std::string(1, c);
+                    }
+                    os << "\"" << escaped << "\",";
+                }
+            }
+            os << result.hit_ratio << "," << result.avg_cost << "," << static_cast<uint64_t>(result.ops_per_sec) << "\n";
+        }
+    }
+
+    void write_json(std::ostream& os, const std::vector<SweepResult>& results)
+    {
+        Json table = Json::array();
+        for (const SweepResult& result : results)
+        {
+            table.push_back(Json{{"config", result.overrides},
+                                 {"hit_ratio", result.hit_ratio},
+                                 {"avg_cost", result.avg_cost},
+                                 {"ops_per_sec", result.ops_per_sec}});
+        }
+        os << table.dump(2) << "\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        print_usage();
+        return 1;
+    }
+
+    std::vector<Request> trace;
+    if (!load_trace(options.trace_path, trace))
+    {
+        return 1;
+    }
+    if (trace.empty())
+    {
+        std::cerr << "Error: The trace is empty" << std::endl;
+        return 1;
+    }
+
+    Json base_config = PipelineCache::load_config(options.config_path);
+    // Every simulated cache must be private to its thread, so the shared and spill tiers are left out,
+    // as are the files the cache would write.
+    base_config.erase("shared");
+    base_config.erase("spill");
+    base_config.erase("capture");
+    base_config.erase("event_log");
+
+    const Json grid = PipelineCache::load_config(options.grid_path);
+    if (!grid.is_object())
+    {
+        std::cerr << "Error: The grid must be a JSON object" << std::endl;
+        return 1;
+    }
+    const std::vector<Json> combinations = expand_grid(grid);
+
+    // The trace is decoded once and only read by the workers, each of which picks the next config to replay.
+    std::vector<SweepResult> results(combinations.size());
+    std::atomic<size_t> next_config{0};
+    const unsigned num_of_threads = std::max(1u, std::min<unsigned>(options.threads, combinations.size()));
+    std::vector<std::thread> workers;
+    workers.reserve(num_of_threads);
+    for (unsigned t = 0; t < num_of_threads; ++t)
+    {
+        workers.emplace_back([&]() {
+            for (size_t idx = next_config++; idx < combinations.size(); idx = next_config++)
+            {
+                results[idx] = replay(base_config, combinations[idx], trace);
+            }
+        });
+    }
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    std::ofstream output_file;
+    if (!options.output_path.empty())
+    {
+        output_file.open(options.output_path);
+        if (!output_file.is_open())
+        {
+            std::cerr << "Error: Could not open " << options.output_path << " for writing" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& os = options.output_path.empty() ? std::cout : output_file;
+
+    if (options.format == "csv")
+    {
+        write_csv(os, grid, results);
+    }
+    else
+    {
+        write_json(os, results);
+    }
+
+    return 0;
+}